@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+
+#include "addressindex.h"
+#include "util.h"
+
+AddressIndex::AddressIndex() { _nDead = 0; }
+
+std::string AddressIndex::fold(const std::string &text) {
+  std::string folded(text);
+  for (char &c : folded) {
+    if (c >= 'A' && c <= 'Z')
+      c = c - 'A' + 'a';
+  }
+  return folded;
+}
+
+std::vector<uint32_t> AddressIndex::trigrams(const std::string &folded) {
+  std::vector<uint32_t> result;
+  for (size_t i = 0; i + 3 <= folded.size(); i++) {
+    result.push_back(uint32_t(static_cast<unsigned char>(folded[i])) << 16 |
+                     uint32_t(static_cast<unsigned char>(folded[i + 1])) << 8 |
+                     static_cast<unsigned char>(folded[i + 2]));
+  }
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+void AddressIndex::indexEntry(uint32_t nId, std::vector<Term> &terms) {
+  const Entry &entry = _entries[nId];
+  terms.emplace_back(HexStr(entry.address), nId << 1 | 1);
+  if (entry.folded.empty())
+    return;
+  terms.emplace_back(entry.folded, nId << 1);
+  for (uint32_t nTrigram : trigrams(entry.folded))
+    _postings[nTrigram].push_back(nId);
+}
+
+void AddressIndex::mergeTerms() {
+  std::vector<Term> terms;
+  terms.reserve(_terms.size() + _pendingTerms.size());
+  std::merge(std::make_move_iterator(_terms.begin()),
+             std::make_move_iterator(_terms.end()), _pendingTerms.begin(),
+             _pendingTerms.end(), std::back_inserter(terms));
+  terms.erase(std::remove_if(terms.begin(), terms.end(),
+                             [this](const Term &term) {
+                               return !_entries[term.second >> 1].fLive;
+                             }),
+              terms.end());
+  _terms.swap(terms);
+  _pendingTerms.clear();
+}
+
+void AddressIndex::rebuild() {
+  std::vector<Entry> entries;
+  entries.reserve(_entries.size() - _nDead);
+  for (Entry &entry : _entries) {
+    if (entry.fLive)
+      entries.push_back(std::move(entry));
+  }
+  _entries.swap(entries);
+  _nDead = 0;
+  _mapIds.clear();
+  _terms.clear();
+  _pendingTerms.clear();
+  _postings.clear();
+
+  _terms.reserve(_entries.size() * 2);
+  for (uint32_t nId = 0; nId < _entries.size(); nId++) {
+    _mapIds[_entries[nId].address] = nId;
+    indexEntry(nId, _terms);
+  }
+  std::sort(_terms.begin(), _terms.end());
+}
+
+void AddressIndex::clear() {
+  const std::lock_guard<std::shared_timed_mutex> lock(_mutexIndex);
+  _entries.clear();
+  _nDead = 0;
+  _mapIds.clear();
+  _terms.clear();
+  _pendingTerms.clear();
+  _postings.clear();
+}
+
+void AddressIndex::assign(
+    const std::map<KeyID, std::string> &mapAddressBook) {
+  const std::lock_guard<std::shared_timed_mutex> lock(_mutexIndex);
+  _entries.clear();
+  _entries.reserve(mapAddressBook.size());
+  for (auto &it : mapAddressBook)
+    _entries.push_back(Entry{it.first, it.second, fold(it.second), true});
+  _nDead = 0;
+  rebuild();
+}
+
+void AddressIndex::set(const KeyID &address, const std::string &label) {
+  const std::lock_guard<std::shared_timed_mutex> lock(_mutexIndex);
+  auto it = _mapIds.find(address);
+  if (it != _mapIds.end()) {
+    if (_entries[it->second].label == label)
+      return;
+    _entries[it->second].fLive = false;
+    _nDead++;
+  }
+
+  uint32_t nId = _entries.size();
+  _entries.push_back(Entry{address, label, fold(label), true});
+  _mapIds[address] = nId;
+  std::vector<Term> terms;
+  indexEntry(nId, terms);
+  _pendingTerms.insert(terms.begin(), terms.end());
+
+  if (_nDead > std::max(ADDRESSINDEX_MIN_MERGE, _entries.size() - _nDead))
+    rebuild();
+  else if (_pendingTerms.size() >
+           std::max(ADDRESSINDEX_MIN_MERGE, _terms.size() / 8))
+    mergeTerms();
+}
+
+void AddressIndex::erase(const KeyID &address) {
+  const std::lock_guard<std::shared_timed_mutex> lock(_mutexIndex);
+  auto it = _mapIds.find(address);
+  if (it == _mapIds.end())
+    return;
+  _entries[it->second].fLive = false;
+  _nDead++;
+  _mapIds.erase(it);
+
+  if (_nDead > std::max(ADDRESSINDEX_MIN_MERGE, _entries.size() - _nDead))
+    rebuild();
+}
+
+size_t AddressIndex::size() const {
+  const std::shared_lock<std::shared_timed_mutex> lock(_mutexIndex);
+  return _mapIds.size();
+}
+
+bool AddressIndex::isPrefixMatch(const Term &term,
+                                 const std::string &prefix) const {
+  const Entry &entry = _entries[term.second >> 1];
+  if (!entry.fLive)
+    return false;
+  // An entry whose label also matches is reported through its label term.
+  return !(term.second & 1) || entry.folded.compare(0, prefix.size(),
+                                                    prefix) != 0;
+}
+
+bool AddressIndex::addMatch(uint32_t nId, size_t nOffset, size_t nLimit,
+                            AddressPage &page) const {
+  if (page.nTotal >= nOffset + nLimit + ADDRESSINDEX_MAX_COUNT) {
+    page.fExact = false;
+    return false;
+  }
+  if (page.nTotal >= nOffset && page.matches.size() < nLimit)
+    page.matches.push_back(
+        AddressMatch{_entries[nId].address, _entries[nId].label});
+  page.nTotal++;
+  return true;
+}
+
+AddressPage AddressIndex::findPrefix(const std::string &prefix,
+                                     size_t nOffset, size_t nLimit) const {
+  const std::shared_lock<std::shared_timed_mutex> lock(_mutexIndex);
+  nLimit = std::min(nLimit, ADDRESSINDEX_MAX_PAGE);
+  std::string folded = fold(prefix);
+  auto startsWith = [&folded](const Term &term) {
+    return term.first.compare(0, folded.size(), folded) == 0;
+  };
+
+  AddressPage page;
+  auto it = std::lower_bound(_terms.begin(), _terms.end(), Term(folded, 0));
+  auto itPending = _pendingTerms.lower_bound(Term(folded, 0));
+  while (true) {
+    bool fArray = it != _terms.end() && startsWith(*it);
+    bool fPending = itPending != _pendingTerms.end() && startsWith(*itPending);
+    if (!fArray && !fPending)
+      break;
+    const Term &term =
+        fArray && (!fPending || *it < *itPending) ? *it++ : *itPending++;
+    if (isPrefixMatch(term, folded) &&
+        !addMatch(term.second >> 1, nOffset, nLimit, page))
+      break;
+  }
+  return page;
+}
+
+AddressPage AddressIndex::findSubstring(const std::string &text,
+                                        size_t nOffset, size_t nLimit) const {
+  const std::shared_lock<std::shared_timed_mutex> lock(_mutexIndex);
+  nLimit = std::min(nLimit, ADDRESSINDEX_MAX_PAGE);
+  std::string folded = fold(text);
+
+  AddressPage page;
+  std::vector<uint32_t> queryTrigrams = trigrams(folded);
+  if (queryTrigrams.empty()) {
+    // Too short to use the trigram index.
+    for (uint32_t nId = 0; nId < _entries.size(); nId++) {
+      if (_entries[nId].fLive &&
+          _entries[nId].folded.find(folded) != std::string::npos &&
+          !addMatch(nId, nOffset, nLimit, page))
+        break;
+    }
+    return page;
+  }
+
+  std::vector<const std::vector<uint32_t> *> lists;
+  for (uint32_t nTrigram : queryTrigrams) {
+    auto it = _postings.find(nTrigram);
+    if (it == _postings.end())
+      return page;
+    lists.push_back(&it->second);
+  }
+  std::sort(lists.begin(), lists.end(),
+            [](const std::vector<uint32_t> *a, const std::vector<uint32_t> *b) {
+              return a->size() < b->size();
+            });
+
+  // Intersecting the two rarest lists is a sequential merge; past that,
+  // matching the label itself is cheaper than probing more lists.
+  std::vector<uint32_t> candidates;
+  if (lists.size() > 1)
+    std::set_intersection(lists[0]->begin(), lists[0]->end(),
+                          lists[1]->begin(), lists[1]->end(),
+                          std::back_inserter(candidates));
+  else
+    candidates = *lists[0];
+
+  for (uint32_t nId : candidates) {
+    if (_entries[nId].fLive &&
+        _entries[nId].folded.find(folded) != std::string::npos &&
+        !addMatch(nId, nOffset, nLimit, page))
+      break;
+  }
+  return page;
+}
@@ -0,0 +1,85 @@
+#ifndef ADDRESSINDEX_H
+#define ADDRESSINDEX_H
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "key.h"
+
+static const size_t ADDRESSINDEX_MIN_MERGE = 1024;
+static const size_t ADDRESSINDEX_MAX_PAGE = 1000;
+static const size_t ADDRESSINDEX_MAX_COUNT = 10000;
+
+struct AddressMatch {
+  KeyID address;
+  std::string label;
+};
+
+struct AddressPage {
+  std::vector<AddressMatch> matches;
+  size_t nTotal = 0;
+  // False once counting stopped at ADDRESSINDEX_MAX_COUNT past the page.
+  bool fExact = true;
+};
+
+// Case-insensitive (ASCII) search over the address book. Labels and hex
+// addresses are kept in a sorted term array for prefix queries; new terms go
+// to an ordered overflow set that is merged in once it outgrows an eighth of
+// the array. Labels are also indexed by trigram for substring queries.
+// Every update takes a fresh entry id, so posting lists stay sorted by
+// appending; superseded entries are skipped until the next rebuild.
+class AddressIndex {
+private:
+  struct Entry {
+    KeyID address;
+    std::string label;
+    std::string folded;
+    bool fLive;
+  };
+  // Folded text and (entry id << 1 | is-address).
+  typedef std::pair<std::string, uint32_t> Term;
+
+  std::vector<Entry> _entries;
+  size_t _nDead;
+  std::map<KeyID, uint32_t> _mapIds;
+  std::vector<Term> _terms;
+  std::set<Term> _pendingTerms;
+  std::unordered_map<uint32_t, std::vector<uint32_t>> _postings;
+  mutable std::shared_timed_mutex _mutexIndex;
+
+  static std::string fold(const std::string &text);
+  static std::vector<uint32_t> trigrams(const std::string &folded);
+  void indexEntry(uint32_t nId, std::vector<Term> &terms);
+  void mergeTerms();
+  void rebuild();
+  bool isPrefixMatch(const Term &term, const std::string &prefix) const;
+  bool addMatch(uint32_t nId, size_t nOffset, size_t nLimit,
+                AddressPage &page) const;
+
+public:
+  AddressIndex();
+
+  AddressIndex(const AddressIndex &) = delete;
+  AddressIndex &operator=(const AddressIndex &) = delete;
+
+  void clear();
+  void assign(const std::map<KeyID, std::string> &mapAddressBook);
+  void set(const KeyID &address, const std::string &label);
+  void erase(const KeyID &address);
+
+  size_t size() const;
+  // Entries whose label or hex address starts with prefix, in term order.
+  AddressPage findPrefix(const std::string &prefix, size_t nOffset,
+                         size_t nLimit) const;
+  // Entries whose label contains text, oldest update first.
+  AddressPage findSubstring(const std::string &text, size_t nOffset,
+                            size_t nLimit) const;
+};
+
+#endif // ADDRESSINDEX_H
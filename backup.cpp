@@ -0,0 +1,331 @@
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+
+#include <cryptopp/hkdf.h>
+#include <cryptopp/sha.h>
+
+#include "backup.h"
+#include "threadpool.h"
+#include "util.h"
+#include "walletdb.h"
+
+struct BackupChunk {
+  uint64_t nIndex;
+  bool fFinal;
+  uint32_t nRecords;
+  uint64_t nRawSize;
+  QByteArray data;
+};
+
+typedef std::function<void(const BackupChunk &chunk, const QByteArray &records)>
+    BackupChunkFn;
+
+static SecureBytes deriveBackupKey(const SecureBytes &vMasterKey,
+                                   const std::vector<unsigned char> &salt) {
+  static const char info[] = "wallet backup";
+  SecureBytes key(KEY_SIZE);
+  CryptoPP::HKDF<CryptoPP::SHA256> hkdf;
+  hkdf.DeriveKey(key.data(), key.size(), vMasterKey.data(), vMasterKey.size(),
+                 salt.data(), salt.size(),
+                 reinterpret_cast<const unsigned char *>(info),
+                 sizeof(info) - 1);
+  return key;
+}
+
+// The key is unique to one backup, so the chunk index is a sufficient nonce.
+static SecureBytes chunkIV(uint64_t nIndex) {
+  SecureBytes iv(IV_SIZE, 0);
+  for (int i = 0; i < 8; i++)
+    iv[i] = (nIndex >> (8 * i)) & 0xFF;
+  return iv;
+}
+
+static std::vector<unsigned char>
+chunkAAD(const std::vector<unsigned char> &salt, const BackupChunk &chunk) {
+  std::vector<unsigned char> aad(salt);
+  for (int i = 0; i < 8; i++)
+    aad.push_back((chunk.nIndex >> (8 * i)) & 0xFF);
+  aad.push_back(chunk.fFinal ? 1 : 0);
+  for (int i = 0; i < 4; i++)
+    aad.push_back((chunk.nRecords >> (8 * i)) & 0xFF);
+  return aad;
+}
+
+static void sealChunk(const SecureBytes &key,
+                      const std::vector<unsigned char> &salt,
+                      BackupChunk &chunk) {
+  QByteArray compressed = qCompress(chunk.data);
+  chunk.data.fill(0);
+  SecureBytes plaintext(compressed.begin(), compressed.end());
+  compressed.fill(0);
+
+  Crypter crypter;
+  std::vector<unsigned char> ciphertext;
+  if (!crypter.setKey(key, chunkIV(chunk.nIndex)) ||
+      !crypter.encryptAuthenticated(plaintext, chunkAAD(salt, chunk),
+                                    ciphertext))
+    throw std::runtime_error("Cannot encrypt backup chunk " +
+                             std::to_string(chunk.nIndex));
+  chunk.data = Bytes2QByteArray(ciphertext);
+}
+
+void writeBackup(WalletDatabase &database, const SecureBytes &vMasterKey,
+                 const MasterKey &masterKey, const std::string &path,
+                 BackupStats &stats) {
+  std::string errorMsg = "Cannot write backup: ";
+  auto start = std::chrono::steady_clock::now();
+  stats = BackupStats();
+
+  std::vector<unsigned char> salt(BACKUP_SALT_SIZE);
+  getRandBytes(salt.data(), salt.size());
+  const SecureBytes key = deriveBackupKey(vMasterKey, salt);
+
+  QSaveFile file(StdString2QString(path));
+  if (!file.open(QIODevice::WriteOnly))
+    throw std::runtime_error(errorMsg + path);
+  QDataStream stream(&file);
+  stream << quint32(BACKUP_MAGIC) << quint32(BACKUP_VERSION) << masterKey
+         << Bytes2QByteArray(salt);
+
+  // The reader fills chunks from the cursor and hands them to the pool; the
+  // caller writes them back in order. At most BACKUP_MAX_PENDING_CHUNKS are
+  // between the two, so memory stays bounded when the disk is slow.
+  ThreadPool pool;
+  std::deque<std::future<BackupChunk>> pending;
+  std::mutex mutexPending;
+  std::condition_variable cvPending;
+  bool fReadDone = false;
+  bool fAbort = false;
+  std::string readError;
+
+  std::thread reader([&]() {
+    try {
+      std::unique_ptr<DatabaseBatch> batch = database.makeBatch(true);
+      std::unique_ptr<DatabaseCursor> cursor = batch->getNewCursor();
+      if (!cursor)
+        throw std::runtime_error("Cannot open database cursor");
+
+      QByteArray keyData, valueData;
+      bool fMore = true;
+      for (uint64_t nIndex = 0; fMore; nIndex++) {
+        {
+          std::unique_lock<std::mutex> lock(mutexPending);
+          cvPending.wait(lock, [&]() {
+            return fAbort || pending.size() < BACKUP_MAX_PENDING_CHUNKS;
+          });
+          if (fAbort)
+            break;
+        }
+
+        BackupChunk chunk = {nIndex, false, 0, 0, QByteArray()};
+        {
+          QDataStream chunkStream(&chunk.data, QIODevice::WriteOnly);
+          while (chunk.data.size() < BACKUP_CHUNK_SIZE &&
+                 (fMore = cursor->next(keyData, valueData))) {
+            chunkStream << keyData << valueData;
+            chunk.nRecords++;
+          }
+        }
+        chunk.fFinal = !fMore;
+        chunk.nRawSize = chunk.data.size();
+
+        std::future<BackupChunk> sealed =
+            pool.submit([&key, &salt, chunk = std::move(chunk)]() mutable {
+              sealChunk(key, salt, chunk);
+              return std::move(chunk);
+            });
+        {
+          const std::lock_guard<std::mutex> lock(mutexPending);
+          pending.push_back(std::move(sealed));
+        }
+        cvPending.notify_all();
+      }
+    } catch (const std::exception &e) {
+      const std::lock_guard<std::mutex> lock(mutexPending);
+      readError = e.what();
+    }
+    {
+      const std::lock_guard<std::mutex> lock(mutexPending);
+      fReadDone = true;
+    }
+    cvPending.notify_all();
+  });
+
+  std::string writeError;
+  while (writeError.empty()) {
+    std::future<BackupChunk> sealed;
+    {
+      std::unique_lock<std::mutex> lock(mutexPending);
+      cvPending.wait(lock, [&]() { return !pending.empty() || fReadDone; });
+      if (pending.empty())
+        break;
+      sealed = std::move(pending.front());
+      pending.pop_front();
+    }
+    cvPending.notify_all();
+
+    try {
+      BackupChunk chunk = sealed.get();
+      stream << quint64(chunk.nIndex) << chunk.fFinal
+             << quint32(chunk.nRecords) << chunk.data;
+      if (stream.status() != QDataStream::Ok)
+        writeError = "Write failed";
+      stats.nChunks++;
+      stats.nRecords += chunk.nRecords;
+      stats.nRawBytes += chunk.nRawSize;
+    } catch (const std::exception &e) {
+      writeError = e.what();
+    }
+  }
+
+  if (!writeError.empty()) {
+    {
+      const std::lock_guard<std::mutex> lock(mutexPending);
+      fAbort = true;
+    }
+    cvPending.notify_all();
+  }
+  reader.join();
+  for (auto &sealed : pending)
+    sealed.wait();
+
+  if (!readError.empty())
+    throw std::runtime_error(errorMsg + readError);
+  if (!writeError.empty())
+    throw std::runtime_error(errorMsg + writeError);
+  if (!file.commit())
+    throw std::runtime_error(errorMsg + "Cannot commit " + path);
+
+  stats.nFileBytes = QFile(StdString2QString(path)).size();
+  stats.nMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+}
+
+// Opens every chunk in order and hands its records to fn; throws on the first
+// chunk that is missing, out of order or fails authentication.
+static void readBackup(const std::string &path, const SecureString &passphrase,
+                       BackupStats &stats, const BackupChunkFn &fn) {
+  std::string errorMsg = "Cannot read backup: ";
+  auto start = std::chrono::steady_clock::now();
+  stats = BackupStats();
+
+  QFile file(StdString2QString(path));
+  if (!file.open(QIODevice::ReadOnly))
+    throw std::runtime_error(errorMsg + path);
+  QDataStream stream(&file);
+  quint32 nMagic, nVersion;
+  MasterKey masterKey;
+  QByteArray saltData;
+  stream >> nMagic >> nVersion >> masterKey >> saltData;
+  if (stream.status() != QDataStream::Ok || nMagic != BACKUP_MAGIC ||
+      nVersion != BACKUP_VERSION || saltData.size() != BACKUP_SALT_SIZE)
+    throw std::runtime_error(errorMsg + "Not a wallet backup");
+
+  Crypter crypter;
+  SecureBytes vMasterKey;
+  if (!crypter.setKeyFromPassphrase(passphrase, masterKey.salt,
+                                    masterKey.nDeriveIterations) ||
+      !crypter.decrypt(masterKey.cryptedKey, vMasterKey) ||
+      vMasterKey.size() != KEY_SIZE)
+    throw std::runtime_error(errorMsg + "Incorrect passphrase");
+  const std::vector<unsigned char> salt = QByteArray2Bytes(saltData);
+  const SecureBytes key = deriveBackupKey(vMasterKey, salt);
+
+  BackupChunk chunk = {0, false, 0, 0, QByteArray()};
+  for (uint64_t nIndex = 0; !chunk.fFinal; nIndex++) {
+    quint64 nChunkIndex;
+    quint32 nRecords;
+    stream >> nChunkIndex >> chunk.fFinal >> nRecords >> chunk.data;
+    chunk.nIndex = nChunkIndex;
+    chunk.nRecords = nRecords;
+    std::string chunkName = "chunk " + std::to_string(nIndex);
+    if (stream.status() != QDataStream::Ok)
+      throw std::runtime_error(errorMsg + "Truncated before " + chunkName);
+    if (chunk.nIndex != nIndex)
+      throw std::runtime_error(errorMsg + "Out of order at " + chunkName);
+
+    SecureBytes plaintext;
+    if (!crypter.setKey(key, chunkIV(nIndex)) ||
+        !crypter.decryptAuthenticated(QByteArray2Bytes(chunk.data),
+                                      chunkAAD(salt, chunk), plaintext))
+      throw std::runtime_error(errorMsg + "Authentication failed for " +
+                               chunkName + " (incorrect passphrase?)");
+    QByteArray records = qUncompress(Bytes2QByteArray(plaintext));
+    fn(chunk, records);
+    stats.nChunks++;
+    stats.nRecords += chunk.nRecords;
+    stats.nRawBytes += records.size();
+    records.fill(0);
+  }
+  if (!stream.atEnd())
+    throw std::runtime_error(errorMsg + "Data after the final chunk");
+
+  stats.nFileBytes = file.size();
+  stats.nMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+}
+
+static void forEachRecord(
+    const BackupChunk &chunk, const QByteArray &records,
+    const std::function<void(const QByteArray &, const QByteArray &)> &fn) {
+  QByteArray recordData = records;
+  QDataStream recordStream(&recordData, QIODevice::ReadOnly);
+  QByteArray keyData, valueData;
+  for (uint32_t i = 0; i < chunk.nRecords; i++) {
+    recordStream >> keyData >> valueData;
+    if (recordStream.status() != QDataStream::Ok)
+      break;
+    fn(keyData, valueData);
+  }
+  if (recordStream.status() != QDataStream::Ok || !recordStream.atEnd())
+    throw std::runtime_error("Cannot read backup: Malformed chunk " +
+                             std::to_string(chunk.nIndex));
+}
+
+void verifyBackup(const std::string &path, const SecureString &passphrase,
+                  BackupStats &stats) {
+  readBackup(path, passphrase, stats,
+             [](const BackupChunk &chunk, const QByteArray &records) {
+               forEachRecord(chunk, records,
+                             [](const QByteArray &, const QByteArray &) {});
+             });
+}
+
+void restoreBackup(const std::string &path, const SecureString &passphrase,
+                   WalletDatabase &database, BackupStats &stats) {
+  std::unique_ptr<DatabaseBatch> batch = database.makeBatch(false, true);
+  readBackup(path, passphrase, stats,
+             [&batch](const BackupChunk &chunk, const QByteArray &records) {
+               std::string errorMsg = "Cannot restore backup: ";
+               if (!batch->TxnBegin())
+                 throw std::runtime_error(errorMsg + "Cannot begin txn");
+               try {
+                 forEachRecord(chunk, records,
+                               [&](const QByteArray &keyData,
+                                   const QByteArray &valueData) {
+                                 if (!batch->writeRaw(keyData, valueData))
+                                   throw std::runtime_error(errorMsg +
+                                                            "Write failed");
+                               });
+               } catch (...) {
+                 batch->TxnAbort();
+                 throw;
+               }
+               if (!batch->TxnCommit())
+                 throw std::runtime_error(errorMsg + "Cannot commit chunk " +
+                                          std::to_string(chunk.nIndex));
+             });
+  batch->flush();
+}
@@ -0,0 +1,41 @@
+#ifndef BACKUP_H
+#define BACKUP_H
+
+#include <cstdint>
+#include <string>
+
+#include "crypter.h"
+#include "db.h"
+#include "sec_block.h"
+
+static const uint32_t BACKUP_MAGIC = 0x77626b70;
+static const uint32_t BACKUP_VERSION = 1;
+static const int BACKUP_CHUNK_SIZE = 0x40000;
+static const size_t BACKUP_MAX_PENDING_CHUNKS = 8;
+static const int BACKUP_SALT_SIZE = 16;
+
+struct BackupStats {
+  uint64_t nChunks = 0;
+  uint64_t nRecords = 0;
+  uint64_t nRawBytes = 0;
+  uint64_t nFileBytes = 0;
+  int64_t nMicros = 0;
+};
+
+// A backup is a header followed by chunks of cursor records. Each chunk is
+// compressed and sealed with AES-GCM under a key derived from vMasterKey and
+// a per-backup salt; the chunk index and a final flag are authenticated with
+// it, so reordered, dropped or truncated chunks are detected. The master key
+// record, still wrapped under its passphrase, is kept in the header, which is
+// all verifyBackup and restoreBackup need besides the passphrase.
+void writeBackup(WalletDatabase &database, const SecureBytes &vMasterKey,
+                 const MasterKey &masterKey, const std::string &path,
+                 BackupStats &stats);
+void verifyBackup(const std::string &path, const SecureString &passphrase,
+                  BackupStats &stats);
+// Each chunk is written in its own transaction; verify first to avoid a
+// partial restore.
+void restoreBackup(const std::string &path, const SecureString &passphrase,
+                   WalletDatabase &database, BackupStats &stats);
+
+#endif // BACKUP_H
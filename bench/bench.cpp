@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+#include "bench.h"
+
+BenchTimer::BenchTimer() { reset(); }
+
+void BenchTimer::reset() { _start = std::chrono::steady_clock::now(); }
+
+int64_t BenchTimer::elapsedMicros() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - _start)
+      .count();
+}
+
+int64_t median(std::vector<int64_t> values) {
+  if (values.empty())
+    return 0;
+  std::nth_element(values.begin(), values.begin() + values.size() / 2,
+                   values.end());
+  return values[values.size() / 2];
+}
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("wallet_bench");
+
+  const std::vector<std::pair<std::string, std::function<void(
+                                               const BenchOptions &)>>>
+      benchmarks = {
+          {"addressbook", benchAddressBook},
+          {"coinselection", benchCoinSelection},
+          {"eventbus", benchEventBus},
+          {"rescan", benchRescan},
+          {"signing", benchSigning},
+          {"storage", benchStorage},
+      };
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Wallet benchmark suite");
+  parser.addHelpOption();
+  QCommandLineOption filterOption(
+      "filter", "Only run benchmarks whose name contains <name>.", "name");
+  QCommandLineOption seedOption("seed", "Seed for synthetic data.", "n", "1");
+  QCommandLineOption runsOption("runs", "Timed runs per case.", "n", "5");
+  QCommandLineOption quickOption("quick", "Run reduced problem sizes.");
+  parser.addOption(filterOption);
+  parser.addOption(seedOption);
+  parser.addOption(runsOption);
+  parser.addOption(quickOption);
+  parser.process(app);
+
+  BenchOptions options;
+  options.nSeed = parser.value(seedOption).toULongLong();
+  options.nRuns = std::max(1, parser.value(runsOption).toInt());
+  options.fQuick = parser.isSet(quickOption);
+  std::string filter = parser.value(filterOption).toStdString();
+
+  for (auto &benchmark : benchmarks) {
+    if (!filter.empty() && benchmark.first.find(filter) == std::string::npos)
+      continue;
+    std::printf("# %s\n", benchmark.first.c_str());
+    benchmark.second(options);
+    std::printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+struct BenchOptions {
+  uint64_t nSeed;
+  int nRuns;
+  bool fQuick;
+};
+
+class BenchTimer {
+private:
+  std::chrono::steady_clock::time_point _start;
+
+public:
+  BenchTimer();
+  void reset();
+  int64_t elapsedMicros() const;
+};
+
+int64_t median(std::vector<int64_t> values);
+
+void benchAddressBook(const BenchOptions &options);
+void benchCoinSelection(const BenchOptions &options);
+void benchEventBus(const BenchOptions &options);
+void benchRescan(const BenchOptions &options);
+void benchSigning(const BenchOptions &options);
+void benchStorage(const BenchOptions &options);
+
+#endif // BENCH_H
@@ -0,0 +1,23 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+TARGET = wallet_bench
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../core.pri)
+
+SOURCES += \
+    bench.cpp \
+    bench_addressbook.cpp \
+    bench_coinselection.cpp \
+    bench_eventbus.cpp \
+    bench_rescan.cpp \
+    bench_signing.cpp \
+    bench_storage.cpp
+
+HEADERS += \
+    bench.h
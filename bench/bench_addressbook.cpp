@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "addressindex.h"
+#include "bench.h"
+
+static const char *BENCH_LABEL_WORDS[] = {"Invoice", "Order", "Refund",
+                                          "Customer", "Payout", "Tip"};
+static const size_t BENCH_PAGE_SIZE = 50;
+
+static std::string benchLabel(std::mt19937_64 &rng) {
+  return std::string(BENCH_LABEL_WORDS[rng() % 6]) + " #" +
+         std::to_string(rng() % 1000000);
+}
+
+static KeyID benchAddress(std::mt19937_64 &rng) {
+  KeyID address;
+  for (unsigned char &c : address)
+    c = rng();
+  return address;
+}
+
+void benchAddressBook(const BenchOptions &options) {
+  const size_t nEntries = options.fQuick ? 100000 : 1000000;
+  const size_t nUpdates = 20000;
+  std::mt19937_64 rng(options.nSeed);
+
+  std::map<KeyID, std::string> mapAddressBook;
+  std::vector<KeyID> addresses;
+  addresses.reserve(nEntries);
+  while (mapAddressBook.size() < nEntries) {
+    KeyID address = benchAddress(rng);
+    if (mapAddressBook.emplace(address, benchLabel(rng)).second)
+      addresses.push_back(address);
+  }
+
+  AddressIndex index;
+  BenchTimer timer;
+  index.assign(mapAddressBook);
+  std::printf("%-22s %10.1f ms for %zu entries\n", "assign",
+              timer.elapsedMicros() / 1000.0, nEntries);
+
+  timer.reset();
+  for (size_t i = 0; i < nUpdates; i++) {
+    if (i % 4 == 0)
+      index.set(benchAddress(rng), benchLabel(rng));
+    else
+      index.set(addresses[rng() % nEntries], benchLabel(rng));
+  }
+  std::printf("%-22s %10.2f us per update\n", "set",
+              timer.elapsedMicros() / static_cast<double>(nUpdates));
+
+  const std::vector<std::pair<std::string, bool>> queries = {
+      {"invoice #12", false}, {"ref", false},  {"a3", false},
+      {"#4242", true},        {"tomer #9", true}, {"ut", true}};
+  std::printf("%-22s %9s %8s %10s\n", "query", "matches", "exact", "us");
+  for (auto &query : queries) {
+    std::vector<int64_t> runs;
+    AddressPage page;
+    for (int run = 0; run < options.nRuns; run++) {
+      timer.reset();
+      page = query.second
+                 ? index.findSubstring(query.first, BENCH_PAGE_SIZE,
+                                       BENCH_PAGE_SIZE)
+                 : index.findPrefix(query.first, BENCH_PAGE_SIZE,
+                                    BENCH_PAGE_SIZE);
+      runs.push_back(timer.elapsedMicros());
+    }
+    std::string name = (query.second ? "contains:" : "prefix:") + query.first;
+    std::printf("%-22s %9zu %8s %10lld\n", name.c_str(), page.nTotal,
+                page.fExact ? "yes" : "no",
+                static_cast<long long>(median(runs)));
+  }
+}
@@ -0,0 +1,107 @@
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "bench.h"
+#include "coinselection.h"
+
+enum class UtxoDistribution { UNIFORM, EXPONENTIAL, BIMODAL, CONSOLIDATION };
+
+static const char *distributionName(UtxoDistribution distribution) {
+  switch (distribution) {
+  case UtxoDistribution::UNIFORM:
+    return "uniform";
+  case UtxoDistribution::EXPONENTIAL:
+    return "exponential";
+  case UtxoDistribution::BIMODAL:
+    return "bimodal";
+  case UtxoDistribution::CONSOLIDATION:
+    return "consolidation";
+  }
+  return "";
+}
+
+static std::vector<Amount> makeUtxos(UtxoDistribution distribution,
+                                     size_t nCount, uint64_t nSeed) {
+  std::mt19937_64 rng(nSeed);
+  std::uniform_int_distribution<Amount> uniform(10000, COIN);
+  std::exponential_distribution<double> exponential(1.0 / (COIN / 20));
+  std::uniform_int_distribution<Amount> dust(1000, 50000);
+  std::uniform_int_distribution<Amount> large(COIN / 2, 5 * COIN);
+  std::vector<Amount> values(nCount);
+  for (auto &value : values) {
+    switch (distribution) {
+    case UtxoDistribution::UNIFORM:
+      value = uniform(rng);
+      break;
+    case UtxoDistribution::EXPONENTIAL:
+      value = 1000 + static_cast<Amount>(exponential(rng));
+      break;
+    case UtxoDistribution::BIMODAL:
+      value = rng() % 10 ? dust(rng) : large(rng);
+      break;
+    case UtxoDistribution::CONSOLIDATION:
+      value = (1 + rng() % 4) * COIN / 1000;
+      break;
+    }
+  }
+  return values;
+}
+
+void benchCoinSelection(const BenchOptions &options) {
+  const std::vector<size_t> sizes =
+      options.fQuick ? std::vector<size_t>{1000, 10000}
+                     : std::vector<size_t>{1000, 10000, 100000, 300000};
+  const std::vector<Amount> targets = {COIN / 10, 2 * COIN, 25 * COIN};
+  const std::vector<UtxoDistribution> distributions = {
+      UtxoDistribution::UNIFORM, UtxoDistribution::EXPONENTIAL,
+      UtxoDistribution::BIMODAL, UtxoDistribution::CONSOLIDATION};
+
+  std::printf("%-14s %8s %10s %10s %10s %-8s %6s %10s %10s %s\n",
+              "distribution", "utxos", "target", "sort_us", "select_us",
+              "algo", "inputs", "waste", "tries", "budget");
+  for (UtxoDistribution distribution : distributions) {
+    for (size_t nCount : sizes) {
+      std::vector<Amount> values =
+          makeUtxos(distribution, nCount, options.nSeed);
+      std::vector<size_t> vsizes(values.size(), P2WPKH_INPUT_VSIZE);
+      CoinSelectionParams params;
+      params.nSeed = options.nSeed;
+      params.nFeeRate = 5000;
+      CoinSelector selector(params);
+
+      std::vector<int64_t> sortTimes;
+      for (int i = 0; i < options.nRuns; i++) {
+        BenchTimer timer;
+        selector.reset(values.data(), vsizes.data(), values.size());
+        sortTimes.push_back(timer.elapsedMicros());
+      }
+
+      for (Amount nTarget : targets) {
+        SelectionResult result;
+        bool fSelected = false;
+        std::vector<int64_t> selectTimes;
+        for (int i = 0; i < options.nRuns; i++) {
+          BenchTimer timer;
+          fSelected = selector.select(nTarget, result);
+          selectTimes.push_back(timer.elapsedMicros());
+        }
+
+        std::string algorithm = !fSelected ? "failed"
+                                : result.algorithm == SelectionAlgorithm::BNB
+                                    ? "bnb"
+                                    : "knapsack";
+        std::printf("%-14s %8zu %10.2f %10lld %10lld %-8s %6zu %10lld %10llu "
+                    "%s\n",
+                    distributionName(distribution), nCount,
+                    static_cast<double>(nTarget) / COIN,
+                    static_cast<long long>(median(sortTimes)),
+                    static_cast<long long>(median(selectTimes)),
+                    algorithm.c_str(), result.vSelected.size(),
+                    static_cast<long long>(result.nWaste),
+                    static_cast<unsigned long long>(result.nTries),
+                    result.fBudgetExhausted ? "exhausted" : "ok");
+      }
+    }
+  }
+}
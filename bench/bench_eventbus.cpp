@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include "bench.h"
+#include "eventbus.h"
+
+static const int BENCH_FRAME_MS = 16;
+
+void benchEventBus(const BenchOptions &options) {
+  const size_t nEvents = options.fQuick ? 200000 : 2000000;
+  const std::vector<size_t> producers = {1, 4};
+  const std::vector<size_t> keyCounts = {100, 100000};
+
+  std::printf("%-9s %8s %10s %10s %12s %8s %12s %10s\n", "producers", "txids",
+              "events", "ms", "events/s", "batches", "events/batch",
+              "delivered");
+  for (size_t nProducers : producers) {
+    for (size_t nKeys : keyCounts) {
+      WalletEventBus bus;
+      uint64_t nDelivered = 0;
+      auto handler = bus.subscribe([&nDelivered](const WalletDelta &delta) {
+        nDelivered += delta.transactions.size();
+      });
+
+      std::atomic<bool> fDone(false);
+      std::thread consumer([&]() {
+        while (!fDone) {
+          std::this_thread::sleep_for(
+              std::chrono::milliseconds(BENCH_FRAME_MS));
+          bus.deliver();
+        }
+        bus.deliver();
+      });
+
+      BenchTimer timer;
+      std::vector<std::thread> threads;
+      for (size_t t = 0; t < nProducers; t++) {
+        threads.emplace_back([&, t]() {
+          std::mt19937_64 rng(options.nSeed + t);
+          for (size_t i = 0; i < nEvents / nProducers; i++) {
+            uint256 txid{};
+            uint64_t nKey = rng() % nKeys;
+            std::memcpy(txid.data(), &nKey, sizeof(nKey));
+            bus.notifyTransactionChanged(txid, i % 8 ? CT_UPDATED : CT_NEW);
+          }
+        });
+      }
+      for (auto &thread : threads)
+        thread.join();
+      int64_t nMicros = timer.elapsedMicros();
+      fDone = true;
+      consumer.join();
+
+      EventBusMetrics metrics = bus.getMetrics();
+      std::printf("%-9zu %8zu %10llu %10.1f %12.0f %8llu %12.0f %10llu\n",
+                  nProducers, nKeys,
+                  static_cast<unsigned long long>(metrics.nPosted),
+                  nMicros / 1000.0,
+                  metrics.nPosted * 1e6 / std::max<int64_t>(nMicros, 1),
+                  static_cast<unsigned long long>(metrics.nBatches),
+                  static_cast<double>(metrics.nDelivered) /
+                      std::max<uint64_t>(metrics.nBatches, 1),
+                  static_cast<unsigned long long>(nDelivered));
+    }
+  }
+}
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+
+#include <QTemporaryDir>
+
+#include "bench.h"
+#include "berkeley_db.h"
+#include "blockfile.h"
+#include "wallet.h"
+
+static const qint64 BENCH_BLOCKFILE_SIZE = 0x1000000;
+
+static Script makeRandomScript(std::mt19937_64 &rng) {
+  KeyID address;
+  for (auto &c : address)
+    c = static_cast<unsigned char>(rng());
+  return getScriptForWitnessPubKeyHash(address);
+}
+
+static size_t writeSyntheticBlocks(const QDir &blocksDir,
+                                   const std::vector<Script> &walletScripts,
+                                   size_t nBlocks, size_t nTxPerBlock,
+                                   uint64_t nSeed) {
+  std::mt19937_64 rng(nSeed);
+  std::vector<OutPoint> walletCoins;
+  size_t nRelevant = 0;
+  BlockFileWriter writer(blocksDir, BENCH_BLOCKFILE_SIZE);
+  for (size_t nHeight = 0; nHeight < nBlocks; nHeight++) {
+    std::vector<Transaction> vtx(nTxPerBlock);
+    for (size_t i = 0; i < nTxPerBlock; i++) {
+      Transaction &tx = vtx[i];
+      bool fRelevant = false;
+      if (i == 0) {
+        tx.vin.resize(1);
+        writeLE(tx.vin[0].scriptSig, static_cast<uint32_t>(nHeight));
+      } else {
+        tx.vin.resize(1 + rng() % 2);
+        for (auto &txin : tx.vin) {
+          if (!walletCoins.empty() && rng() % 50 == 0) {
+            size_t nCoin = rng() % walletCoins.size();
+            txin.prevout = walletCoins[nCoin];
+            walletCoins[nCoin] = walletCoins.back();
+            walletCoins.pop_back();
+            fRelevant = true;
+          } else {
+            for (auto &c : txin.prevout.txid)
+              c = static_cast<unsigned char>(rng());
+            txin.prevout.n = rng() % 4;
+          }
+        }
+      }
+
+      tx.vout.resize(2);
+      for (auto &txout : tx.vout) {
+        txout.nValue = 10000 + rng() % COIN;
+        if (rng() % 100 == 0) {
+          txout.scriptPubKey = walletScripts[rng() % walletScripts.size()];
+          fRelevant = true;
+        } else {
+          txout.scriptPubKey = makeRandomScript(rng);
+        }
+      }
+
+      if (fRelevant) {
+        uint256 txid = tx.getHash();
+        for (uint32_t n = 0; n < tx.vout.size(); n++) {
+          if (tx.vout[n].scriptPubKey.size() &&
+              std::find(walletScripts.begin(), walletScripts.end(),
+                        tx.vout[n].scriptPubKey) != walletScripts.end())
+            walletCoins.emplace_back(txid, n);
+        }
+        nRelevant++;
+      }
+    }
+    writer.appendBlock(vtx, 1600000000 + nHeight * 600);
+  }
+  writer.close();
+  return nRelevant;
+}
+
+void benchRescan(const BenchOptions &options) {
+  const size_t nBlocks = options.fQuick ? 200 : 2000;
+  const size_t nTxPerBlock = 250;
+  const size_t nWalletKeys = 200;
+
+  QTemporaryDir tempDir;
+  QDir dir(tempDir.path());
+  if (!tempDir.isValid() || !dir.mkpath("wallet")) {
+    std::printf("cannot create temporary directory\n");
+    return;
+  }
+  QDir blocksDir(dir.filePath("blocks"));
+  std::shared_ptr<BerkeleyEnvironment> env(
+      new BerkeleyEnvironment(QDir(dir.filePath("wallet"))));
+  {
+    Wallet wallet(env, "bench.dat");
+    std::vector<Script> walletScripts;
+    for (size_t i = 0; i < nWalletKeys; i++) {
+      KeyID address;
+      if (!wallet.getNewDestination("", address)) {
+        std::printf("cannot generate wallet keys\n");
+        return;
+      }
+      walletScripts.push_back(getScriptForWitnessPubKeyHash(address));
+    }
+
+    BenchTimer timer;
+    size_t nExpected = writeSyntheticBlocks(blocksDir, walletScripts, nBlocks,
+                                            nTxPerBlock, options.nSeed);
+    std::printf("generated %zu blocks, %zu txs, %zu wallet txs in %lld ms\n",
+                nBlocks, nBlocks * nTxPerBlock, nExpected,
+                static_cast<long long>(timer.elapsedMicros() / 1000));
+
+    std::printf("%-8s %8s %8s %8s %10s %12s %12s\n", "pass", "start", "stop",
+                "matched", "ms", "blocks/s", "txs/s");
+    auto report = [&](const char *name, const RescanResult &result,
+                      int64_t nMicros) {
+      double dBlocks = result.nStopHeight - result.nStartHeight + 1;
+      std::printf("%-8s %8d %8d %8zu %10lld %12.0f %12.0f%s\n", name,
+                  result.nStartHeight, result.nStopHeight,
+                  result.nTransactions,
+                  static_cast<long long>(nMicros / 1000),
+                  dBlocks * 1e6 / std::max<int64_t>(nMicros, 1),
+                  dBlocks * nTxPerBlock * 1e6 / std::max<int64_t>(nMicros, 1),
+                  result.fAborted ? " (aborted)" : "");
+    };
+
+    RescanResult result;
+    size_t nFound = 0;
+    timer.reset();
+    wallet.rescanBlockFiles(blocksDir, 0, result,
+                            [&wallet](int32_t, double dProgress) {
+                              if (dProgress >= 0.5)
+                                wallet.abortRescan();
+                            });
+    report("partial", result, timer.elapsedMicros());
+    nFound += result.nTransactions;
+
+    timer.reset();
+    wallet.rescanBlockFiles(blocksDir, -1, result);
+    report("resume", result, timer.elapsedMicros());
+    nFound += result.nTransactions;
+
+    timer.reset();
+    wallet.rescanBlockFiles(blocksDir, 0, result);
+    report("full", result, timer.elapsedMicros());
+
+    std::printf("wallet txs found %zu of %zu: %s\n", nFound, nExpected,
+                nFound == nExpected ? "ok" : "MISMATCH");
+  }
+  env->flush(true);
+}
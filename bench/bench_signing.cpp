@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+
+#include <QTemporaryDir>
+
+#include "bench.h"
+#include "berkeley_db.h"
+#include "wallet.h"
+
+static const char BENCH_PASSPHRASE[] = "bench passphrase";
+
+static Transaction makeSpend(const std::vector<OutPoint> &coins, size_t nBegin,
+                             size_t nInputs) {
+  Transaction tx;
+  tx.vin.resize(nInputs);
+  for (size_t i = 0; i < nInputs; i++)
+    tx.vin[i].prevout = coins[nBegin + i];
+  tx.vout.resize(1);
+  tx.vout[0].nValue = COIN;
+  tx.vout[0].scriptPubKey = getScriptForWitnessPubKeyHash(KeyID());
+  return tx;
+}
+
+void benchSigning(const BenchOptions &options) {
+  const size_t nInputs = options.fQuick ? 50 : 500;
+  const size_t nPSBTs = options.fQuick ? 10 : 100;
+  const size_t nPSBTInputs = options.fQuick ? 10 : 50;
+  const size_t nKeys = std::max(nInputs, nPSBTs * nPSBTInputs);
+
+  QTemporaryDir tempDir;
+  if (!tempDir.isValid()) {
+    std::printf("cannot create temporary directory\n");
+    return;
+  }
+  std::shared_ptr<BerkeleyEnvironment> env(
+      new BerkeleyEnvironment(QDir(tempDir.path())));
+  {
+    Wallet wallet(env, "bench.dat");
+    std::mt19937_64 rng(options.nSeed);
+    Transaction funding;
+    funding.vin.resize(1);
+    for (auto &c : funding.vin[0].prevout.txid)
+      c = static_cast<unsigned char>(rng());
+    for (size_t i = 0; i < nKeys; i++) {
+      KeyID address;
+      if (!wallet.getNewDestination("", address)) {
+        std::printf("cannot generate wallet keys\n");
+        return;
+      }
+      TxOut txout;
+      txout.nValue = 10000 + rng() % COIN;
+      txout.scriptPubKey = getScriptForWitnessPubKeyHash(address);
+      funding.vout.push_back(txout);
+    }
+    TransactionRef fundingRef = std::make_shared<const Transaction>(funding);
+    if (!wallet.addToWallet(fundingRef, 1)) {
+      std::printf("cannot fund wallet\n");
+      return;
+    }
+    std::vector<OutPoint> coins;
+    for (uint32_t n = 0; n < funding.vout.size(); n++)
+      coins.emplace_back(fundingRef->getHash(), n);
+
+    SecureString passphrase(BENCH_PASSPHRASE,
+                            BENCH_PASSPHRASE + sizeof(BENCH_PASSPHRASE) - 1);
+    if (!wallet.encryptWallet(passphrase)) {
+      std::printf("cannot encrypt wallet\n");
+      return;
+    }
+
+    // Every pass starts from a freshly unlocked wallet so that key
+    // decryption is part of the measured cost.
+    auto relock = [&]() {
+      wallet.lock();
+      wallet.unlock(passphrase);
+    };
+
+    std::printf("%-12s %8s %10s %12s %s\n", "pass", "sigs", "ms", "sigs/s",
+                "result");
+    auto report = [](const char *name, size_t nSignatures, int64_t nMicros,
+                     bool fOk) {
+      std::printf("%-12s %8zu %10.1f %12.0f %s\n", name, nSignatures,
+                  nMicros / 1000.0,
+                  nSignatures * 1e6 / std::max<int64_t>(nMicros, 1),
+                  fOk ? "ok" : "FAILED");
+    };
+
+    std::vector<int64_t> vSerial, vParallel, vSingle, vBatch;
+    bool fSerialOk = true, fParallelOk = true, fSingleOk = true,
+         fBatchOk = true;
+    for (int nRun = 0; nRun < options.nRuns; nRun++) {
+      Transaction tx = makeSpend(coins, 0, nInputs);
+      relock();
+      BenchTimer timer;
+      for (unsigned int i = 0; i < tx.vin.size() && fSerialOk; i++) {
+        const TxOut &utxo = funding.vout[tx.vin[i].prevout.n];
+        KeyID address;
+        Key key;
+        fSerialOk = extractKeyID(utxo.scriptPubKey, address) &&
+                    wallet.getKey(address, key) &&
+                    signInput(key, tx, i, utxo.scriptPubKey, utxo.nValue);
+      }
+      vSerial.push_back(timer.elapsedMicros());
+
+      tx = makeSpend(coins, 0, nInputs);
+      relock();
+      timer.reset();
+      fParallelOk = wallet.signTransaction(tx) && fParallelOk;
+      vParallel.push_back(timer.elapsedMicros());
+
+      std::vector<PartiallySignedTransaction> psbtxs;
+      for (size_t p = 0; p < nPSBTs; p++)
+        psbtxs.emplace_back(makeSpend(coins, p * nPSBTInputs, nPSBTInputs));
+      std::vector<PartiallySignedTransaction> psbtxsBatch = psbtxs;
+
+      relock();
+      timer.reset();
+      for (auto &psbtx : psbtxs) {
+        bool complete;
+        fSingleOk = wallet.fillPSBT(psbtx, complete) && complete && fSingleOk;
+      }
+      vSingle.push_back(timer.elapsedMicros());
+
+      relock();
+      timer.reset();
+      std::vector<bool> complete;
+      fBatchOk = wallet.fillPSBTs(psbtxsBatch, complete) && fBatchOk;
+      for (bool fComplete : complete)
+        fBatchOk = fBatchOk && fComplete;
+      vBatch.push_back(timer.elapsedMicros());
+    }
+
+    report("serial", nInputs, median(vSerial), fSerialOk);
+    report("parallel", nInputs, median(vParallel), fParallelOk);
+    report("psbt", nPSBTs * nPSBTInputs, median(vSingle), fSingleOk);
+    report("psbt-batch", nPSBTs * nPSBTInputs, median(vBatch), fBatchOk);
+
+    SigningMetrics metrics = wallet.getSigningMetrics();
+    std::printf("wallet: %llu signatures in %llu batches, %.0f sigs/s\n",
+                static_cast<unsigned long long>(metrics.nSignatures),
+                static_cast<unsigned long long>(metrics.nBatches),
+                metrics.nSignatures * 1e6 /
+                    std::max<uint64_t>(metrics.nTotalMicros, 1));
+  }
+  env->flush(true);
+}
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <QDir>
+#include <QTemporaryDir>
+
+#include "bench.h"
+#include "berkeley_db.h"
+#include "log_db.h"
+#include "util.h"
+
+static const size_t BENCH_TXN_SIZE = 100;
+static const int BENCH_VALUE_SIZE = 256;
+
+static QByteArray benchKey(size_t i) {
+  std::string key = "key" + std::to_string(i);
+  return QByteArray(key.data(), key.size());
+}
+
+static void printCase(const std::string &engine, const char *name,
+                      size_t nOps, int64_t nMicros) {
+  std::printf("%-6s %-12s %9zu %10.1f %12.0f\n", engine.c_str(), name, nOps,
+              nMicros / 1000.0, nOps * 1e6 / std::max<int64_t>(nMicros, 1));
+}
+
+static void runStorage(WalletDatabase &database, const BenchOptions &options) {
+  const size_t nRecords = options.fQuick ? 20000 : 200000;
+  const size_t nSingle = options.fQuick ? 500 : 2000;
+  const size_t nOverwrites = nRecords * 4;
+  const std::string engine = database.getEngineName();
+  std::mt19937_64 rng(options.nSeed);
+  QByteArray value(BENCH_VALUE_SIZE, 'v');
+
+  std::unique_ptr<DatabaseBatch> batch = database.makeBatch(false, true);
+  BenchTimer timer;
+  for (size_t i = 0; i < nRecords; i += BENCH_TXN_SIZE) {
+    batch->TxnBegin();
+    for (size_t j = i; j < std::min(nRecords, i + BENCH_TXN_SIZE); j++)
+      batch->write(benchKey(j), value);
+    batch->TxnCommit();
+  }
+  printCase(engine, "txn-write", nRecords, timer.elapsedMicros());
+
+  timer.reset();
+  for (size_t i = 0; i < nSingle; i++)
+    batch->write(benchKey(nRecords + i), value);
+  printCase(engine, "single-write", nSingle, timer.elapsedMicros());
+
+  std::vector<int64_t> runs;
+  for (int run = 0; run < options.nRuns; run++) {
+    timer.reset();
+    QByteArray readValue;
+    for (size_t i = 0; i < nRecords; i++)
+      batch->read(benchKey(rng() % nRecords), readValue);
+    runs.push_back(timer.elapsedMicros());
+  }
+  printCase(engine, "random-read", nRecords, median(runs));
+
+  runs.clear();
+  size_t nScanned = 0;
+  for (int run = 0; run < options.nRuns; run++) {
+    timer.reset();
+    std::unique_ptr<DatabaseCursor> cursor = batch->getNewCursor();
+    QByteArray keyData, valueData;
+    nScanned = 0;
+    while (cursor && cursor->next(keyData, valueData))
+      nScanned++;
+    runs.push_back(timer.elapsedMicros());
+  }
+  printCase(engine, "scan", nScanned, median(runs));
+
+  timer.reset();
+  for (size_t i = 0; i < nOverwrites; i += BENCH_TXN_SIZE) {
+    batch->TxnBegin();
+    for (size_t j = 0; j < BENCH_TXN_SIZE; j++)
+      batch->write(benchKey(rng() % nRecords), value);
+    batch->TxnCommit();
+  }
+  printCase(engine, "overwrite", nOverwrites, timer.elapsedMicros());
+}
+
+void benchStorage(const BenchOptions &options) {
+  QTemporaryDir tempDir;
+  QDir dir(tempDir.path());
+
+  std::printf("%-6s %-12s %9s %10s %12s\n", "engine", "case", "ops", "ms",
+              "ops/s");
+  {
+    std::shared_ptr<BerkeleyEnvironment> env(
+        new BerkeleyEnvironment(QDir(dir.filePath("bdb"))));
+    {
+      BerkeleyDatabase database(env, "bench.dat");
+      runStorage(database, options);
+    }
+    env->flush(true);
+  }
+
+  LogDatabase database(QDir(dir.filePath("log")), "bench.dat");
+  runStorage(database, options);
+  LogDatabaseMetrics metrics = database.getMetrics();
+  std::printf("log: %zu keys, %lld bytes live log, %lld dead, %llu "
+              "compactions, last %.1f ms\n",
+              metrics.nKeys, static_cast<long long>(metrics.nLogSize),
+              static_cast<long long>(metrics.nDeadBytes),
+              static_cast<unsigned long long>(metrics.nCompactions),
+              metrics.nLastCompactionMicros / 1000.0);
+}
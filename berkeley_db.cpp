@@ -47,7 +47,7 @@ void BerkeleyEnvironment::open() {
 
   QDir pathLogDir = _path;
   errorMsg = "Cannot create database log directory";
-  if (!pathLogDir.mkdir("database") || !pathLogDir.cd("database"))
+  if (!pathLogDir.mkpath("database") || !pathLogDir.cd("database"))
     throw std::runtime_error(errorMsg +
                              QString2StdString(pathLogDir.absolutePath()));
 
@@ -201,6 +201,14 @@ void BerkeleyDatabase::reset() {
 
 std::string BerkeleyDatabase::getFileName() const { return _filename; }
 
+std::string BerkeleyDatabase::getEngineName() const { return "bdb"; }
+
+std::unique_ptr<DatabaseBatch> BerkeleyDatabase::makeBatch(bool isReadOnly,
+                                                           bool isCreate) {
+  return std::unique_ptr<DatabaseBatch>(
+      new BerkeleyBatch(*this, isReadOnly, isCreate));
+}
+
 void BerkeleyDatabase::close() {
   std::string errorMsg;
 
@@ -247,9 +255,70 @@ void BerkeleyDatabase::backup(const std::string &pathDest) {
                              QString2StdString(fileDest));
 }
 
+bool BerkeleyDatabase::rewrite() {
+  if (!env)
+    return false;
+
+  std::unique_lock<std::recursive_mutex> lock(mutexDb);
+  env->cvDbInUse.wait(lock, [this]() {
+    if ((this->env->mapFileUseCount.count(this->_filename) == 0) ||
+        (this->env->mapFileUseCount[this->_filename] == 0))
+      return true;
+    return false;
+  });
+
+  // Erased records stay in free pages until the btree is rebuilt, so the live
+  // records are copied to a fresh file that replaces the old one.
+  std::string filenameCopy = _filename + ".rewrite";
+  Db(env->dbEnv.get(), 0).remove(filenameCopy.c_str(), nullptr, 0);
+  bool fOk;
+  {
+    std::unique_ptr<Db> pDbCopy(new Db(env->dbEnv.get(), 0));
+    fOk = pDbCopy->open(nullptr, filenameCopy.c_str(), nullptr, DB_BTREE,
+                        DB_CREATE, 0) == 0;
+    if (fOk) {
+      BerkeleyBatch batch(*this, true);
+      std::unique_ptr<DatabaseCursor> cursor = batch.getNewCursor();
+      fOk = cursor != nullptr;
+      QByteArray key, value;
+      while (fOk && cursor->next(key, value)) {
+        Dbt keyData(key.data(), key.size());
+        Dbt valueData(value.data(), value.size());
+        fOk = pDbCopy->put(nullptr, &keyData, &valueData, 0) == 0;
+      }
+      value.fill(0);
+    }
+    fOk = pDbCopy->close(0) == 0 && fOk;
+  }
+
+  close();
+  env->mapFileUseCount.erase(_filename);
+  if (fOk) {
+    Db dbOld(env->dbEnv.get(), 0);
+    fOk = dbOld.remove(_filename.c_str(), nullptr, 0) == 0;
+  }
+  if (fOk) {
+    Db dbCopy(env->dbEnv.get(), 0);
+    fOk = dbCopy.rename(filenameCopy.c_str(), nullptr, _filename.c_str(), 0) ==
+          0;
+  } else {
+    Db dbCopy(env->dbEnv.get(), 0);
+    dbCopy.remove(filenameCopy.c_str(), nullptr, 0);
+  }
+
+  // Once checkpointed, the logs that still hold the erased values are not
+  // needed for recovery and are removed. The active log file is only dropped
+  // after BDB has moved past it.
+  env->dbEnv->txn_checkpoint(0, 0, 0);
+  env->dbEnv->log_archive(nullptr, DB_ARCH_REMOVE);
+  return fOk;
+}
+
 BerkeleyBatch::BerkeleyBatch(BerkeleyDatabase &database, bool isReadOnly,
-                             bool isCreate) {
+                             bool isCreate)
+    : DatabaseBatch(database) {
   std::string errorMsg;
+  _activeTxn = nullptr;
   _fReadOnly = isReadOnly;
   _env = database.env.get();
   _filename = database.getFileName();
@@ -335,33 +404,102 @@ bool BerkeleyBatch::TxnAbort() {
   return (ret == 0);
 }
 
-Dbc *BerkeleyBatch::getCursor() {
+bool BerkeleyBatch::readKey(const QByteArray &key, QByteArray &value) {
   if (!_pDb)
-    return nullptr;
+    return false;
+
+  // Caller buffers are only borrowed, so they are wrapped in a plain Dbt
+  // that leaves them untouched; SafeDbt is kept for what BDB hands back.
+  Dbt keyData(const_cast<char *>(key.data()), key.size());
+  SafeDbt valueData;
+  int ret = _pDb->get(_activeTxn, &keyData, &valueData.dbt, 0);
+  if (ret != 0 || valueData.dbt.get_data() == nullptr)
+    return false;
+  value = QByteArray(reinterpret_cast<const char *>(valueData.dbt.get_data()),
+                     valueData.dbt.get_size());
+  return true;
+}
+
+bool BerkeleyBatch::writeKey(const QByteArray &key, const QByteArray &value,
+                             bool fOverwrite) {
+  if (!_pDb || _fReadOnly)
+    return false;
+
+  Dbt keyData(const_cast<char *>(key.data()), key.size());
+  Dbt valueData(const_cast<char *>(value.data()), value.size());
+  int ret = _pDb->put(_activeTxn, &keyData, &valueData,
+                      (fOverwrite ? 0 : DB_NOOVERWRITE));
+  return (ret == 0);
+}
+
+bool BerkeleyBatch::eraseKey(const QByteArray &key) {
+  if (!_pDb || _fReadOnly)
+    return false;
+
+  Dbt keyData(const_cast<char *>(key.data()), key.size());
+  int ret = _pDb->del(_activeTxn, &keyData, 0);
+  return (ret == 0 || ret == DB_NOTFOUND);
+}
+
+bool BerkeleyBatch::hasKey(const QByteArray &key) {
+  if (!_pDb)
+    return false;
+
+  Dbt keyData(const_cast<char *>(key.data()), key.size());
+  int ret = _pDb->exists(_activeTxn, &keyData, 0);
+  return (ret == 0);
+}
+
+std::unique_ptr<DatabaseCursor> BerkeleyBatch::getNewCursor() {
+  if (!_pDb)
+    return std::unique_ptr<DatabaseCursor>();
   Dbc *pCursor = nullptr;
   int ret = _pDb->cursor(nullptr, &pCursor, 0);
   if (ret != 0)
-    return nullptr;
-  return pCursor;
+    return std::unique_ptr<DatabaseCursor>();
+  return std::unique_ptr<DatabaseCursor>(new BerkeleyCursor(pCursor));
 }
 
-bool BerkeleyBatch::readAtCursor(Dbc *pCursor, QDataStream &keyStream,
-                                 QDataStream &valueStream) {
+BerkeleyCursor::BerkeleyCursor(Dbc *pCursor) {
+  _pCursor = pCursor;
+  _fSeek = false;
+}
+
+BerkeleyCursor::~BerkeleyCursor() {
+  if (_pCursor)
+    _pCursor->close();
+}
+
+bool BerkeleyCursor::next(QByteArray &key, QByteArray &value) {
   SafeDbt keyData;
   SafeDbt valueData;
-  int ret = pCursor->get(&keyData.dbt, &valueData.dbt, DB_NEXT);
+  u_int32_t flags = DB_NEXT;
+  if (_fSeek) {
+    keyData.dbt.set_data(_seekKey.data());
+    keyData.dbt.set_size(_seekKey.size());
+    flags = DB_SET_RANGE;
+    _fSeek = false;
+  }
+  int ret = _pCursor->get(&keyData.dbt, &valueData.dbt, flags);
+  // On failure the key still points at our own buffer.
+  if (keyData.dbt.get_data() == _seekKey.data())
+    keyData.dbt.set_data(nullptr);
   if (ret != 0 || keyData.dbt.get_data() == nullptr ||
       valueData.dbt.get_data() == nullptr)
     return false;
 
-  keyStream.writeBytes(reinterpret_cast<const char *>(keyData.dbt.get_data()),
-                       keyData.dbt.get_size());
-  valueStream.writeBytes(
-      reinterpret_cast<const char *>(valueData.dbt.get_data()),
-      valueData.dbt.get_size());
+  key = QByteArray(reinterpret_cast<const char *>(keyData.dbt.get_data()),
+                   keyData.dbt.get_size());
+  value = QByteArray(reinterpret_cast<const char *>(valueData.dbt.get_data()),
+                     valueData.dbt.get_size());
   return true;
 }
 
+void BerkeleyCursor::seek(const QByteArray &key) {
+  _seekKey = key;
+  _fSeek = true;
+}
+
 SafeDbt::SafeDbt() { dbt.set_flags(DB_DBT_MALLOC); }
 
 SafeDbt::SafeDbt(char *data, int size) {
@@ -13,6 +13,8 @@
 #define HAVE_CXX_STDHEADERS
 #include <db_cxx.h>
 
+#include "db.h"
+
 static const unsigned int DEFAULT_DB_CACHESIZE = 0x100000;
 static const unsigned int DEFAULT_DB_LOGSIZE = 0x10000;
 static const unsigned int DEFAULT_DB_LOGMAX = 0x100000;
@@ -62,7 +64,7 @@ public:
   DbTxn *TxnBegin();
 };
 
-class BerkeleyDatabase {
+class BerkeleyDatabase : public WalletDatabase {
 private:
   std::string _filename;
 
@@ -75,13 +77,34 @@ public:
   ~BerkeleyDatabase();
   void reset();
 
-  std::string getFileName() const;
+  std::string getFileName() const override;
+  std::string getEngineName() const override;
 
-  void close();
-  void backup(const std::string &pathDest);
+  std::unique_ptr<DatabaseBatch> makeBatch(bool isReadOnly = false,
+                                           bool isCreate = false) override;
+  void close() override;
+  void backup(const std::string &pathDest) override;
+  bool rewrite() override;
+};
+
+class BerkeleyCursor : public DatabaseCursor {
+private:
+  Dbc *_pCursor;
+  QByteArray _seekKey;
+  bool _fSeek;
+
+public:
+  explicit BerkeleyCursor(Dbc *pCursor);
+  ~BerkeleyCursor();
+
+  BerkeleyCursor(const BerkeleyCursor &) = delete;
+  BerkeleyCursor &operator=(const BerkeleyCursor &) = delete;
+
+  bool next(QByteArray &key, QByteArray &value) override;
+  void seek(const QByteArray &key) override;
 };
 
-class BerkeleyBatch {
+class BerkeleyBatch : public DatabaseBatch {
 private:
   BerkeleyEnvironment *_env;
   std::string _filename;
@@ -89,6 +112,12 @@ private:
   DbTxn *_activeTxn;
   bool _fReadOnly;
 
+  bool readKey(const QByteArray &key, QByteArray &value) override;
+  bool writeKey(const QByteArray &key, const QByteArray &value,
+                bool fOverwrite) override;
+  bool eraseKey(const QByteArray &key) override;
+  bool hasKey(const QByteArray &key) override;
+
 public:
   BerkeleyBatch(BerkeleyDatabase &database, bool isReadOnly = false,
                 bool isCreate = false);
@@ -97,88 +126,14 @@ public:
   BerkeleyBatch(const BerkeleyBatch &) = delete;
   BerkeleyBatch &operator=(const BerkeleyBatch &) = delete;
 
-  void flush();
-  void close();
+  void flush() override;
+  void close() override;
+
+  bool TxnBegin() override;
+  bool TxnCommit() override;
+  bool TxnAbort() override;
 
-  bool TxnBegin();
-  bool TxnCommit();
-  bool TxnAbort();
-
-  Dbc *getCursor();
-  bool readAtCursor(Dbc *pCursor, QDataStream &keyStream,
-                    QDataStream &valueStream);
-
-  template <typename K, typename T> bool read(const K &key, T &value) {
-    if (!_pDb)
-      return false;
-
-    QByteArray keyArray;
-    QDataStream keyStream(&keyArray, QIODevice::ReadWrite);
-    keyStream << key;
-    SafeDbt keyData(keyArray.data(), keyArray.size());
-
-    SafeDbt valueData;
-    int ret = _pDb->get(_activeTxn, &keyData.dbt, &valueData.dbt, 0);
-    if (valueData.dbt.get_data() != nullptr) {
-      try {
-        QByteArray valueArray(
-            reinterpret_cast<const char *>(valueData.dbt.get_data()),
-            valueData.dbt.get_size());
-        QDataStream valueStream(&valueArray, QIODevice::ReadWrite);
-        valueArray >> value;
-      } catch (...) {
-        return false;
-      }
-    }
-
-    return (ret == 0);
-  }
-
-  template <typename K, typename T>
-  bool write(const K &key, const T &value, bool fOverwrite = true) {
-    if (!_pDb || _fReadOnly)
-      return false;
-
-    QByteArray keyArray;
-    QDataStream keyStream(&keyArray, QIODevice::ReadWrite);
-    keyStream << key;
-    SafeDbt keyData(keyArray.data(), keyArray.size());
-
-    QByteArray valueArray;
-    QDataStream valueStream(&valueArray, QIODevice::ReadWrite);
-    valueStream << value;
-    SafeDbt valueData(valueArray.data(), valueArray.size());
-
-    int ret = _pDb->put(_activeTxn, &keyData.dbt, &valueData.dbt,
-                        (fOverwrite ? 0 : DB_NOOVERWRITE));
-    return (ret == 00);
-  }
-
-  template <typename K> bool erase(const K &key) {
-    if (!_pDb || _fReadOnly)
-      return false;
-
-    QByteArray keyArray;
-    QDataStream keyStream(&keyArray, QIODevice::ReadWrite);
-    keyStream << key;
-    SafeDbt keyData(keyArray.data(), keyArray.size());
-
-    int ret = _pDb->del(_activeTxn, &keyData.dbt, 0);
-    return (ret == 0 || ret == DB_NOTFOUND);
-  }
-
-  template <typename K> bool exists(const K &key) {
-    if (!_pDb)
-      return false;
-
-    QByteArray keyArray;
-    QDataStream keyStream(&keyArray, QIODevice::ReadWrite);
-    keyStream << key;
-    SafeDbt keyData(keyArray.data(), keyArray.size());
-
-    int ret = _pDb->exists(_activeTxn, &keyData.dbt, 0);
-    return (ret == 0);
-  }
+  std::unique_ptr<DatabaseCursor> getNewCursor() override;
 };
 
 #endif // BERKELEY_DB_H
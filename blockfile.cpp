@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include "blockfile.h"
+
+QString getBlockFileName(unsigned int nFile) {
+  return QString("blk%1.dat").arg(nFile, 5, 10, QChar('0'));
+}
+
+uint256 computeMerkleRoot(std::vector<uint256> hashes) {
+  if (hashes.empty()) {
+    uint256 root;
+    root.fill(0);
+    return root;
+  }
+  while (hashes.size() > 1) {
+    if (hashes.size() & 1)
+      hashes.push_back(hashes.back());
+    for (size_t i = 0; i < hashes.size() / 2; i++) {
+      unsigned char pair[64];
+      std::memcpy(pair, hashes[2 * i].data(), 32);
+      std::memcpy(pair + 32, hashes[2 * i + 1].data(), 32);
+      hashes[i] = hash256(pair, sizeof(pair));
+    }
+    hashes.resize(hashes.size() / 2);
+  }
+  return hashes[0];
+}
+
+static uint32_t readUInt32(const unsigned char *pData) {
+  return static_cast<uint32_t>(pData[0]) |
+         static_cast<uint32_t>(pData[1]) << 8 |
+         static_cast<uint32_t>(pData[2]) << 16 |
+         static_cast<uint32_t>(pData[3]) << 24;
+}
+
+BlockFileReader::BlockFileReader(const QDir &blocksDir) {
+  std::string errorMsg = "Cannot open block files: ";
+  std::vector<BlockPos> vStored;
+  for (unsigned int nFile = 0;; nFile++) {
+    std::unique_ptr<QFile> file(
+        new QFile(blocksDir.filePath(getBlockFileName(nFile))));
+    if (!file->exists())
+      break;
+    if (!file->open(QIODevice::ReadOnly))
+      throw std::runtime_error(errorMsg +
+                               file->fileName().toStdString());
+
+    qint64 nFileSize = file->size();
+    const unsigned char *pData = nFileSize > 0 ? file->map(0, nFileSize)
+                                               : nullptr;
+    if (nFileSize > 0 && !pData)
+      throw std::runtime_error(errorMsg +
+                               file->fileName().toStdString());
+
+    qint64 nOffset = 0;
+    while (nFileSize - nOffset >= 8 &&
+           std::equal(BLOCKFILE_MAGIC.begin(), BLOCKFILE_MAGIC.end(),
+                      pData + nOffset)) {
+      uint32_t nSize = readUInt32(pData + nOffset + 4);
+      if (nSize < BLOCK_HEADER_SIZE || nFileSize - nOffset - 8 < nSize)
+        break;
+      vStored.push_back({nFile, nOffset + 8, nSize});
+      nOffset += 8 + nSize;
+    }
+    _vFiles.push_back(std::move(file));
+    _vData.push_back(pData);
+  }
+
+  // Blocks are stored as they arrived, not in chain order. Link each one to
+  // its parent by hashPrevBlock from genesis, keep the longest chain and drop
+  // orphans, stale forks and duplicates.
+  std::vector<uint256> vHashes;
+  std::map<uint256, std::vector<size_t>> mapChildren;
+  std::map<uint256, size_t> mapStored;
+  vHashes.reserve(vStored.size());
+  for (size_t i = 0; i < vStored.size(); i++) {
+    const BlockPos &pos = vStored[i];
+    const unsigned char *pHeader = _vData[pos.nFile] + pos.nOffset;
+    vHashes.push_back(hash256(pHeader, BLOCK_HEADER_SIZE));
+    if (!mapStored.emplace(vHashes[i], i).second)
+      continue;
+    uint256 hashPrevBlock;
+    std::memcpy(hashPrevBlock.data(), pHeader + 4, hashPrevBlock.size());
+    mapChildren[hashPrevBlock].push_back(i);
+  }
+
+  uint256 hashGenesisPrev;
+  hashGenesisPrev.fill(0);
+  std::vector<size_t> vParent(vStored.size(), vStored.size());
+  std::vector<size_t> vHeight(vStored.size(), 0);
+  std::deque<size_t> queue(mapChildren[hashGenesisPrev].begin(),
+                           mapChildren[hashGenesisPrev].end());
+  size_t nTip = vStored.size();
+  while (!queue.empty()) {
+    size_t i = queue.front();
+    queue.pop_front();
+    if (nTip == vStored.size() || vHeight[i] > vHeight[nTip])
+      nTip = i;
+    auto it = mapChildren.find(vHashes[i]);
+    if (it == mapChildren.end())
+      continue;
+    for (size_t nChild : it->second) {
+      vParent[nChild] = i;
+      vHeight[nChild] = vHeight[i] + 1;
+      queue.push_back(nChild);
+    }
+  }
+
+  for (size_t i = nTip; i != vStored.size(); i = vParent[i])
+    _vBlocks.push_back(vStored[i]);
+  std::reverse(_vBlocks.begin(), _vBlocks.end());
+}
+
+BlockFileReader::~BlockFileReader() {
+  for (size_t i = 0; i < _vFiles.size(); i++) {
+    if (_vData[i])
+      _vFiles[i]->unmap(const_cast<unsigned char *>(_vData[i]));
+  }
+}
+
+size_t BlockFileReader::size() const { return _vBlocks.size(); }
+
+bool BlockFileReader::readBlock(size_t nHeight,
+                                std::vector<TransactionRef> &vtx,
+                                uint256 *pBlockHash) const {
+  if (nHeight >= _vBlocks.size())
+    return false;
+
+  const BlockPos &pos = _vBlocks[nHeight];
+  const unsigned char *pData = _vData[pos.nFile] + pos.nOffset;
+  const unsigned char *pEnd = pData + pos.nSize;
+  if (pBlockHash)
+    *pBlockHash = hash256(pData, BLOCK_HEADER_SIZE);
+  pData += BLOCK_HEADER_SIZE;
+
+  uint64_t nTx;
+  if (!readCompactSize(pData, pEnd, nTx) ||
+      nTx > static_cast<uint64_t>(pEnd - pData))
+    return false;
+  vtx.clear();
+  vtx.reserve(nTx);
+  for (uint64_t i = 0; i < nTx; i++) {
+    std::shared_ptr<Transaction> tx = std::make_shared<Transaction>();
+    if (!tx->deserialize(pData, pEnd))
+      return false;
+    vtx.push_back(std::move(tx));
+  }
+  return pData == pEnd;
+}
+
+BlockFileWriter::BlockFileWriter(const QDir &blocksDir, qint64 nMaxFileSize)
+    : _blocksDir(blocksDir), _nMaxFileSize(nMaxFileSize) {
+  std::string errorMsg = "Cannot create block files: ";
+  _nFile = 0;
+  _nBlocks = 0;
+  _hashPrevBlock.fill(0);
+  if (!_blocksDir.mkpath(".") || !openFile(0))
+    throw std::runtime_error(errorMsg +
+                             _blocksDir.absolutePath().toStdString());
+}
+
+bool BlockFileWriter::openFile(unsigned int nFile) {
+  if (_file.isOpen())
+    _file.close();
+  _file.setFileName(_blocksDir.filePath(getBlockFileName(nFile)));
+  _nFile = nFile;
+  return _file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+}
+
+size_t BlockFileWriter::size() const { return _nBlocks; }
+
+bool BlockFileWriter::appendBlock(const std::vector<Transaction> &vtx,
+                                  uint32_t nTime) {
+  std::vector<uint256> txids;
+  txids.reserve(vtx.size());
+  for (auto &tx : vtx)
+    txids.push_back(tx.getHash());
+  uint256 merkleRoot = computeMerkleRoot(txids);
+
+  std::vector<unsigned char> block;
+  writeLE(block, static_cast<int32_t>(4));
+  block.insert(block.end(), _hashPrevBlock.begin(), _hashPrevBlock.end());
+  block.insert(block.end(), merkleRoot.begin(), merkleRoot.end());
+  writeLE(block, nTime);
+  writeLE(block, static_cast<uint32_t>(0x207fffff));
+  writeLE(block, static_cast<uint32_t>(_nBlocks));
+  writeCompactSize(block, vtx.size());
+  for (auto &tx : vtx)
+    tx.serialize(block);
+
+  std::vector<unsigned char> record(BLOCKFILE_MAGIC.begin(),
+                                    BLOCKFILE_MAGIC.end());
+  writeLE(record, static_cast<uint32_t>(block.size()));
+  if (_file.size() > 0 &&
+      _file.size() + static_cast<qint64>(record.size() + block.size()) >
+          _nMaxFileSize &&
+      !openFile(_nFile + 1))
+    return false;
+  if (_file.write(reinterpret_cast<const char *>(record.data()),
+                  record.size()) != static_cast<qint64>(record.size()) ||
+      _file.write(reinterpret_cast<const char *>(block.data()),
+                  block.size()) != static_cast<qint64>(block.size()))
+    return false;
+
+  _hashPrevBlock = hash256(block.data(), BLOCK_HEADER_SIZE);
+  _nBlocks++;
+  return true;
+}
+
+bool BlockFileWriter::close() {
+  if (!_file.isOpen())
+    return true;
+  bool fFlushed = _file.flush();
+  _file.close();
+  return fFlushed;
+}
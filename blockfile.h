@@ -0,0 +1,71 @@
+#ifndef BLOCKFILE_H
+#define BLOCKFILE_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <QDir>
+#include <QFile>
+
+#include "hash.h"
+#include "transaction.h"
+
+static const std::array<unsigned char, 4> BLOCKFILE_MAGIC = {0xf9, 0xbe, 0xb4,
+                                                             0xd9};
+static const size_t BLOCK_HEADER_SIZE = 80;
+static const qint64 MAX_BLOCKFILE_SIZE = 0x8000000;
+
+QString getBlockFileName(unsigned int nFile);
+uint256 computeMerkleRoot(std::vector<uint256> hashes);
+
+// Block files hold records of magic, 32-bit little-endian size and a
+// serialized block, in no particular order. The reader links them by
+// hashPrevBlock into the longest chain from genesis and indexes that chain
+// by height; blocks off it are ignored.
+class BlockFileReader {
+private:
+  struct BlockPos {
+    uint32_t nFile;
+    qint64 nOffset;
+    uint32_t nSize;
+  };
+
+  std::vector<std::unique_ptr<QFile>> _vFiles;
+  std::vector<const unsigned char *> _vData;
+  std::vector<BlockPos> _vBlocks;
+
+public:
+  explicit BlockFileReader(const QDir &blocksDir);
+  ~BlockFileReader();
+
+  BlockFileReader(const BlockFileReader &) = delete;
+  BlockFileReader &operator=(const BlockFileReader &) = delete;
+
+  size_t size() const;
+  bool readBlock(size_t nHeight, std::vector<TransactionRef> &vtx,
+                 uint256 *pBlockHash = nullptr) const;
+};
+
+class BlockFileWriter {
+private:
+  QDir _blocksDir;
+  QFile _file;
+  unsigned int _nFile;
+  qint64 _nMaxFileSize;
+  uint256 _hashPrevBlock;
+  size_t _nBlocks;
+
+  bool openFile(unsigned int nFile);
+
+public:
+  explicit BlockFileWriter(const QDir &blocksDir,
+                           qint64 nMaxFileSize = MAX_BLOCKFILE_SIZE);
+
+  size_t size() const;
+  bool appendBlock(const std::vector<Transaction> &vtx, uint32_t nTime);
+  bool close();
+};
+
+#endif // BLOCKFILE_H
@@ -0,0 +1,21 @@
+#include "coincontrol.h"
+
+bool CoinControl::hasSelected() const { return !_setSelected.empty(); }
+
+bool CoinControl::isSelected(const OutPoint &output) const {
+  return _setSelected.count(output);
+}
+
+void CoinControl::select(const OutPoint &output) {
+  _setSelected.insert(output);
+}
+
+void CoinControl::unSelect(const OutPoint &output) {
+  _setSelected.erase(output);
+}
+
+void CoinControl::unSelectAll() { _setSelected.clear(); }
+
+void CoinControl::listSelected(std::vector<OutPoint> &outputs) const {
+  outputs.assign(_setSelected.begin(), _setSelected.end());
+}
@@ -0,0 +1,30 @@
+#ifndef COINCONTROL_H
+#define COINCONTROL_H
+
+#include <set>
+#include <vector>
+
+#include "key.h"
+#include "transaction.h"
+
+class CoinControl {
+private:
+  std::set<OutPoint> _setSelected;
+
+public:
+  KeyID destChange;
+  bool fHaveDestChange = false;
+  bool fAllowOtherInputs = false;
+  int nMinDepth = 0;
+  Amount nFeeRate = 0;
+  int64_t nMaxSelectionMicros = 0;
+
+  bool hasSelected() const;
+  bool isSelected(const OutPoint &output) const;
+  void select(const OutPoint &output);
+  void unSelect(const OutPoint &output);
+  void unSelectAll();
+  void listSelected(std::vector<OutPoint> &outputs) const;
+};
+
+#endif // COINCONTROL_H
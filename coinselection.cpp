@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include "coinselection.h"
+
+Amount getFee(Amount nFeeRate, size_t nVSize) {
+  return (nFeeRate * static_cast<Amount>(nVSize) + 999) / 1000;
+}
+
+size_t getOutputVSize(const TxOut &txout) {
+  size_t nScriptSize = txout.scriptPubKey.size();
+  return 8 + (nScriptSize < 253 ? 1 : 3) + nScriptSize;
+}
+
+size_t getInputVSize(const Script &scriptPubKey) {
+  if (scriptPubKey.size() == 22 && scriptPubKey[0] == OP_0 &&
+      scriptPubKey[1] == 20)
+    return P2WPKH_INPUT_VSIZE;
+  if (scriptPubKey.size() == 23 && scriptPubKey[0] == OP_HASH160 &&
+      scriptPubKey[1] == 20 && scriptPubKey[22] == OP_EQUAL)
+    return P2SH_P2WPKH_INPUT_VSIZE;
+  return P2PKH_INPUT_VSIZE;
+}
+
+Amount CoinSelectionParams::getInputFee(size_t nInputVSize) const {
+  return getFee(nFeeRate, nInputVSize);
+}
+
+Amount CoinSelectionParams::getInputWaste(size_t nInputVSize) const {
+  return getFee(nFeeRate, nInputVSize) - getFee(nLongTermFeeRate, nInputVSize);
+}
+
+Amount CoinSelectionParams::getChangeOutputFee() const {
+  return getFee(nFeeRate, nChangeOutputVSize);
+}
+
+Amount CoinSelectionParams::getCostOfChange() const {
+  return getChangeOutputFee() + getFee(nLongTermFeeRate, nChangeInputVSize);
+}
+
+class SelectionDeadline {
+private:
+  std::chrono::steady_clock::time_point _deadline;
+  bool _fTimed;
+
+public:
+  explicit SelectionDeadline(int64_t nMaxMicros)
+      : _deadline(std::chrono::steady_clock::now() +
+                  std::chrono::microseconds(nMaxMicros)),
+        _fTimed(nMaxMicros > 0) {}
+
+  bool expired() const {
+    return _fTimed && std::chrono::steady_clock::now() >= _deadline;
+  }
+};
+
+CoinSelector::CoinSelector(const CoinSelectionParams &params)
+    : _params(params) {}
+
+const CoinSelectionParams &CoinSelector::getParams() const { return _params; }
+
+void CoinSelector::reset(const Amount *pValues, const size_t *pInputVSizes,
+                         size_t nCount) {
+  std::vector<std::pair<Amount, uint32_t>> order;
+  order.reserve(nCount);
+  for (size_t i = 0; i < nCount; i++) {
+    Amount nEffectiveValue =
+        pValues[i] - _params.getInputFee(pInputVSizes[i]);
+    if (nEffectiveValue > 0)
+      order.emplace_back(nEffectiveValue, static_cast<uint32_t>(i));
+  }
+  std::sort(order.begin(), order.end(),
+            [](const std::pair<Amount, uint32_t> &a,
+               const std::pair<Amount, uint32_t> &b) {
+              return a.first > b.first ||
+                     (a.first == b.first && a.second < b.second);
+            });
+
+  const size_t nSize = order.size();
+  _vEffectiveValues.resize(nSize);
+  _vValues.resize(nSize);
+  _vInputWastes.resize(nSize);
+  _vIndices.resize(nSize);
+  _vRemaining.resize(nSize + 1);
+  for (size_t i = 0; i < nSize; i++) {
+    _vEffectiveValues[i] = order[i].first;
+    _vValues[i] = pValues[order[i].second];
+    _vInputWastes[i] = _params.getInputWaste(pInputVSizes[order[i].second]);
+    _vIndices[i] = order[i].second;
+  }
+  _vRemaining[nSize] = 0;
+  for (size_t i = nSize; i > 0; i--)
+    _vRemaining[i - 1] = _vRemaining[i] + _vEffectiveValues[i - 1];
+}
+
+size_t CoinSelector::size() const { return _vEffectiveValues.size(); }
+
+Amount CoinSelector::getTotalEffectiveValue() const {
+  return _vRemaining.empty() ? 0 : _vRemaining[0];
+}
+
+void CoinSelector::finish(const std::vector<uint32_t> &vPositions,
+                          Amount nTarget, SelectionAlgorithm algorithm,
+                          SelectionResult &result) const {
+  result.algorithm = algorithm;
+  result.vSelected.clear();
+  result.vSelected.reserve(vPositions.size());
+  result.nSelectedValue = 0;
+  result.nSelectedEffectiveValue = 0;
+  result.nWaste = 0;
+  for (uint32_t nPos : vPositions) {
+    result.vSelected.push_back(_vIndices[nPos]);
+    result.nSelectedValue += _vValues[nPos];
+    result.nSelectedEffectiveValue += _vEffectiveValues[nPos];
+    result.nWaste += _vInputWastes[nPos];
+  }
+
+  // BnB only accepts an excess below the cost of change, so its solutions
+  // stay changeless and the excess is paid as fee.
+  Amount nExcess = result.nSelectedEffectiveValue - nTarget;
+  Amount nChange = nExcess - _params.getChangeOutputFee();
+  result.nChange = algorithm != SelectionAlgorithm::BNB &&
+                           nChange >= DUST_THRESHOLD
+                       ? nChange
+                       : 0;
+  result.nWaste += result.nChange ? _params.getCostOfChange() : nExcess;
+}
+
+bool CoinSelector::selectBnB(Amount nTarget, SelectionResult &result) const {
+  const size_t nSize = _vEffectiveValues.size();
+  const Amount *pValues = _vEffectiveValues.data();
+  const Amount *pRemaining = _vRemaining.data();
+  const Amount *pInputWastes = _vInputWastes.data();
+  const Amount nCostOfChange = _params.getCostOfChange();
+  // Input waste has the sign of the fee rate difference for every coin, so
+  // waste only grows with more inputs when that difference is positive.
+  const bool fWasteGrows = _params.nFeeRate > _params.nLongTermFeeRate;
+  if (nTarget <= 0 || getTotalEffectiveValue() < nTarget)
+    return false;
+
+  SelectionDeadline deadline(_params.nMaxMicros);
+  std::vector<uint32_t> vCurrent, vBest;
+  vCurrent.reserve(nSize);
+  Amount nCurrentValue = 0, nCurrentWaste = 0;
+  Amount nBestWaste = MAX_MONEY;
+  size_t nPos = 0;
+  uint64_t nTries = 0;
+  bool fExhausted = false;
+  while (true) {
+    if (nTries >= _params.nMaxTries ||
+        ((nTries & 0xfff) == 0 && deadline.expired())) {
+      fExhausted = true;
+      break;
+    }
+    nTries++;
+
+    bool fBacktrack = false;
+    if (nCurrentValue + pRemaining[nPos] < nTarget ||
+        nCurrentValue > nTarget + nCostOfChange ||
+        (nCurrentWaste > nBestWaste && fWasteGrows)) {
+      fBacktrack = true;
+    } else if (nCurrentValue >= nTarget) {
+      Amount nWaste = nCurrentWaste + nCurrentValue - nTarget;
+      if (nWaste <= nBestWaste) {
+        vBest = vCurrent;
+        nBestWaste = nWaste;
+      }
+      fBacktrack = true;
+    }
+
+    if (fBacktrack) {
+      if (vCurrent.empty())
+        break;
+      nPos = vCurrent.back();
+      vCurrent.pop_back();
+      nCurrentValue -= pValues[nPos];
+      nCurrentWaste -= pInputWastes[nPos];
+      nPos++;
+      continue;
+    }
+
+    if (nPos > 0 && pValues[nPos] == pValues[nPos - 1] &&
+        pInputWastes[nPos] == pInputWastes[nPos - 1] &&
+        (vCurrent.empty() || vCurrent.back() != nPos - 1)) {
+      nPos++;
+      continue;
+    }
+    vCurrent.push_back(static_cast<uint32_t>(nPos));
+    nCurrentValue += pValues[nPos];
+    nCurrentWaste += pInputWastes[nPos];
+    nPos++;
+  }
+
+  if (vBest.empty())
+    return false;
+  finish(vBest, nTarget, SelectionAlgorithm::BNB, result);
+  result.nTries = nTries;
+  result.fBudgetExhausted = fExhausted;
+  return true;
+}
+
+bool CoinSelector::selectKnapsack(Amount nTarget,
+                                  SelectionResult &result) const {
+  const size_t nSize = _vEffectiveValues.size();
+  const Amount *pValues = _vEffectiveValues.data();
+  if (nTarget <= 0 || getTotalEffectiveValue() < nTarget)
+    return false;
+
+  auto descending = [](Amount a, Amount b) { return a > b; };
+  const Amount *pExact =
+      std::lower_bound(pValues, pValues + nSize, nTarget, descending);
+  if (pExact != pValues + nSize && *pExact == nTarget) {
+    finish({static_cast<uint32_t>(pExact - pValues)}, nTarget,
+           SelectionAlgorithm::KNAPSACK, result);
+    result.nTries = 1;
+    return true;
+  }
+
+  // Coins below nTarget + nMinChange form a suffix of the sorted array; the
+  // coin just before it is the smallest one that covers the target alone.
+  const size_t nLower =
+      std::lower_bound(pValues, pValues + nSize,
+                       nTarget + _params.nMinChange - 1, descending) -
+      pValues;
+  const bool fHaveLarger = nLower > 0;
+  const Amount nTotalLower = _vRemaining[nLower];
+  std::vector<uint32_t> vPositions;
+  if (nTotalLower <= nTarget) {
+    if (nTotalLower == nTarget) {
+      for (size_t i = nLower; i < nSize; i++)
+        vPositions.push_back(static_cast<uint32_t>(i));
+    } else {
+      vPositions.push_back(static_cast<uint32_t>(nLower - 1));
+    }
+    finish(vPositions, nTarget, SelectionAlgorithm::KNAPSACK, result);
+    result.nTries = 1;
+    return true;
+  }
+
+  const size_t nApplicable = nSize - nLower;
+  const Amount *pApplicable = pValues + nLower;
+  SelectionDeadline deadline(_params.nMaxMicros);
+  std::mt19937_64 rng(_params.nSeed);
+  std::vector<uint8_t> vIncluded(nApplicable);
+  std::vector<uint32_t> vOrder, vBest;
+  uint64_t nTries = 0;
+  bool fExhausted = false;
+
+  // Within one round coins are only ever appended to vOrder (a coin that
+  // reaches the target is dropped again immediately), so an improvement is
+  // recorded as a prefix length plus the coin that reached the target and
+  // materialised once per round instead of copying the inclusion flags.
+  auto approximateBestSubset = [&](Amount nSubsetTarget,
+                                   std::vector<uint32_t> &vSubset) {
+    Amount nBest = nTotalLower;
+    vSubset.clear();
+    for (size_t i = 0; i < nApplicable; i++)
+      vSubset.push_back(static_cast<uint32_t>(i));
+    for (int nRep = 0; nRep < KNAPSACK_ITERATIONS && nBest != nSubsetTarget;
+         nRep++) {
+      if (nTries >= _params.nMaxKnapsackSteps || deadline.expired()) {
+        fExhausted = true;
+        break;
+      }
+      for (uint32_t i : vOrder)
+        vIncluded[i] = 0;
+      vOrder.clear();
+      Amount nTotal = 0;
+      size_t nImprovedPrefix = 0;
+      uint32_t nImprovedCoin = 0;
+      bool fImproved = false;
+      bool fReachedTarget = false;
+      for (int nPass = 0; nPass < 2 && !fReachedTarget; nPass++) {
+        uint64_t nBits = 0;
+        nTries += nApplicable;
+        for (size_t i = 0; i < nApplicable; i++) {
+          if ((i & 63) == 0)
+            nBits = rng();
+          bool fPick = nPass == 0 ? (nBits >> (i & 63)) & 1 : !vIncluded[i];
+          if (!fPick)
+            continue;
+          if (nTotal + pApplicable[i] >= nSubsetTarget) {
+            fReachedTarget = true;
+            if (nTotal + pApplicable[i] < nBest) {
+              nBest = nTotal + pApplicable[i];
+              nImprovedPrefix = vOrder.size();
+              nImprovedCoin = static_cast<uint32_t>(i);
+              fImproved = true;
+            }
+          } else {
+            nTotal += pApplicable[i];
+            vIncluded[i] = 1;
+            vOrder.push_back(static_cast<uint32_t>(i));
+          }
+        }
+      }
+      if (fImproved) {
+        vSubset.assign(vOrder.begin(), vOrder.begin() + nImprovedPrefix);
+        vSubset.push_back(nImprovedCoin);
+      }
+    }
+    return nBest;
+  };
+
+  Amount nBest = approximateBestSubset(nTarget, vBest);
+  if (nBest != nTarget && nTotalLower >= nTarget + _params.nMinChange &&
+      !fExhausted) {
+    std::vector<uint32_t> vSubset;
+    Amount nSubsetBest =
+        approximateBestSubset(nTarget + _params.nMinChange, vSubset);
+    if (nSubsetBest != nTotalLower || nBest == nTotalLower) {
+      nBest = nSubsetBest;
+      vBest.swap(vSubset);
+    }
+  }
+
+  if (fHaveLarger &&
+      ((nBest != nTarget && nBest < nTarget + _params.nMinChange) ||
+       pValues[nLower - 1] <= nBest)) {
+    vPositions.push_back(static_cast<uint32_t>(nLower - 1));
+  } else {
+    for (uint32_t i : vBest)
+      vPositions.push_back(static_cast<uint32_t>(nLower + i));
+  }
+  finish(vPositions, nTarget, SelectionAlgorithm::KNAPSACK, result);
+  result.nTries = nTries;
+  result.fBudgetExhausted = fExhausted;
+  return true;
+}
+
+bool CoinSelector::select(Amount nTarget, SelectionResult &result) const {
+  SelectionResult bnb, knapsack;
+  bool fBnB = selectBnB(nTarget, bnb);
+  bool fKnapsack = selectKnapsack(nTarget, knapsack);
+  if (!fBnB && !fKnapsack)
+    return false;
+  result = fBnB && (!fKnapsack || bnb.nWaste <= knapsack.nWaste)
+               ? std::move(bnb)
+               : std::move(knapsack);
+  return true;
+}
@@ -0,0 +1,91 @@
+#ifndef COINSELECTION_H
+#define COINSELECTION_H
+
+#include <cstdint>
+#include <vector>
+
+#include "transaction.h"
+
+static const size_t TX_OVERHEAD_VSIZE = 11;
+static const size_t P2PKH_INPUT_VSIZE = 148;
+static const size_t P2SH_P2WPKH_INPUT_VSIZE = 91;
+static const size_t P2WPKH_INPUT_VSIZE = 68;
+static const size_t P2WPKH_OUTPUT_VSIZE = 31;
+static const Amount DEFAULT_FEE_RATE = 1000;
+static const Amount DUST_THRESHOLD = 294;
+static const Amount MIN_CHANGE = COIN / 100;
+static const uint64_t DEFAULT_SELECTION_MAX_TRIES = 100000;
+static const uint64_t DEFAULT_KNAPSACK_MAX_STEPS = 10000000;
+static const int KNAPSACK_ITERATIONS = 1000;
+
+Amount getFee(Amount nFeeRate, size_t nVSize);
+size_t getOutputVSize(const TxOut &txout);
+// Estimated vsize of an input spending scriptPubKey with one signature.
+// Unrecognised scripts are charged as P2PKH.
+size_t getInputVSize(const Script &scriptPubKey);
+
+enum class SelectionAlgorithm { NONE, BNB, KNAPSACK };
+
+// Fee rates are in satoshis per 1000 virtual bytes. nChangeInputVSize is the
+// size of the input that later spends a change output. The time budget is a
+// safety cap only; with nMaxMicros == 0 results depend solely on the input
+// set, the target, the try/step limits and nSeed.
+struct CoinSelectionParams {
+  Amount nFeeRate = DEFAULT_FEE_RATE;
+  Amount nLongTermFeeRate = DEFAULT_FEE_RATE;
+  size_t nChangeInputVSize = P2WPKH_INPUT_VSIZE;
+  size_t nChangeOutputVSize = P2WPKH_OUTPUT_VSIZE;
+  Amount nMinChange = MIN_CHANGE;
+  uint64_t nMaxTries = DEFAULT_SELECTION_MAX_TRIES;
+  uint64_t nMaxKnapsackSteps = DEFAULT_KNAPSACK_MAX_STEPS;
+  int64_t nMaxMicros = 0;
+  uint64_t nSeed = 0;
+
+  Amount getInputFee(size_t nInputVSize) const;
+  Amount getInputWaste(size_t nInputVSize) const;
+  Amount getChangeOutputFee() const;
+  Amount getCostOfChange() const;
+};
+
+// vSelected holds indices into the value array given to CoinSelector::reset().
+// BnB results are changeless: nChange is 0 and any excess goes to fees.
+struct SelectionResult {
+  SelectionAlgorithm algorithm = SelectionAlgorithm::NONE;
+  std::vector<uint32_t> vSelected;
+  Amount nSelectedValue = 0;
+  Amount nSelectedEffectiveValue = 0;
+  Amount nChange = 0;
+  Amount nWaste = 0;
+  uint64_t nTries = 0;
+  bool fBudgetExhausted = false;
+};
+
+class CoinSelector {
+private:
+  CoinSelectionParams _params;
+  std::vector<Amount> _vEffectiveValues;
+  std::vector<Amount> _vValues;
+  std::vector<Amount> _vInputWastes;
+  std::vector<uint32_t> _vIndices;
+  std::vector<Amount> _vRemaining;
+
+  void finish(const std::vector<uint32_t> &vPositions, Amount nTarget,
+              SelectionAlgorithm algorithm, SelectionResult &result) const;
+
+public:
+  explicit CoinSelector(
+      const CoinSelectionParams &params = CoinSelectionParams());
+
+  const CoinSelectionParams &getParams() const;
+  // pInputVSizes holds the input vsize of each coin, see getInputVSize().
+  void reset(const Amount *pValues, const size_t *pInputVSizes,
+             size_t nCount);
+  size_t size() const;
+  Amount getTotalEffectiveValue() const;
+
+  bool selectBnB(Amount nTarget, SelectionResult &result) const;
+  bool selectKnapsack(Amount nTarget, SelectionResult &result) const;
+  bool select(Amount nTarget, SelectionResult &result) const;
+};
+
+#endif // COINSELECTION_H
@@ -0,0 +1,63 @@
+# Sources shared by the GUI application and the headless daemon.
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/addressindex.cpp \
+    $$PWD/backup.cpp \
+    $$PWD/berkeley_db.cpp \
+    $$PWD/blockfile.cpp \
+    $$PWD/coincontrol.cpp \
+    $$PWD/coinselection.cpp \
+    $$PWD/crypter.cpp \
+    $$PWD/db.cpp \
+    $$PWD/eventbus.cpp \
+    $$PWD/hash.cpp \
+    $$PWD/key.cpp \
+    $$PWD/keyindex.cpp \
+    $$PWD/keypool.cpp \
+    $$PWD/keysession.cpp \
+    $$PWD/log_db.cpp \
+    $$PWD/psbt.cpp \
+    $$PWD/script.cpp \
+    $$PWD/sign.cpp \
+    $$PWD/threadpool.cpp \
+    $$PWD/transaction.cpp \
+    $$PWD/util.cpp \
+    $$PWD/utxoset.cpp \
+    $$PWD/verifier.cpp \
+    $$PWD/wallet.cpp \
+    $$PWD/walletdb.cpp
+
+HEADERS += \
+    $$PWD/addressindex.h \
+    $$PWD/backup.h \
+    $$PWD/berkeley_db.h \
+    $$PWD/blockfile.h \
+    $$PWD/coincontrol.h \
+    $$PWD/coinselection.h \
+    $$PWD/crypter.h \
+    $$PWD/db.h \
+    $$PWD/eventbus.h \
+    $$PWD/hash.h \
+    $$PWD/key.h \
+    $$PWD/keyindex.h \
+    $$PWD/keypool.h \
+    $$PWD/keysession.h \
+    $$PWD/log_db.h \
+    $$PWD/psbt.h \
+    $$PWD/script.h \
+    $$PWD/sec_block.h \
+    $$PWD/sign.h \
+    $$PWD/threadpool.h \
+    $$PWD/transaction.h \
+    $$PWD/util.h \
+    $$PWD/utxoset.h \
+    $$PWD/verifier.h \
+    $$PWD/wallet.h \
+    $$PWD/walletdb.h
+
+unix|win32: LIBS += \
+    -lcryptopp \
+    -ldb_cxx
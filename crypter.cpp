@@ -1,6 +1,8 @@
 #include <cryptopp/aes.h>
 #include <cryptopp/filters.h>
+#include <cryptopp/gcm.h>
 #include <cryptopp/modes.h>
+#include <cryptopp/osrng.h>
 #include <cryptopp/sha.h>
 
 #include "crypter.h"
@@ -34,6 +36,15 @@ bool Crypter::setKey(const SecureBytes &key, const SecureBytes &iv) {
   return true;
 }
 
+bool Crypter::setIV(const SecureBytes &iv) {
+  if (!_fKeySet || iv.size() != IV_SIZE)
+    return false;
+
+  std::memcpy(_ivPtr->data(), iv.data(), IV_SIZE);
+
+  return true;
+}
+
 bool Crypter::setKeyFromPassphrase(const SecureString &passpharse,
                                    const std::vector<unsigned char> &salt,
                                    const int nRounds) {
@@ -83,9 +94,72 @@ bool Crypter::decrypt(const std::vector<unsigned char> &ciphertext,
   CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption dec(_keyPtr->data(), KEY_SIZE,
                                                     _ivPtr->data());
   CryptoPP::StreamTransformationFilter filter(dec);
-  filter.PutMessageEnd(ciphertext.data(), ciphertext.size());
+  try {
+    filter.PutMessageEnd(ciphertext.data(), ciphertext.size());
+  } catch (const CryptoPP::Exception &) {
+    return false;
+  }
   plaintext.resize(filter.MaxRetrievable());
   filter.Get(plaintext.data(), plaintext.size());
 
   return true;
 }
+
+bool Crypter::encryptAuthenticated(const SecureBytes &plaintext,
+                                   const std::vector<unsigned char> &aad,
+                                   std::vector<unsigned char> &ciphertext) {
+  if (!_fKeySet)
+    return false;
+
+  CryptoPP::GCM<CryptoPP::AES>::Encryption enc;
+  enc.SetKeyWithIV(_keyPtr->data(), KEY_SIZE, _ivPtr->data(), IV_SIZE);
+  ciphertext.resize(plaintext.size() + AUTH_TAG_SIZE);
+  enc.EncryptAndAuthenticate(ciphertext.data(),
+                             ciphertext.data() + plaintext.size(),
+                             AUTH_TAG_SIZE, _ivPtr->data(), IV_SIZE,
+                             aad.data(), aad.size(), plaintext.data(),
+                             plaintext.size());
+
+  return true;
+}
+
+bool Crypter::decryptAuthenticated(const std::vector<unsigned char> &ciphertext,
+                                   const std::vector<unsigned char> &aad,
+                                   SecureBytes &plaintext) {
+  if (!_fKeySet || ciphertext.size() < AUTH_TAG_SIZE)
+    return false;
+
+  size_t nSize = ciphertext.size() - AUTH_TAG_SIZE;
+  CryptoPP::GCM<CryptoPP::AES>::Decryption dec;
+  dec.SetKeyWithIV(_keyPtr->data(), KEY_SIZE, _ivPtr->data(), IV_SIZE);
+  plaintext.resize(nSize);
+  return dec.DecryptAndVerify(plaintext.data(), ciphertext.data() + nSize,
+                              AUTH_TAG_SIZE, _ivPtr->data(), IV_SIZE,
+                              aad.data(), aad.size(), ciphertext.data(),
+                              nSize);
+}
+
+void getRandBytes(unsigned char *data, size_t size) {
+  static thread_local CryptoPP::AutoSeededRandomPool rng;
+  rng.GenerateBlock(data, size);
+}
+
+bool encryptSecret(const SecureBytes &masterKey, const SecureBytes &plaintext,
+                   const uint256 &ivSeed,
+                   std::vector<unsigned char> &ciphertext) {
+  SecureBytes iv(ivSeed.begin(), ivSeed.begin() + IV_SIZE);
+  Crypter crypter;
+  if (!crypter.setKey(masterKey, iv))
+    return false;
+  return crypter.encrypt(plaintext, ciphertext);
+}
+
+bool decryptSecret(const SecureBytes &masterKey,
+                   const std::vector<unsigned char> &ciphertext,
+                   const uint256 &ivSeed, SecureBytes &plaintext) {
+  SecureBytes iv(ivSeed.begin(), ivSeed.begin() + IV_SIZE);
+  Crypter crypter;
+  if (!crypter.setKey(masterKey, iv))
+    return false;
+  return crypter.decrypt(ciphertext, plaintext);
+}
@@ -6,11 +6,20 @@
 
 #include <cryptopp/aes.h>
 
+#include "hash.h"
 #include "sec_block.h"
 
 const int KEY_SIZE = CryptoPP::AES::DEFAULT_KEYLENGTH;
 const int IV_SIZE = CryptoPP::AES::BLOCKSIZE;
 const int SALT_SIZE = 8;
+const int AUTH_TAG_SIZE = 16;
+const int DEFAULT_DERIVE_ITERATIONS = 25000;
+
+struct MasterKey {
+  std::vector<unsigned char> cryptedKey;
+  std::vector<unsigned char> salt;
+  int nDeriveIterations;
+};
 
 class Crypter {
 private:
@@ -25,6 +34,7 @@ public:
   ~Crypter();
 
   bool setKey(const SecureBytes &key, const SecureBytes &iv);
+  bool setIV(const SecureBytes &iv);
   bool setKeyFromPassphrase(const SecureString &passpharse,
                             const std::vector<unsigned char> &salt,
                             const int nRounds);
@@ -32,6 +42,23 @@ public:
                std::vector<unsigned char> &ciphertext);
   bool decrypt(const std::vector<unsigned char> &ciphertext,
                SecureBytes &plaintext);
+  // AES-GCM with the current key and IV; the tag is appended to the
+  // ciphertext and covers aad as well.
+  bool encryptAuthenticated(const SecureBytes &plaintext,
+                            const std::vector<unsigned char> &aad,
+                            std::vector<unsigned char> &ciphertext);
+  bool decryptAuthenticated(const std::vector<unsigned char> &ciphertext,
+                            const std::vector<unsigned char> &aad,
+                            SecureBytes &plaintext);
 };
 
+void getRandBytes(unsigned char *data, size_t size);
+
+bool encryptSecret(const SecureBytes &masterKey, const SecureBytes &plaintext,
+                   const uint256 &ivSeed,
+                   std::vector<unsigned char> &ciphertext);
+bool decryptSecret(const SecureBytes &masterKey,
+                   const std::vector<unsigned char> &ciphertext,
+                   const uint256 &ivSeed, SecureBytes &plaintext);
+
 #endif // CRYPTER_H
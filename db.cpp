@@ -0,0 +1,63 @@
+#include <cstring>
+
+#include "db.h"
+#include "util.h"
+
+static bool hasEnvelope(const QByteArray &value) {
+  return value.size() >= RECORD_ENVELOPE_SIZE &&
+         std::memcmp(value.constData(), RECORD_ENVELOPE_MAGIC,
+                     sizeof(RECORD_ENVELOPE_MAGIC)) == 0;
+}
+
+static uint32_t checksum(const char *pData, int nSize) {
+  return crc32(reinterpret_cast<const unsigned char *>(pData), nSize);
+}
+
+QByteArray DatabaseBatch::sealValue(const QByteArray &value) const {
+  if (!_pWalletDatabase->isChecksummed())
+    return value;
+
+  uint32_t nChecksum = checksum(value.constData(), value.size());
+  unsigned char checksumData[4];
+  for (int i = 0; i < 4; i++)
+    checksumData[i] = (nChecksum >> (8 * i)) & 0xFF;
+
+  QByteArray sealed(RECORD_ENVELOPE_MAGIC, sizeof(RECORD_ENVELOPE_MAGIC));
+  sealed.append(reinterpret_cast<const char *>(checksumData), 4);
+  sealed.append(value);
+  return sealed;
+}
+
+bool DatabaseBatch::checkRecord(const QByteArray &key, QByteArray &value) {
+  if (!hasEnvelope(value))
+    return true;
+
+  const unsigned char *pChecksum = reinterpret_cast<const unsigned char *>(
+      value.constData() + sizeof(RECORD_ENVELOPE_MAGIC));
+  uint32_t nChecksum = 0;
+  for (int i = 0; i < 4; i++)
+    nChecksum |= uint32_t(pChecksum[i]) << (8 * i);
+  if (checksum(value.constData() + RECORD_ENVELOPE_SIZE,
+               value.size() - RECORD_ENVELOPE_SIZE) != nChecksum) {
+    _pWalletDatabase->reportCorrupt(key);
+    return false;
+  }
+  value = value.mid(RECORD_ENVELOPE_SIZE);
+  return true;
+}
+
+void WalletDatabase::setChecksums(bool fChecksums) {
+  _fChecksums = fChecksums;
+}
+
+bool WalletDatabase::isChecksummed() const { return _fChecksums; }
+
+void WalletDatabase::reportCorrupt(const QByteArray &key) {
+  const std::lock_guard<std::mutex> lock(_mutexCorrupt);
+  _corruptKeys.insert(key);
+}
+
+std::vector<QByteArray> WalletDatabase::getCorruptKeys() {
+  const std::lock_guard<std::mutex> lock(_mutexCorrupt);
+  return std::vector<QByteArray>(_corruptKeys.begin(), _corruptKeys.end());
+}
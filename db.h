@@ -0,0 +1,139 @@
+#ifndef DB_H
+#define DB_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <QByteArray>
+#include <QDataStream>
+
+static const char RECORD_ENVELOPE_MAGIC[8] = {'\xf3', 'w', 'c', 's',
+                                              'u',    'm', 0,   1};
+static const int RECORD_ENVELOPE_SIZE = 12;
+
+class WalletDatabase;
+
+class DatabaseCursor {
+public:
+  virtual ~DatabaseCursor() {}
+
+  virtual bool next(QByteArray &key, QByteArray &value) = 0;
+  // The next call to next() returns the first record whose key is not less
+  // than key.
+  virtual void seek(const QByteArray &key) = 0;
+};
+
+// With checksums enabled on the database, values are written as
+// magic || crc32(value) || value. Reads accept both forms, so older records
+// stay readable; an envelope whose checksum does not match is reported to the
+// database and the read fails.
+class DatabaseBatch {
+private:
+  WalletDatabase *_pWalletDatabase;
+
+  virtual bool readKey(const QByteArray &key, QByteArray &value) = 0;
+  virtual bool writeKey(const QByteArray &key, const QByteArray &value,
+                        bool fOverwrite) = 0;
+  virtual bool eraseKey(const QByteArray &key) = 0;
+  virtual bool hasKey(const QByteArray &key) = 0;
+
+  template <typename K> static QByteArray serializeKey(const K &key) {
+    QByteArray keyArray;
+    QDataStream keyStream(&keyArray, QIODevice::ReadWrite);
+    keyStream << key;
+    return keyArray;
+  }
+
+  QByteArray sealValue(const QByteArray &value) const;
+
+public:
+  explicit DatabaseBatch(WalletDatabase &database)
+      : _pWalletDatabase(&database) {}
+  virtual ~DatabaseBatch() {}
+
+  virtual void flush() = 0;
+  virtual void close() = 0;
+
+  virtual bool TxnBegin() = 0;
+  virtual bool TxnCommit() = 0;
+  virtual bool TxnAbort() = 0;
+
+  virtual std::unique_ptr<DatabaseCursor> getNewCursor() = 0;
+
+  // Strips the envelope from a raw value; false if its checksum is wrong.
+  bool checkRecord(const QByteArray &key, QByteArray &value);
+
+  // Writes a record exactly as a cursor returned it.
+  bool writeRaw(const QByteArray &key, const QByteArray &value) {
+    return writeKey(key, value, true);
+  }
+
+  template <typename K, typename T> bool read(const K &key, T &value) {
+    QByteArray keyArray = serializeKey(key);
+    QByteArray valueArray;
+    if (!readKey(keyArray, valueArray) || !checkRecord(keyArray, valueArray))
+      return false;
+    try {
+      QDataStream valueStream(&valueArray, QIODevice::ReadOnly);
+      valueStream >> value;
+      return valueStream.status() == QDataStream::Ok;
+    } catch (...) {
+      return false;
+    }
+  }
+
+  template <typename K, typename T>
+  bool write(const K &key, const T &value, bool fOverwrite = true) {
+    QByteArray valueArray;
+    QDataStream valueStream(&valueArray, QIODevice::ReadWrite);
+    valueStream << value;
+    QByteArray sealedArray = sealValue(valueArray);
+    bool ret = writeKey(serializeKey(key), sealedArray, fOverwrite);
+    // Values may be secrets; the engines leave caller buffers alone, so the
+    // copies made here are scrubbed here.
+    valueArray.fill(0);
+    sealedArray.fill(0);
+    return ret;
+  }
+
+  template <typename K> bool erase(const K &key) {
+    return eraseKey(serializeKey(key));
+  }
+
+  template <typename K> bool exists(const K &key) {
+    return hasKey(serializeKey(key));
+  }
+};
+
+class WalletDatabase {
+private:
+  std::atomic<bool> _fChecksums;
+  std::mutex _mutexCorrupt;
+  std::set<QByteArray> _corruptKeys;
+
+public:
+  WalletDatabase() : _fChecksums(false) {}
+  virtual ~WalletDatabase() {}
+
+  void setChecksums(bool fChecksums);
+  bool isChecksummed() const;
+  void reportCorrupt(const QByteArray &key);
+  std::vector<QByteArray> getCorruptKeys();
+
+  virtual std::string getFileName() const = 0;
+  virtual std::string getEngineName() const = 0;
+
+  virtual std::unique_ptr<DatabaseBatch> makeBatch(bool isReadOnly = false,
+                                                   bool isCreate = false) = 0;
+  virtual void close() = 0;
+  virtual void backup(const std::string &pathDest) = 0;
+  // Rebuilds the file from its live records so erased values do not linger in
+  // free space or logs. Blocks the file system frees are not overwritten.
+  virtual bool rewrite() = 0;
+};
+
+#endif // DB_H
@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <unordered_map>
+
+#include "eventbus.h"
+
+static bool mergeChange(ChangeType &status, ChangeType next) {
+  if (status == CT_NEW && next == CT_DELETED)
+    return false;
+  if (status == CT_NEW && next == CT_UPDATED)
+    return true;
+  status = status == CT_DELETED && next == CT_NEW ? CT_UPDATED : next;
+  return true;
+}
+
+class EventBusHandler : public Handler {
+private:
+  WalletEventBus *_pBus;
+  uint64_t _nId;
+
+public:
+  EventBusHandler(WalletEventBus *pBus, uint64_t nId)
+      : _pBus(pBus), _nId(nId) {}
+  ~EventBusHandler() { disconnect(); }
+
+  void disconnect() override {
+    if (!_pBus)
+      return;
+    _pBus->unsubscribe(_nId);
+    _pBus = nullptr;
+  }
+};
+
+bool WalletDelta::empty() const { return nEvents == 0; }
+
+WalletEventBus::WalletEventBus()
+    : _pHead(nullptr), _nSubscribers(0), _nPosted(0), _nBatches(0),
+      _nDelivered(0), _nLastBatchEvents(0) {
+  _nNextSubscriberId = 0;
+}
+
+WalletEventBus::~WalletEventBus() {
+  Node *pNode = _pHead.exchange(nullptr);
+  while (pNode) {
+    Node *pNext = pNode->pNext;
+    delete pNode;
+    pNode = pNext;
+  }
+}
+
+void WalletEventBus::post(Node *pNode) {
+  pNode->pNext = _pHead.load(std::memory_order_relaxed);
+  while (!_pHead.compare_exchange_weak(pNode->pNext, pNode,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+  }
+  _nPosted.fetch_add(1, std::memory_order_relaxed);
+  if (pNode->pNext)
+    return;
+
+  const std::lock_guard<std::mutex> lock(_mutexSubscribers);
+  for (auto &subscriber : _subscribers) {
+    if (subscriber.wakeup)
+      subscriber.wakeup();
+  }
+}
+
+void WalletEventBus::notifyTransactionChanged(const uint256 &txid,
+                                              ChangeType status) {
+  if (_nSubscribers == 0)
+    return;
+  Node *pNode = new Node();
+  pNode->event.type = Event::TRANSACTION_CHANGED;
+  pNode->event.txid = txid;
+  pNode->event.status = status;
+  post(pNode);
+}
+
+void WalletEventBus::notifyAddressBookChanged(const KeyID &address,
+                                              const std::string &label,
+                                              bool fIsMine,
+                                              const std::string &purpose,
+                                              ChangeType status) {
+  if (_nSubscribers == 0)
+    return;
+  Node *pNode = new Node();
+  pNode->event.type = Event::ADDRESS_BOOK_CHANGED;
+  pNode->event.address = address;
+  pNode->event.text = label;
+  pNode->event.fIsMine = fIsMine;
+  pNode->event.purpose = purpose;
+  pNode->event.status = status;
+  post(pNode);
+}
+
+void WalletEventBus::notifyStatusChanged() {
+  if (_nSubscribers == 0)
+    return;
+  Node *pNode = new Node();
+  pNode->event.type = Event::STATUS_CHANGED;
+  post(pNode);
+}
+
+void WalletEventBus::notifyShowProgress(const std::string &title,
+                                        int nProgress) {
+  if (_nSubscribers == 0)
+    return;
+  Node *pNode = new Node();
+  pNode->event.type = Event::SHOW_PROGRESS;
+  pNode->event.text = title;
+  pNode->event.nProgress = nProgress;
+  post(pNode);
+}
+
+void WalletEventBus::notifyCanGetAddressesChanged() {
+  if (_nSubscribers == 0)
+    return;
+  Node *pNode = new Node();
+  pNode->event.type = Event::CAN_GET_ADDRESSES_CHANGED;
+  post(pNode);
+}
+
+std::unique_ptr<Handler> WalletEventBus::subscribe(WalletChangedFn fn,
+                                                   WakeupFn wakeup) {
+  const std::lock_guard<std::mutex> lock(_mutexSubscribers);
+  uint64_t nId = _nNextSubscriberId++;
+  _subscribers.push_back({nId, std::move(fn), std::move(wakeup)});
+  _nSubscribers = _subscribers.size();
+  return std::unique_ptr<Handler>(new EventBusHandler(this, nId));
+}
+
+void WalletEventBus::unsubscribe(uint64_t nId) {
+  const std::lock_guard<std::mutex> lock(_mutexSubscribers);
+  _subscribers.erase(
+      std::remove_if(_subscribers.begin(), _subscribers.end(),
+                     [nId](const Subscriber &subscriber) {
+                       return subscriber.nId == nId;
+                     }),
+      _subscribers.end());
+  _nSubscribers = _subscribers.size();
+}
+
+bool WalletEventBus::hasPending() const {
+  return _pHead.load(std::memory_order_relaxed) != nullptr;
+}
+
+void WalletEventBus::coalesce(Node *pNode, WalletDelta &delta) {
+  std::unordered_map<uint256, size_t, ArrayHasher> mapTransactions;
+  std::unordered_map<KeyID, size_t, ArrayHasher> mapAddresses;
+  std::vector<bool> vTxDropped, vAddressDropped;
+  for (; pNode; pNode = pNode->pNext) {
+    const Event &event = pNode->event;
+    delta.nEvents++;
+    switch (event.type) {
+    case Event::TRANSACTION_CHANGED: {
+      auto it = mapTransactions.find(event.txid);
+      if (it == mapTransactions.end() || vTxDropped[it->second]) {
+        mapTransactions[event.txid] = delta.transactions.size();
+        delta.transactions.push_back({event.txid, event.status});
+        vTxDropped.push_back(false);
+      } else if (!mergeChange(delta.transactions[it->second].status,
+                              event.status)) {
+        vTxDropped[it->second] = true;
+      }
+      break;
+    }
+    case Event::ADDRESS_BOOK_CHANGED: {
+      AddressBookChange change{event.address, event.text, event.fIsMine,
+                               event.purpose, event.status};
+      auto it = mapAddresses.find(event.address);
+      if (it == mapAddresses.end() || vAddressDropped[it->second]) {
+        mapAddresses[event.address] = delta.addressBook.size();
+        delta.addressBook.push_back(change);
+        vAddressDropped.push_back(false);
+      } else {
+        AddressBookChange &prev = delta.addressBook[it->second];
+        change.status = prev.status;
+        if (!mergeChange(change.status, event.status))
+          vAddressDropped[it->second] = true;
+        prev = change;
+      }
+      break;
+    }
+    case Event::STATUS_CHANGED:
+      delta.fStatusChanged = true;
+      break;
+    case Event::SHOW_PROGRESS:
+      delta.fProgressChanged = true;
+      delta.progressTitle = event.text;
+      delta.nProgress = event.nProgress;
+      break;
+    case Event::CAN_GET_ADDRESSES_CHANGED:
+      delta.fCanGetAddressesChanged = true;
+      break;
+    }
+  }
+
+  size_t nKept = 0;
+  for (size_t i = 0; i < delta.transactions.size(); i++) {
+    if (!vTxDropped[i])
+      delta.transactions[nKept++] = delta.transactions[i];
+  }
+  delta.transactions.resize(nKept);
+  nKept = 0;
+  for (size_t i = 0; i < delta.addressBook.size(); i++) {
+    if (!vAddressDropped[i])
+      delta.addressBook[nKept++] = delta.addressBook[i];
+  }
+  delta.addressBook.resize(nKept);
+}
+
+size_t WalletEventBus::deliver() {
+  Node *pNode = _pHead.exchange(nullptr, std::memory_order_acquire);
+  if (!pNode)
+    return 0;
+
+  Node *pPrev = nullptr;
+  while (pNode) {
+    Node *pNext = pNode->pNext;
+    pNode->pNext = pPrev;
+    pPrev = pNode;
+    pNode = pNext;
+  }
+
+  WalletDelta delta;
+  coalesce(pPrev, delta);
+  while (pPrev) {
+    Node *pNext = pPrev->pNext;
+    delete pPrev;
+    pPrev = pNext;
+  }
+
+  std::vector<WalletChangedFn> subscribers;
+  {
+    const std::lock_guard<std::mutex> lock(_mutexSubscribers);
+    for (auto &subscriber : _subscribers)
+      subscribers.push_back(subscriber.fn);
+  }
+  for (auto &fn : subscribers)
+    fn(delta);
+
+  _nBatches++;
+  _nDelivered += delta.nEvents;
+  _nLastBatchEvents = delta.nEvents;
+  return delta.nEvents;
+}
+
+EventBusMetrics WalletEventBus::getMetrics() {
+  EventBusMetrics metrics;
+  metrics.nPosted = _nPosted;
+  metrics.nBatches = _nBatches;
+  metrics.nDelivered = _nDelivered;
+  metrics.nLastBatchEvents = _nLastBatchEvents;
+  return metrics;
+}
@@ -0,0 +1,146 @@
+#ifndef EVENTBUS_H
+#define EVENTBUS_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hash.h"
+#include "key.h"
+
+enum ChangeType { CT_NEW, CT_UPDATED, CT_DELETED };
+
+struct TransactionChange {
+  uint256 txid;
+  ChangeType status;
+};
+
+struct AddressBookChange {
+  KeyID address;
+  std::string label;
+  bool fIsMine;
+  std::string purpose;
+  ChangeType status;
+};
+
+struct WalletDelta {
+  std::vector<TransactionChange> transactions;
+  std::vector<AddressBookChange> addressBook;
+  bool fStatusChanged = false;
+  bool fCanGetAddressesChanged = false;
+  bool fProgressChanged = false;
+  std::string progressTitle;
+  int nProgress = 0;
+  uint64_t nEvents = 0;
+
+  bool empty() const;
+};
+
+struct EventBusMetrics {
+  uint64_t nPosted;
+  uint64_t nBatches;
+  uint64_t nDelivered;
+  uint64_t nLastBatchEvents;
+};
+
+typedef std::function<void(const WalletDelta &delta)> WalletChangedFn;
+typedef std::function<void(const uint256 &txid, ChangeType status)>
+    TransactionChangedFn;
+typedef std::function<void(const KeyID &address, const std::string &label,
+                           bool is_mine, const std::string &purpose,
+                           ChangeType status)>
+    AddressBookChangedFn;
+typedef std::function<void()> StatusChangedFn;
+typedef std::function<void(const std::string &title, int progress)>
+    ShowProgressFn;
+typedef std::function<void()> CanGetAddressesChangedFn;
+typedef std::function<void()> WakeupFn;
+
+class Handler {
+public:
+  virtual ~Handler() {}
+  virtual void disconnect() = 0;
+};
+
+// Producers push onto a lock-free stack from any thread. The consumer takes
+// the whole stack in one exchange, restores posting order and folds it into a
+// single WalletDelta, so subscribers run once per deliver() however many
+// events arrived in between. Each subscriber may pass a wakeup function; all
+// of them are called, under the subscriber lock, when the queue goes from
+// empty to non-empty so a consumer can schedule one delivery. A wakeup must
+// not call back into the bus and is dropped with its subscription.
+class WalletEventBus {
+private:
+  struct Event {
+    enum Type {
+      TRANSACTION_CHANGED,
+      ADDRESS_BOOK_CHANGED,
+      STATUS_CHANGED,
+      SHOW_PROGRESS,
+      CAN_GET_ADDRESSES_CHANGED,
+    } type;
+    uint256 txid;
+    KeyID address;
+    std::string text;
+    std::string purpose;
+    bool fIsMine;
+    ChangeType status;
+    int nProgress;
+  };
+
+  struct Node {
+    Event event;
+    Node *pNext;
+  };
+
+  std::atomic<Node *> _pHead;
+  std::atomic<size_t> _nSubscribers;
+  struct Subscriber {
+    uint64_t nId;
+    WalletChangedFn fn;
+    WakeupFn wakeup;
+  };
+
+  std::vector<Subscriber> _subscribers;
+  uint64_t _nNextSubscriberId;
+  std::mutex _mutexSubscribers;
+
+  std::atomic<uint64_t> _nPosted;
+  std::atomic<uint64_t> _nBatches;
+  std::atomic<uint64_t> _nDelivered;
+  std::atomic<uint64_t> _nLastBatchEvents;
+
+  void post(Node *pNode);
+  void unsubscribe(uint64_t nId);
+  static void coalesce(Node *pNode, WalletDelta &delta);
+
+  friend class EventBusHandler;
+
+public:
+  WalletEventBus();
+  ~WalletEventBus();
+
+  WalletEventBus(const WalletEventBus &) = delete;
+  WalletEventBus &operator=(const WalletEventBus &) = delete;
+
+  void notifyTransactionChanged(const uint256 &txid, ChangeType status);
+  void notifyAddressBookChanged(const KeyID &address, const std::string &label,
+                                bool fIsMine, const std::string &purpose,
+                                ChangeType status);
+  void notifyStatusChanged();
+  void notifyShowProgress(const std::string &title, int nProgress);
+  void notifyCanGetAddressesChanged();
+
+  std::unique_ptr<Handler> subscribe(WalletChangedFn fn,
+                                     WakeupFn wakeup = WakeupFn());
+  bool hasPending() const;
+  size_t deliver();
+  EventBusMetrics getMetrics();
+};
+
+#endif // EVENTBUS_H
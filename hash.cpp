@@ -0,0 +1,28 @@
+#include <cryptopp/ripemd.h>
+#include <cryptopp/sha.h>
+
+#include "hash.h"
+
+uint256 hash256(const unsigned char *data, size_t size) {
+  uint256 result;
+  CryptoPP::SHA256 hash;
+  hash.Update(data, size);
+  hash.Final(result.data());
+  hash.Restart();
+  hash.Update(result.data(), result.size());
+  hash.Final(result.data());
+  return result;
+}
+
+uint160 hash160(const unsigned char *data, size_t size) {
+  uint256 sha;
+  CryptoPP::SHA256 hashSha;
+  hashSha.Update(data, size);
+  hashSha.Final(sha.data());
+
+  uint160 result;
+  CryptoPP::RIPEMD160 hashRipemd;
+  hashRipemd.Update(sha.data(), sha.size());
+  hashRipemd.Final(result.data());
+  return result;
+}
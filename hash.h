@@ -0,0 +1,32 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+
+typedef std::array<unsigned char, 20> uint160;
+typedef std::array<unsigned char, 32> uint256;
+
+uint256 hash256(const unsigned char *data, size_t size);
+uint160 hash160(const unsigned char *data, size_t size);
+
+template <typename T> uint256 hash256(const T &data) {
+  return hash256(data.data(), data.size());
+}
+
+template <typename T> uint160 hash160(const T &data) {
+  return hash160(data.data(), data.size());
+}
+
+struct ArrayHasher {
+  template <size_t N>
+  size_t operator()(const std::array<unsigned char, N> &data) const {
+    static_assert(N >= sizeof(size_t), "Array is too short to be hashed");
+    size_t value;
+    std::memcpy(&value, data.data(), sizeof(value));
+    return value;
+  }
+};
+
+#endif // HASH_H
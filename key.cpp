@@ -0,0 +1,172 @@
+#include <cryptopp/asn.h>
+#include <cryptopp/eccrypto.h>
+#include <cryptopp/oids.h>
+#include <cryptopp/osrng.h>
+
+#include "key.h"
+
+typedef CryptoPP::ECDSA<CryptoPP::ECP, CryptoPP::SHA256> ECDSASecp256k1;
+
+static CryptoPP::RandomNumberGenerator &getRng() {
+  static thread_local CryptoPP::AutoSeededRandomPool rng;
+  return rng;
+}
+
+static const CryptoPP::DL_GroupParameters_EC<CryptoPP::ECP> &getParams() {
+  static const CryptoPP::DL_GroupParameters_EC<CryptoPP::ECP> params(
+      CryptoPP::ASN1::secp256k1());
+  return params;
+}
+
+static void encodeDERInteger(const CryptoPP::Integer &n,
+                             std::vector<unsigned char> &out) {
+  std::vector<unsigned char> data(n.MinEncodedSize());
+  n.Encode(data.data(), data.size());
+  if (data[0] & 0x80)
+    data.insert(data.begin(), 0x00);
+  out.push_back(0x02);
+  out.push_back(static_cast<unsigned char>(data.size()));
+  out.insert(out.end(), data.begin(), data.end());
+}
+
+static bool decodeDERInteger(const std::vector<unsigned char> &in,
+                             size_t &nPos, CryptoPP::Integer &n) {
+  if (nPos + 2 > in.size() || in[nPos] != 0x02)
+    return false;
+  size_t nSize = in[nPos + 1];
+  nPos += 2;
+  // Minimal, positive encodings only, as in BIP 66.
+  if (nSize == 0 || nSize > 33 || nPos + nSize > in.size() ||
+      (in[nPos] & 0x80) ||
+      (nSize > 1 && in[nPos] == 0x00 && !(in[nPos + 1] & 0x80)))
+    return false;
+  n = CryptoPP::Integer(in.data() + nPos, nSize);
+  nPos += nSize;
+  return true;
+}
+
+PubKey::PubKey() {}
+
+PubKey::PubKey(const std::vector<unsigned char> &data) { _data = data; }
+
+bool PubKey::isValid() const {
+  return _data.size() == PUBKEY_SIZE && (_data[0] == 0x02 || _data[0] == 0x03);
+}
+
+const std::vector<unsigned char> &PubKey::data() const { return _data; }
+
+KeyID PubKey::getID() const { return hash160(_data); }
+
+bool PubKey::verify(const uint256 &hash,
+                    const std::vector<unsigned char> &signature) const {
+  if (!isValid())
+    return false;
+
+  try {
+    ECDSASecp256k1::PublicKey publicKey;
+    publicKey.AccessGroupParameters().Initialize(CryptoPP::ASN1::secp256k1());
+    CryptoPP::ECP::Point point;
+    if (!publicKey.GetGroupParameters().GetCurve().DecodePoint(
+            point, _data.data(), _data.size()))
+      return false;
+    publicKey.SetPublicElement(point);
+
+    // DER-encoded (r, s) over the digest itself, which is not hashed again.
+    if (signature.size() < 8 || signature.size() > 72 ||
+        signature[0] != 0x30 || signature[1] != signature.size() - 2)
+      return false;
+    size_t nPos = 2;
+    CryptoPP::Integer r, s;
+    if (!decodeDERInteger(signature, nPos, r) ||
+        !decodeDERInteger(signature, nPos, s) || nPos != signature.size())
+      return false;
+    const CryptoPP::Integer &n = getParams().GetSubgroupOrder();
+    if (r.IsZero() || s.IsZero() || r >= n || s >= n)
+      return false;
+    CryptoPP::Integer e(hash.data(), hash.size());
+    return CryptoPP::DL_Algorithm_ECDSA<CryptoPP::ECP>().Verify(
+        getParams(), publicKey, e, r, s);
+  } catch (const CryptoPP::Exception &) {
+    return false;
+  }
+}
+
+bool PubKey::operator==(const PubKey &other) const {
+  return _data == other._data;
+}
+
+bool PubKey::operator!=(const PubKey &other) const {
+  return !(*this == other);
+}
+
+Key::Key() {}
+
+bool Key::isValid() const { return _secret.size() == SECRET_SIZE; }
+
+const SecureBytes &Key::getSecret() const { return _secret; }
+
+void Key::makeNewKey() {
+  ECDSASecp256k1::PrivateKey privateKey;
+  privateKey.Initialize(getRng(), CryptoPP::ASN1::secp256k1());
+  _secret.resize(SECRET_SIZE);
+  privateKey.GetPrivateExponent().Encode(_secret.data(), SECRET_SIZE);
+}
+
+bool Key::set(const SecureBytes &secret) {
+  if (secret.size() != SECRET_SIZE)
+    return false;
+  _secret = secret;
+  return true;
+}
+
+void Key::clear() { SecureBytes().swap(_secret); }
+
+PubKey Key::getPubKey() const {
+  if (!isValid())
+    return PubKey();
+
+  ECDSASecp256k1::PrivateKey privateKey;
+  privateKey.Initialize(CryptoPP::ASN1::secp256k1(),
+                        CryptoPP::Integer(_secret.data(), _secret.size()));
+  ECDSASecp256k1::PublicKey publicKey;
+  privateKey.MakePublicKey(publicKey);
+
+  const CryptoPP::ECP::Point &point = publicKey.GetPublicElement();
+  std::vector<unsigned char> data(PUBKEY_SIZE);
+  data[0] = point.y.IsOdd() ? 0x03 : 0x02;
+  point.x.Encode(data.data() + 1, PUBKEY_SIZE - 1);
+  return PubKey(data);
+}
+
+bool Key::verifyPubKey(const PubKey &pubKey) const {
+  return getPubKey() == pubKey;
+}
+
+bool Key::sign(const uint256 &hash,
+               std::vector<unsigned char> &signature) const {
+  if (!isValid())
+    return false;
+
+  const CryptoPP::DL_GroupParameters_EC<CryptoPP::ECP> &params = getParams();
+  const CryptoPP::Integer &n = params.GetSubgroupOrder();
+  CryptoPP::Integer x(_secret.data(), _secret.size());
+  CryptoPP::Integer e(hash.data(), hash.size());
+  CryptoPP::Integer r, s;
+  CryptoPP::DL_Algorithm_ECDSA<CryptoPP::ECP> algorithm;
+  do {
+    CryptoPP::Integer k(getRng(), CryptoPP::Integer::One(), n - 1);
+    algorithm.Sign(params, x, k, e, r, s);
+  } while (r.IsZero() || s.IsZero());
+  // Bitcoin only relays low-S signatures.
+  if (s > (n >> 1))
+    s = n - s;
+
+  std::vector<unsigned char> sequence;
+  encodeDERInteger(r, sequence);
+  encodeDERInteger(s, sequence);
+  signature.clear();
+  signature.push_back(0x30);
+  signature.push_back(static_cast<unsigned char>(sequence.size()));
+  signature.insert(signature.end(), sequence.begin(), sequence.end());
+  return true;
+}
@@ -0,0 +1,52 @@
+#ifndef KEY_H
+#define KEY_H
+
+#include <vector>
+
+#include "hash.h"
+#include "sec_block.h"
+
+const int SECRET_SIZE = 32;
+const int PUBKEY_SIZE = 33;
+
+typedef uint160 KeyID;
+
+class PubKey {
+private:
+  std::vector<unsigned char> _data;
+
+public:
+  PubKey();
+  explicit PubKey(const std::vector<unsigned char> &data);
+
+  bool isValid() const;
+  const std::vector<unsigned char> &data() const;
+  KeyID getID() const;
+
+  bool verify(const uint256 &hash,
+              const std::vector<unsigned char> &signature) const;
+
+  bool operator==(const PubKey &other) const;
+  bool operator!=(const PubKey &other) const;
+};
+
+class Key {
+private:
+  SecureBytes _secret;
+
+public:
+  Key();
+
+  bool isValid() const;
+  const SecureBytes &getSecret() const;
+
+  void makeNewKey();
+  bool set(const SecureBytes &secret);
+  void clear();
+
+  PubKey getPubKey() const;
+  bool verifyPubKey(const PubKey &pubKey) const;
+  bool sign(const uint256 &hash, std::vector<unsigned char> &signature) const;
+};
+
+#endif // KEY_H
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include "keyindex.h"
+
+KeyIndex::KeyIndex() {
+  _pSlots = nullptr;
+  _nCapacity = 0;
+  _nUsed = 0;
+  allocate(KEYINDEX_MIN_CAPACITY);
+}
+
+size_t KeyIndex::hashSlot(const uint160 &id, uint8_t nType) {
+  uint64_t value;
+  std::memcpy(&value, id.data(), sizeof(value));
+  return static_cast<size_t>(value ^ (nType * 0x9e3779b97f4a7c15ULL));
+}
+
+void KeyIndex::allocate(size_t nCapacity) {
+  _storage.assign(nCapacity * sizeof(Slot) + KEYINDEX_CACHE_LINE, 0);
+  uintptr_t address = reinterpret_cast<uintptr_t>(_storage.data());
+  address = (address + KEYINDEX_CACHE_LINE - 1) & ~(KEYINDEX_CACHE_LINE - 1);
+  _pSlots = reinterpret_cast<Slot *>(address);
+  _nCapacity = nCapacity;
+  _nUsed = 0;
+}
+
+void KeyIndex::rehash(size_t nCapacity) {
+  std::vector<Slot> slots;
+  slots.reserve(_nUsed);
+  for (size_t i = 0; i < _nCapacity; i++) {
+    if (_pSlots[i].nType != KEYINDEX_EMPTY)
+      slots.push_back(_pSlots[i]);
+  }
+
+  allocate(nCapacity);
+  for (auto &slot : slots)
+    insertSlot(slot.id, slot.nType, slot.nValue);
+}
+
+void KeyIndex::insertSlot(const uint160 &id, uint8_t nType, uint32_t nValue) {
+  if ((_nUsed + 1) * 2 > _nCapacity)
+    rehash(_nCapacity * 2);
+
+  size_t nMask = _nCapacity - 1;
+  for (size_t i = hashSlot(id, nType) & nMask;; i = (i + 1) & nMask) {
+    Slot &slot = _pSlots[i];
+    if (slot.nType == KEYINDEX_EMPTY) {
+      slot.id = id;
+      slot.nType = nType;
+      slot.nValue = nValue;
+      _nUsed++;
+      return;
+    }
+    if (slot.nType == nType && slot.id == id) {
+      slot.nValue = nValue;
+      return;
+    }
+  }
+}
+
+const KeyIndex::Slot *KeyIndex::findSlot(const uint160 &id,
+                                         uint8_t nType) const {
+  size_t nMask = _nCapacity - 1;
+  for (size_t i = hashSlot(id, nType) & nMask;; i = (i + 1) & nMask) {
+    const Slot &slot = _pSlots[i];
+    if (slot.nType == KEYINDEX_EMPTY)
+      return nullptr;
+    if (slot.nType == nType && slot.id == id)
+      return &slot;
+  }
+}
+
+void KeyIndex::reserve(size_t nKeys) {
+  const std::lock_guard<std::shared_timed_mutex> lock(_mutexIndex);
+  size_t nCapacity = _nCapacity;
+  while (nCapacity < nKeys * 4)
+    nCapacity *= 2;
+  if (nCapacity != _nCapacity)
+    rehash(nCapacity);
+  _vPubKeys.reserve(nKeys);
+}
+
+void KeyIndex::clear() {
+  const std::lock_guard<std::shared_timed_mutex> lock(_mutexIndex);
+  allocate(KEYINDEX_MIN_CAPACITY);
+  _vPubKeys.clear();
+}
+
+void KeyIndex::addKey(const PubKey &pubKey) {
+  if (!pubKey.isValid())
+    return;
+
+  KeyID address = pubKey.getID();
+  ScriptID scriptId = getScriptID(getScriptForWitnessPubKeyHash(address));
+
+  const std::lock_guard<std::shared_timed_mutex> lock(_mutexIndex);
+  if (findSlot(address, KEYINDEX_KEY))
+    return;
+
+  uint32_t nValue = _vPubKeys.size();
+  _vPubKeys.emplace_back();
+  std::copy(pubKey.data().begin(), pubKey.data().end(),
+            _vPubKeys.back().begin());
+  insertSlot(address, KEYINDEX_KEY, nValue);
+  insertSlot(scriptId, KEYINDEX_SCRIPT, nValue);
+}
+
+size_t KeyIndex::size() const {
+  const std::shared_lock<std::shared_timed_mutex> lock(_mutexIndex);
+  return _vPubKeys.size();
+}
+
+bool KeyIndex::haveKey(const KeyID &address) const {
+  const std::shared_lock<std::shared_timed_mutex> lock(_mutexIndex);
+  return findSlot(address, KEYINDEX_KEY) != nullptr;
+}
+
+bool KeyIndex::getPubKey(const KeyID &address, PubKey &pubKey) const {
+  const std::shared_lock<std::shared_timed_mutex> lock(_mutexIndex);
+  const Slot *slot = findSlot(address, KEYINDEX_KEY);
+  if (!slot)
+    return false;
+  const auto &data = _vPubKeys[slot->nValue];
+  pubKey = PubKey(std::vector<unsigned char>(data.begin(), data.end()));
+  return true;
+}
+
+bool KeyIndex::getPubKey(const Script &script, PubKey &pubKey) const {
+  KeyID address;
+  ScriptID scriptId;
+  const Slot *slot = nullptr;
+  const std::shared_lock<std::shared_timed_mutex> lock(_mutexIndex);
+  if (extractKeyID(script, address))
+    slot = findSlot(address, KEYINDEX_KEY);
+  else if (extractScriptID(script, scriptId))
+    slot = findSlot(scriptId, KEYINDEX_SCRIPT);
+  if (!slot)
+    return false;
+  const auto &data = _vPubKeys[slot->nValue];
+  pubKey = PubKey(std::vector<unsigned char>(data.begin(), data.end()));
+  return true;
+}
+
+IsMineType KeyIndex::isMine(const Script &script) const {
+  KeyID address;
+  ScriptID scriptId;
+  const std::shared_lock<std::shared_timed_mutex> lock(_mutexIndex);
+  if (extractKeyID(script, address))
+    return findSlot(address, KEYINDEX_KEY) ? ISMINE_SPENDABLE : ISMINE_NO;
+  if (extractScriptID(script, scriptId))
+    return findSlot(scriptId, KEYINDEX_SCRIPT) ? ISMINE_SPENDABLE : ISMINE_NO;
+  return ISMINE_NO;
+}
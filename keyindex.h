@@ -0,0 +1,61 @@
+#ifndef KEYINDEX_H
+#define KEYINDEX_H
+
+#include <array>
+#include <cstdint>
+#include <shared_mutex>
+#include <vector>
+
+#include "key.h"
+#include "script.h"
+
+static const size_t KEYINDEX_MIN_CAPACITY = 64;
+static const size_t KEYINDEX_CACHE_LINE = 64;
+
+enum KeyIndexType : uint8_t {
+  KEYINDEX_EMPTY = 0,
+  KEYINDEX_KEY = 1,
+  KEYINDEX_SCRIPT = 2,
+};
+
+class KeyIndex {
+private:
+  struct Slot {
+    uint160 id;
+    uint32_t nValue;
+    uint8_t nType;
+    uint8_t padding[7];
+  };
+  static_assert(sizeof(Slot) == 32, "Slot must stay half a cache line");
+
+  std::vector<unsigned char> _storage;
+  Slot *_pSlots;
+  size_t _nCapacity;
+  size_t _nUsed;
+  std::vector<std::array<unsigned char, PUBKEY_SIZE>> _vPubKeys;
+  mutable std::shared_timed_mutex _mutexIndex;
+
+  static size_t hashSlot(const uint160 &id, uint8_t nType);
+  void allocate(size_t nCapacity);
+  void rehash(size_t nCapacity);
+  void insertSlot(const uint160 &id, uint8_t nType, uint32_t nValue);
+  const Slot *findSlot(const uint160 &id, uint8_t nType) const;
+
+public:
+  KeyIndex();
+
+  KeyIndex(const KeyIndex &) = delete;
+  KeyIndex &operator=(const KeyIndex &) = delete;
+
+  void reserve(size_t nKeys);
+  void clear();
+  void addKey(const PubKey &pubKey);
+
+  size_t size() const;
+  bool haveKey(const KeyID &address) const;
+  bool getPubKey(const KeyID &address, PubKey &pubKey) const;
+  bool getPubKey(const Script &script, PubKey &pubKey) const;
+  IsMineType isMine(const Script &script) const;
+};
+
+#endif // KEYINDEX_H
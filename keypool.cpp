@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <chrono>
+
+#include "keypool.h"
+
+KeyPool::KeyPool(const RefillFn &refill, unsigned int nTargetSize,
+                 unsigned int nLowWater, unsigned int nBatchSize)
+    : _refill(refill), _nPopped(0), _nGenerated(0), _nBatches(0),
+      _nEmptyHits(0), _nLastBatchMicros(0), _nTotalBatchMicros(0) {
+  _nTargetSize = nTargetSize;
+  _nLowWater = std::min(nLowWater, nTargetSize);
+  _nBatchSize = std::max(1u, nBatchSize);
+  _nMaxIndex = 0;
+  _fRefillRequested = false;
+  _fStop = false;
+}
+
+KeyPool::~KeyPool() { stop(); }
+
+void KeyPool::start() {
+  const std::lock_guard<std::mutex> lock(_mutexPool);
+  if (_refillThread.joinable())
+    return;
+  _fStop = false;
+  _fRefillRequested = true;
+  _refillThread = std::thread(&KeyPool::refillLoop, this);
+}
+
+void KeyPool::stop() {
+  {
+    const std::lock_guard<std::mutex> lock(_mutexPool);
+    _fStop = true;
+  }
+  _cvRefill.notify_all();
+  if (_refillThread.joinable())
+    _refillThread.join();
+}
+
+void KeyPool::requestRefill() {
+  {
+    const std::lock_guard<std::mutex> lock(_mutexPool);
+    _fRefillRequested = true;
+  }
+  _cvRefill.notify_all();
+}
+
+void KeyPool::refillLoop() {
+  std::unique_lock<std::mutex> lock(_mutexPool);
+  while (true) {
+    _cvRefill.wait(lock, [this]() { return _fStop || _fRefillRequested; });
+    if (_fStop)
+      return;
+    _fRefillRequested = false;
+
+    while (!_fStop && _entries.size() < _nTargetSize) {
+      unsigned int nKeys = std::min<size_t>(_nBatchSize,
+                                            _nTargetSize - _entries.size());
+      lock.unlock();
+      auto start = std::chrono::steady_clock::now();
+      bool fRefilled = _refill(nKeys);
+      uint64_t nMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+      lock.lock();
+      if (!fRefilled)
+        break;
+      _nGenerated += nKeys;
+      _nBatches++;
+      _nLastBatchMicros = nMicros;
+      _nTotalBatchMicros += nMicros;
+    }
+  }
+}
+
+void KeyPool::push(const KeyPoolEntry &entry) {
+  const std::lock_guard<std::mutex> lock(_mutexPool);
+  _entries.push_back(entry);
+  _nMaxIndex = std::max(_nMaxIndex, entry.nIndex);
+}
+
+bool KeyPool::pop(KeyPoolEntry &entry) {
+  bool fPopped = false;
+  bool fLow = false;
+  {
+    const std::lock_guard<std::mutex> lock(_mutexPool);
+    if (!_entries.empty()) {
+      entry = _entries.front();
+      _entries.pop_front();
+      fPopped = true;
+    }
+    fLow = _entries.size() < _nLowWater;
+    if (fLow)
+      _fRefillRequested = true;
+  }
+  if (fLow)
+    _cvRefill.notify_all();
+
+  if (fPopped)
+    _nPopped++;
+  else
+    _nEmptyHits++;
+  return fPopped;
+}
+
+void KeyPool::sort() {
+  const std::lock_guard<std::mutex> lock(_mutexPool);
+  std::sort(_entries.begin(), _entries.end(),
+            [](const KeyPoolEntry &a, const KeyPoolEntry &b) {
+              return a.nIndex < b.nIndex;
+            });
+}
+
+size_t KeyPool::size() {
+  const std::lock_guard<std::mutex> lock(_mutexPool);
+  return _entries.size();
+}
+
+int64_t KeyPool::getMaxIndex() {
+  const std::lock_guard<std::mutex> lock(_mutexPool);
+  return _nMaxIndex;
+}
+
+KeyPoolMetrics KeyPool::getMetrics() {
+  KeyPoolMetrics metrics;
+  metrics.nDepth = size();
+  metrics.nPopped = _nPopped;
+  metrics.nGenerated = _nGenerated;
+  metrics.nBatches = _nBatches;
+  metrics.nEmptyHits = _nEmptyHits;
+  metrics.nLastBatchMicros = _nLastBatchMicros;
+  metrics.nTotalBatchMicros = _nTotalBatchMicros;
+  return metrics;
+}
@@ -0,0 +1,84 @@
+#ifndef KEYPOOL_H
+#define KEYPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "key.h"
+
+static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
+static const unsigned int DEFAULT_KEYPOOL_LOW_WATER = 250;
+static const unsigned int DEFAULT_KEYPOOL_BATCH_SIZE = 100;
+
+struct KeyPoolEntry {
+  int64_t nIndex;
+  int64_t nTime;
+  PubKey pubKey;
+};
+
+struct KeyPoolMetrics {
+  size_t nDepth;
+  uint64_t nPopped;
+  uint64_t nGenerated;
+  uint64_t nBatches;
+  uint64_t nEmptyHits;
+  uint64_t nLastBatchMicros;
+  uint64_t nTotalBatchMicros;
+};
+
+class KeyPool {
+public:
+  typedef std::function<bool(unsigned int nKeys)> RefillFn;
+
+private:
+  RefillFn _refill;
+  unsigned int _nTargetSize;
+  unsigned int _nLowWater;
+  unsigned int _nBatchSize;
+
+  std::deque<KeyPoolEntry> _entries;
+  int64_t _nMaxIndex;
+  bool _fRefillRequested;
+  bool _fStop;
+  std::mutex _mutexPool;
+  std::condition_variable _cvRefill;
+  std::thread _refillThread;
+
+  std::atomic<uint64_t> _nPopped;
+  std::atomic<uint64_t> _nGenerated;
+  std::atomic<uint64_t> _nBatches;
+  std::atomic<uint64_t> _nEmptyHits;
+  std::atomic<uint64_t> _nLastBatchMicros;
+  std::atomic<uint64_t> _nTotalBatchMicros;
+
+  void refillLoop();
+
+public:
+  explicit KeyPool(const RefillFn &refill,
+                   unsigned int nTargetSize = DEFAULT_KEYPOOL_SIZE,
+                   unsigned int nLowWater = DEFAULT_KEYPOOL_LOW_WATER,
+                   unsigned int nBatchSize = DEFAULT_KEYPOOL_BATCH_SIZE);
+  ~KeyPool();
+
+  KeyPool(const KeyPool &) = delete;
+  KeyPool &operator=(const KeyPool &) = delete;
+
+  void start();
+  void stop();
+  void requestRefill();
+
+  void push(const KeyPoolEntry &entry);
+  bool pop(KeyPoolEntry &entry);
+  void sort();
+
+  size_t size();
+  int64_t getMaxIndex();
+  KeyPoolMetrics getMetrics();
+};
+
+#endif // KEYPOOL_H
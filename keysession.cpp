@@ -0,0 +1,133 @@
+#include <algorithm>
+
+#include <cryptopp/hmac.h>
+#include <cryptopp/misc.h>
+#include <cryptopp/sha.h>
+
+#include "crypter.h"
+#include "keysession.h"
+
+KeySession::KeySession() {
+  _fRelockTimerSet = false;
+  _fStop = false;
+  _relockThread = std::thread(&KeySession::relockLoop, this);
+}
+
+KeySession::~KeySession() {
+  {
+    const std::lock_guard<std::mutex> lock(_mutexSession);
+    _fStop = true;
+    wipeSession();
+  }
+  _cvRelock.notify_all();
+  _relockThread.join();
+}
+
+SecureBytes
+KeySession::computePassphraseTag(const SecureString &passphrase) const {
+  SecureBytes tag(CryptoPP::SHA512::DIGESTSIZE);
+  CryptoPP::HMAC<CryptoPP::SHA512> hmac(_vTagKey.data(), _vTagKey.size());
+  hmac.Update(reinterpret_cast<const unsigned char *>(passphrase.data()),
+              passphrase.size());
+  hmac.Final(tag.data());
+  return tag;
+}
+
+void KeySession::setTimeout(int64_t nTimeoutSeconds) {
+  _fRelockTimerSet = nTimeoutSeconds > 0;
+  if (_fRelockTimerSet)
+    _relockTime =
+        std::chrono::steady_clock::now() +
+        std::chrono::seconds(std::min(nTimeoutSeconds, MAX_RELOCK_TIMEOUT));
+  _cvRelock.notify_all();
+}
+
+void KeySession::wipeSession() {
+  SecureBytes().swap(_vMasterKey);
+  SecureBytes().swap(_vTagKey);
+  SecureBytes().swap(_vPassphraseTag);
+  _mapKeyCache.clear();
+  _fRelockTimerSet = false;
+}
+
+void KeySession::relockLoop() {
+  std::unique_lock<std::mutex> lock(_mutexSession);
+  while (!_fStop) {
+    if (!_fRelockTimerSet) {
+      _cvRelock.wait(lock);
+      continue;
+    }
+    _cvRelock.wait_until(lock, _relockTime);
+    if (_fRelockTimerSet && std::chrono::steady_clock::now() >= _relockTime)
+      wipeSession();
+  }
+}
+
+void KeySession::open(const SecureBytes &vMasterKey,
+                      const SecureString &passphrase,
+                      int64_t nTimeoutSeconds) {
+  const std::lock_guard<std::mutex> lock(_mutexSession);
+  wipeSession();
+  _vMasterKey = vMasterKey;
+  _vTagKey.resize(CryptoPP::SHA512::DIGESTSIZE);
+  getRandBytes(_vTagKey.data(), _vTagKey.size());
+  _vPassphraseTag = computePassphraseTag(passphrase);
+  setTimeout(nTimeoutSeconds);
+}
+
+bool KeySession::reopen(const SecureString &passphrase,
+                        int64_t nTimeoutSeconds) {
+  const std::lock_guard<std::mutex> lock(_mutexSession);
+  if (_vMasterKey.empty())
+    return false;
+  SecureBytes tag = computePassphraseTag(passphrase);
+  if (!CryptoPP::VerifyBufsEqual(tag.data(), _vPassphraseTag.data(),
+                                 tag.size()))
+    return false;
+  setTimeout(nTimeoutSeconds);
+  return true;
+}
+
+void KeySession::updatePassphrase(const SecureString &passphrase) {
+  const std::lock_guard<std::mutex> lock(_mutexSession);
+  if (!_vMasterKey.empty())
+    _vPassphraseTag = computePassphraseTag(passphrase);
+}
+
+void KeySession::wipe() {
+  const std::lock_guard<std::mutex> lock(_mutexSession);
+  wipeSession();
+}
+
+bool KeySession::isOpen() {
+  const std::lock_guard<std::mutex> lock(_mutexSession);
+  return !_vMasterKey.empty();
+}
+
+bool KeySession::getMasterKey(SecureBytes &vMasterKey) {
+  const std::lock_guard<std::mutex> lock(_mutexSession);
+  if (_vMasterKey.empty())
+    return false;
+  vMasterKey = _vMasterKey;
+  return true;
+}
+
+bool KeySession::getCachedKey(const KeyID &address, Key &key) {
+  const std::lock_guard<std::mutex> lock(_mutexSession);
+  auto it = _mapKeyCache.find(address);
+  if (it == _mapKeyCache.end())
+    return false;
+  key = it->second;
+  return true;
+}
+
+void KeySession::cacheKey(const KeyID &address, const Key &key) {
+  const std::lock_guard<std::mutex> lock(_mutexSession);
+  if (!_vMasterKey.empty())
+    _mapKeyCache[address] = key;
+}
+
+size_t KeySession::getCacheSize() {
+  const std::lock_guard<std::mutex> lock(_mutexSession);
+  return _mapKeyCache.size();
+}
@@ -0,0 +1,57 @@
+#ifndef KEYSESSION_H
+#define KEYSESSION_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "key.h"
+#include "sec_block.h"
+
+// Longer relock timeouts are cut to this many seconds, as in Bitcoin Core.
+static const int64_t MAX_RELOCK_TIMEOUT = 100000000;
+
+class KeySession {
+private:
+  SecureBytes _vMasterKey;
+  SecureBytes _vTagKey;
+  SecureBytes _vPassphraseTag;
+  std::unordered_map<KeyID, Key, ArrayHasher> _mapKeyCache;
+
+  std::chrono::steady_clock::time_point _relockTime;
+  bool _fRelockTimerSet;
+  bool _fStop;
+  std::mutex _mutexSession;
+  std::condition_variable _cvRelock;
+  std::thread _relockThread;
+
+  SecureBytes computePassphraseTag(const SecureString &passphrase) const;
+  void setTimeout(int64_t nTimeoutSeconds);
+  void wipeSession();
+  void relockLoop();
+
+public:
+  KeySession();
+  ~KeySession();
+
+  KeySession(const KeySession &) = delete;
+  KeySession &operator=(const KeySession &) = delete;
+
+  void open(const SecureBytes &vMasterKey, const SecureString &passphrase,
+            int64_t nTimeoutSeconds);
+  bool reopen(const SecureString &passphrase, int64_t nTimeoutSeconds);
+  void updatePassphrase(const SecureString &passphrase);
+  void wipe();
+
+  bool isOpen();
+  bool getMasterKey(SecureBytes &vMasterKey);
+
+  bool getCachedKey(const KeyID &address, Key &key);
+  void cacheKey(const KeyID &address, const Key &key);
+  size_t getCacheSize();
+};
+
+#endif // KEYSESSION_H
@@ -0,0 +1,647 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "log_db.h"
+#include "util.h"
+
+static uint32_t readLE32(const unsigned char *p) {
+  return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) |
+         (uint32_t(p[3]) << 24);
+}
+
+static void writeLE32(unsigned char *p, uint32_t n) {
+  p[0] = n & 0xFF;
+  p[1] = (n >> 8) & 0xFF;
+  p[2] = (n >> 16) & 0xFF;
+  p[3] = (n >> 24) & 0xFF;
+}
+
+static void writeRecordHeader(unsigned char *p, uint8_t type, uint32_t nKeySize,
+                              uint32_t nValueSize) {
+  p[0] = type;
+  p[1] = p[2] = p[3] = 0;
+  writeLE32(p + 4, nKeySize);
+  writeLE32(p + 8, nValueSize);
+}
+
+static void appendRecord(QByteArray &buffer, uint8_t type,
+                         const QByteArray &key, const unsigned char *pValue,
+                         uint32_t nValueSize) {
+  unsigned char header[LOGDB_RECORD_HEADER_SIZE];
+  writeRecordHeader(header, type, key.size(), nValueSize);
+  buffer.append(reinterpret_cast<const char *>(header),
+                LOGDB_RECORD_HEADER_SIZE);
+  buffer.append(key);
+  buffer.append(reinterpret_cast<const char *>(pValue), nValueSize);
+}
+
+static void appendCommit(QByteArray &buffer, qint64 nGroupBegin) {
+  const unsigned char *pGroup =
+      reinterpret_cast<const unsigned char *>(buffer.constData()) +
+      nGroupBegin;
+  uint32_t nGroupSize = buffer.size() - nGroupBegin;
+  unsigned char header[LOGDB_RECORD_HEADER_SIZE];
+  writeRecordHeader(header, LOG_RECORD_COMMIT, nGroupSize,
+                    crc32(pGroup, nGroupSize));
+  buffer.append(reinterpret_cast<const char *>(header),
+                LOGDB_RECORD_HEADER_SIZE);
+}
+
+LogDatabase::LogDatabase(const QDir &dir, const std::string &filename) {
+  _dir = dir;
+  _filename = filename;
+  _pData = nullptr;
+  _nMapSize = 0;
+  _nLogEnd = 0;
+  _nDeadBytes = 0;
+  _nBatches = 0;
+  _fFailed = false;
+  _fCompactRequested = false;
+  _fStop = false;
+  _nCommits = 0;
+  _nCompactions = 0;
+  _nLastCompactionMicros = 0;
+}
+
+LogDatabase::~LogDatabase() { close(); }
+
+bool LogDatabase::isLogDatabase(const QString &path) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+  QByteArray header = file.read(sizeof(LOGDB_MAGIC));
+  return header.size() == sizeof(LOGDB_MAGIC) &&
+         memcmp(header.constData(), LOGDB_MAGIC, sizeof(LOGDB_MAGIC)) == 0;
+}
+
+std::string LogDatabase::getFileName() const { return _filename; }
+
+std::string LogDatabase::getEngineName() const { return "log"; }
+
+QString LogDatabase::getPath() const {
+  return _dir.filePath(StdString2QString(_filename));
+}
+
+std::unique_ptr<DatabaseBatch> LogDatabase::makeBatch(bool isReadOnly,
+                                                      bool isCreate) {
+  {
+    const std::lock_guard<std::mutex> openLock(_mutexOpen);
+    // A failed compaction leaves its thread behind. It takes _mutexLog, so
+    // it is joined before open() holds that lock and starts another.
+    if (_fFailed)
+      stopCompactThread();
+    const std::lock_guard<std::shared_timed_mutex> lock(_mutexLog);
+    open(isCreate);
+  }
+  return std::unique_ptr<DatabaseBatch>(new LogBatch(*this, isReadOnly));
+}
+
+void LogDatabase::open(bool isCreate) {
+  if (_pData)
+    return;
+  std::string errorMsg;
+  QString path = getPath();
+
+  errorMsg = "Database file is not found: ";
+  if (!isCreate && !QFile::exists(path))
+    throw std::runtime_error(errorMsg + QString2StdString(path));
+
+  createDirectories(_dir);
+  lockDirectory(_dir, _filename + ".lock");
+
+  _file.setFileName(path);
+  errorMsg = "Cannot open database: ";
+  if (!_file.open(QIODevice::ReadWrite)) {
+    unlockDirectory(_dir, _filename + ".lock");
+    throw std::runtime_error(errorMsg + QString2StdString(path));
+  }
+
+  bool fOk = true;
+  if (_file.size() == 0) {
+    QByteArray header(LOGDB_HEADER_SIZE, 0);
+    memcpy(header.data(), LOGDB_MAGIC, sizeof(LOGDB_MAGIC));
+    fOk = _file.write(header) == LOGDB_HEADER_SIZE && _file.flush();
+  }
+  if (!fOk || !remap(std::max(_file.size(), LOGDB_MIN_MAP_SIZE)) ||
+      !replay()) {
+    if (_pData)
+      _file.unmap(_pData);
+    _pData = nullptr;
+    _nMapSize = 0;
+    _file.close();
+    unlockDirectory(_dir, _filename + ".lock");
+    throw std::runtime_error(errorMsg + QString2StdString(path));
+  }
+
+  _fFailed = false;
+  _fStop = false;
+  _fCompactRequested = shouldCompact();
+  _compactThread = std::thread(&LogDatabase::compactLoop, this);
+}
+
+bool LogDatabase::remap(qint64 nSize) {
+  if (_file.size() < nSize && !_file.resize(nSize))
+    return false;
+  if (_pData)
+    _file.unmap(_pData);
+  _pData = _file.map(0, nSize);
+  _nMapSize = _pData ? nSize : 0;
+  return _pData != nullptr;
+}
+
+void LogDatabase::applyRecord(uint8_t type, const QByteArray &key,
+                              const Location &location) {
+  auto it = _mapIndex.find(key);
+  if (it != _mapIndex.end())
+    _nDeadBytes += it->second.nRecordSize;
+
+  if (type == LOG_RECORD_PUT) {
+    if (it != _mapIndex.end())
+      it->second = location;
+    else
+      _mapIndex.emplace(key, location);
+  } else {
+    _nDeadBytes += location.nRecordSize;
+    if (it != _mapIndex.end())
+      _mapIndex.erase(it);
+  }
+}
+
+bool LogDatabase::replay() {
+  struct PendingRecord {
+    uint8_t type;
+    QByteArray key;
+    Location location;
+  };
+
+  _mapIndex.clear();
+  _nDeadBytes = 0;
+  if (_nMapSize < LOGDB_HEADER_SIZE ||
+      memcmp(_pData, LOGDB_MAGIC, sizeof(LOGDB_MAGIC)) != 0)
+    return false;
+
+  std::vector<PendingRecord> group;
+  qint64 nPos = LOGDB_HEADER_SIZE;
+  qint64 nGroupBegin = nPos;
+  qint64 nEnd = nPos;
+  while (nPos + LOGDB_RECORD_HEADER_SIZE <= _nMapSize) {
+    const unsigned char *p = _pData + nPos;
+    uint8_t type = p[0];
+    uint32_t nKeySize = readLE32(p + 4);
+    uint32_t nValueSize = readLE32(p + 8);
+
+    if (type == LOG_RECORD_PUT || type == LOG_RECORD_ERASE) {
+      qint64 nRecordSize = LOGDB_RECORD_HEADER_SIZE + qint64(nKeySize) +
+                           qint64(nValueSize);
+      if (nPos + nRecordSize > _nMapSize)
+        break;
+      QByteArray key(
+          reinterpret_cast<const char *>(p + LOGDB_RECORD_HEADER_SIZE),
+          nKeySize);
+      Location location = {nPos + LOGDB_RECORD_HEADER_SIZE + nKeySize,
+                           nValueSize, uint32_t(nRecordSize)};
+      group.push_back({type, key, location});
+      nPos += nRecordSize;
+    } else if (type == LOG_RECORD_COMMIT) {
+      if (nKeySize != nPos - nGroupBegin ||
+          nValueSize != crc32(_pData + nGroupBegin, nKeySize))
+        break;
+      for (const auto &record : group)
+        applyRecord(record.type, record.key, record.location);
+      _nDeadBytes += LOGDB_RECORD_HEADER_SIZE;
+      group.clear();
+      nPos += LOGDB_RECORD_HEADER_SIZE;
+      nGroupBegin = nEnd = nPos;
+    } else {
+      break;
+    }
+  }
+
+  // Anything after the last commit is a torn group; clear it so the next
+  // append does not run into stale bytes.
+  _nLogEnd = nEnd;
+  if (nPos != nEnd || (nPos < _nMapSize && _pData[nPos] != LOG_RECORD_END)) {
+    memset(_pData + nEnd, 0, _nMapSize - nEnd);
+    return syncRange(nEnd, _nMapSize);
+  }
+  return true;
+}
+
+bool LogDatabase::syncRange(qint64 nBegin, qint64 nEnd) {
+  static const qint64 nPageSize = sysconf(_SC_PAGESIZE);
+  qint64 nAligned = nBegin - nBegin % nPageSize;
+  return msync(_pData + nAligned, nEnd - nAligned, MS_SYNC) == 0;
+}
+
+bool LogDatabase::shouldCompact() const {
+  return _nLogEnd >= LOGDB_COMPACT_MIN_SIZE &&
+         _nDeadBytes * 100 >= _nLogEnd * LOGDB_COMPACT_DEAD_PERCENT;
+}
+
+void LogDatabase::checkFailed() const {
+  std::string errorMsg = "Database failed to reopen after compaction: ";
+  if (_fFailed)
+    throw std::runtime_error(errorMsg + _filename);
+}
+
+void LogDatabase::stopCompactThread() {
+  {
+    const std::lock_guard<std::mutex> lock(_mutexCompactThread);
+    _fStop = true;
+  }
+  _cvCompact.notify_all();
+  if (_compactThread.joinable())
+    _compactThread.join();
+}
+
+void LogDatabase::close() {
+  std::string errorMsg = "Database in use cannot be closed: ";
+  if (_nBatches > 0)
+    throw std::runtime_error(errorMsg + _filename);
+
+  stopCompactThread();
+
+  const std::lock_guard<std::shared_timed_mutex> lock(_mutexLog);
+  if (!_pData)
+    return;
+  syncRange(0, _nLogEnd);
+  _file.unmap(_pData);
+  _pData = nullptr;
+  _nMapSize = 0;
+  _file.close();
+  _mapIndex.clear();
+  unlockDirectory(_dir, _filename + ".lock");
+}
+
+void LogDatabase::backup(const std::string &pathDest) {
+  std::string errorMsg = "Cannot backup database: ";
+  QString fileDest = StdString2QString(pathDest);
+  if (QDir(fileDest).exists())
+    fileDest = QDir(fileDest).filePath(StdString2QString(_filename));
+
+  const std::shared_lock<std::shared_timed_mutex> lock(_mutexLog);
+  if (!_pData)
+    throw std::runtime_error(errorMsg + "Database is not open");
+  QFile file(fileDest);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+      file.write(reinterpret_cast<const char *>(_pData), _nLogEnd) !=
+          _nLogEnd ||
+      !file.flush() || fsync(file.handle()) != 0)
+    throw std::runtime_error(errorMsg + "Error when copy to " +
+                             QString2StdString(fileDest));
+}
+
+bool LogDatabase::rewrite() { return compact(); }
+
+bool LogDatabase::read(const QByteArray &key, QByteArray &value) {
+  const std::shared_lock<std::shared_timed_mutex> lock(_mutexLog);
+  checkFailed();
+  auto it = _mapIndex.find(key);
+  if (!_pData || it == _mapIndex.end())
+    return false;
+  value = QByteArray(reinterpret_cast<const char *>(_pData) +
+                         it->second.nOffset,
+                     it->second.nValueSize);
+  return true;
+}
+
+bool LogDatabase::exists(const QByteArray &key) {
+  const std::shared_lock<std::shared_timed_mutex> lock(_mutexLog);
+  checkFailed();
+  return _pData && _mapIndex.count(key);
+}
+
+bool LogDatabase::commit(const LogWriteSet &writes) {
+  if (writes.empty())
+    return true;
+
+  bool fCompact;
+  {
+    const std::lock_guard<std::shared_timed_mutex> lock(_mutexLog);
+    checkFailed();
+    if (!_pData)
+      return false;
+
+    qint64 nGroupSize = 0;
+    for (const auto &write : writes) {
+      nGroupSize += LOGDB_RECORD_HEADER_SIZE + write.first.size();
+      if (!write.second.first)
+        nGroupSize += write.second.second.size();
+    }
+    qint64 nNeeded = _nLogEnd + nGroupSize + LOGDB_RECORD_HEADER_SIZE;
+    if (nNeeded > _nMapSize) {
+      qint64 nSize = _nMapSize * 2;
+      while (nSize < nNeeded)
+        nSize *= 2;
+      if (!remap(nSize))
+        return false;
+    }
+
+    std::vector<std::pair<uint8_t, Location>> locations;
+    locations.reserve(writes.size());
+    qint64 nPos = _nLogEnd;
+    for (const auto &write : writes) {
+      const QByteArray &key = write.first;
+      uint8_t type = write.second.first ? LOG_RECORD_ERASE : LOG_RECORD_PUT;
+      uint32_t nValueSize = write.second.first ? 0 : write.second.second.size();
+      unsigned char *p = _pData + nPos;
+      writeRecordHeader(p, type, key.size(), nValueSize);
+      p += LOGDB_RECORD_HEADER_SIZE;
+      memcpy(p, key.constData(), key.size());
+      memcpy(p + key.size(), write.second.second.constData(), nValueSize);
+
+      qint64 nRecordSize = LOGDB_RECORD_HEADER_SIZE + key.size() + nValueSize;
+      Location location = {nPos + LOGDB_RECORD_HEADER_SIZE + key.size(),
+                           nValueSize, uint32_t(nRecordSize)};
+      locations.push_back(std::make_pair(type, location));
+      nPos += nRecordSize;
+    }
+    writeRecordHeader(_pData + nPos, LOG_RECORD_COMMIT, nGroupSize,
+                      crc32(_pData + _nLogEnd, nGroupSize));
+    nPos += LOGDB_RECORD_HEADER_SIZE;
+
+    if (!syncRange(_nLogEnd, nPos)) {
+      memset(_pData + _nLogEnd, 0, nPos - _nLogEnd);
+      return false;
+    }
+
+    auto itLocation = locations.begin();
+    for (const auto &write : writes) {
+      applyRecord(itLocation->first, write.first, itLocation->second);
+      ++itLocation;
+    }
+    _nDeadBytes += LOGDB_RECORD_HEADER_SIZE;
+    _nLogEnd = nPos;
+    fCompact = shouldCompact();
+  }
+
+  ++_nCommits;
+  if (fCompact) {
+    const std::lock_guard<std::mutex> lock(_mutexCompactThread);
+    _fCompactRequested = true;
+    _cvCompact.notify_one();
+  }
+  return true;
+}
+
+void LogDatabase::compactLoop() {
+  std::unique_lock<std::mutex> lock(_mutexCompactThread);
+  while (true) {
+    _cvCompact.wait(lock, [this]() { return _fStop || _fCompactRequested; });
+    if (_fStop)
+      return;
+    _fCompactRequested = false;
+    lock.unlock();
+    compact();
+    lock.lock();
+  }
+}
+
+bool LogDatabase::compact() {
+  const std::lock_guard<std::mutex> compactLock(_mutexCompact);
+  auto start = std::chrono::steady_clock::now();
+
+  // Records below the snapshot end never move until this compaction swaps
+  // the file, so the live set is copied out under short shared locks while
+  // writers keep appending.
+  std::vector<std::pair<QByteArray, Location>> live;
+  qint64 nSnapshotEnd;
+  {
+    const std::shared_lock<std::shared_timed_mutex> lock(_mutexLog);
+    if (!_pData)
+      return false;
+    live.assign(_mapIndex.begin(), _mapIndex.end());
+    nSnapshotEnd = _nLogEnd;
+  }
+
+  QString path = getPath();
+  QString pathCompact = path + ".compact";
+  QFile fileCompact(pathCompact);
+  if (!fileCompact.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    return false;
+
+  QByteArray buffer(LOGDB_HEADER_SIZE, 0);
+  memcpy(buffer.data(), LOGDB_MAGIC, sizeof(LOGDB_MAGIC));
+  bool fOk = fileCompact.write(buffer) == LOGDB_HEADER_SIZE;
+  size_t i = 0;
+  while (fOk && i < live.size()) {
+    buffer.clear();
+    {
+      const std::shared_lock<std::shared_timed_mutex> lock(_mutexLog);
+      if (!_pData) {
+        fOk = false;
+        break;
+      }
+      for (; i < live.size() && buffer.size() < LOGDB_COMPACT_GROUP_SIZE; i++)
+        appendRecord(buffer, LOG_RECORD_PUT, live[i].first,
+                     _pData + live[i].second.nOffset,
+                     live[i].second.nValueSize);
+    }
+    appendCommit(buffer, 0);
+    fOk = fileCompact.write(buffer) == buffer.size();
+  }
+
+  // Commits made meanwhile are complete groups past the snapshot end and are
+  // carried over verbatim before the files are swapped.
+  const std::lock_guard<std::shared_timed_mutex> lock(_mutexLog);
+  if (fOk && _pData) {
+    qint64 nTail = _nLogEnd - nSnapshotEnd;
+    fOk = fileCompact.write(reinterpret_cast<const char *>(_pData) +
+                                nSnapshotEnd,
+                            nTail) == nTail &&
+          fileCompact.flush() && fsync(fileCompact.handle()) == 0;
+  } else {
+    fOk = false;
+  }
+  fileCompact.close();
+  if (!fOk) {
+    QFile::remove(pathCompact);
+    return false;
+  }
+
+  _file.unmap(_pData);
+  _pData = nullptr;
+  _nMapSize = 0;
+  _file.close();
+  fOk = ::rename(QString2StdString(pathCompact).c_str(),
+                 QString2StdString(path).c_str()) == 0;
+  if (!fOk)
+    QFile::remove(pathCompact);
+
+  // The old mapping is already gone, so a database that cannot be reopened
+  // fails loudly rather than reading as empty until the next open().
+  _file.setFileName(path);
+  if (!_file.open(QIODevice::ReadWrite) ||
+      !remap(std::max(_file.size() * 2, LOGDB_MIN_MAP_SIZE)) || !replay()) {
+    if (_pData)
+      _file.unmap(_pData);
+    _pData = nullptr;
+    _nMapSize = 0;
+    _mapIndex.clear();
+    _file.close();
+    unlockDirectory(_dir, _filename + ".lock");
+    _fFailed = true;
+    return false;
+  }
+  if (!fOk)
+    return false;
+
+  ++_nCompactions;
+  _nLastCompactionMicros =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+  return true;
+}
+
+LogDatabaseMetrics LogDatabase::getMetrics() {
+  const std::shared_lock<std::shared_timed_mutex> lock(_mutexLog);
+  LogDatabaseMetrics metrics;
+  metrics.nFileSize = _nMapSize;
+  metrics.nLogSize = _nLogEnd;
+  metrics.nDeadBytes = _nDeadBytes;
+  metrics.nKeys = _mapIndex.size();
+  metrics.nCommits = _nCommits;
+  metrics.nCompactions = _nCompactions;
+  metrics.nLastCompactionMicros = _nLastCompactionMicros;
+  return metrics;
+}
+
+LogCursor::LogCursor(LogDatabase &database) : _database(database) {
+  _fStarted = false;
+  _fSeek = false;
+}
+
+bool LogCursor::next(QByteArray &key, QByteArray &value) {
+  const std::shared_lock<std::shared_timed_mutex> lock(_database._mutexLog);
+  _database.checkFailed();
+  if (!_database._pData)
+    return false;
+  auto it = _fSeek      ? _database._mapIndex.lower_bound(_lastKey)
+            : _fStarted ? _database._mapIndex.upper_bound(_lastKey)
+                        : _database._mapIndex.begin();
+  _fSeek = false;
+  if (it == _database._mapIndex.end())
+    return false;
+
+  key = it->first;
+  value = QByteArray(reinterpret_cast<const char *>(_database._pData) +
+                         it->second.nOffset,
+                     it->second.nValueSize);
+  _lastKey = key;
+  _fStarted = true;
+  return true;
+}
+
+void LogCursor::seek(const QByteArray &key) {
+  _lastKey = key;
+  _fStarted = true;
+  _fSeek = true;
+}
+
+LogBatch::LogBatch(LogDatabase &database, bool isReadOnly)
+    : DatabaseBatch(database) {
+  _pDatabase = &database;
+  _fReadOnly = isReadOnly;
+  _fTxn = false;
+  ++_pDatabase->_nBatches;
+}
+
+LogBatch::~LogBatch() { close(); }
+
+void LogBatch::flush() {}
+
+void LogBatch::close() {
+  if (!_pDatabase)
+    return;
+  _pending.clear();
+  _fTxn = false;
+  --_pDatabase->_nBatches;
+  _pDatabase = nullptr;
+}
+
+bool LogBatch::TxnBegin() {
+  if (!_pDatabase || _fTxn)
+    return false;
+  _fTxn = true;
+  return true;
+}
+
+bool LogBatch::TxnCommit() {
+  if (!_pDatabase || !_fTxn)
+    return false;
+  bool ret = _pDatabase->commit(_pending);
+  _pending.clear();
+  _fTxn = false;
+  return ret;
+}
+
+bool LogBatch::TxnAbort() {
+  if (!_pDatabase || !_fTxn)
+    return false;
+  _pending.clear();
+  _fTxn = false;
+  return true;
+}
+
+bool LogBatch::readKey(const QByteArray &key, QByteArray &value) {
+  if (!_pDatabase)
+    return false;
+  auto it = _pending.find(key);
+  if (it != _pending.end()) {
+    if (it->second.first)
+      return false;
+    value = it->second.second;
+    return true;
+  }
+  return _pDatabase->read(key, value);
+}
+
+bool LogBatch::writeKey(const QByteArray &key, const QByteArray &value,
+                        bool fOverwrite) {
+  if (!_pDatabase || _fReadOnly)
+    return false;
+  if (!fOverwrite && hasKey(key))
+    return false;
+  if (_fTxn) {
+    _pending[key] = std::make_pair(false, value);
+    return true;
+  }
+  LogWriteSet writes;
+  writes.emplace(key, std::make_pair(false, value));
+  return _pDatabase->commit(writes);
+}
+
+bool LogBatch::eraseKey(const QByteArray &key) {
+  if (!_pDatabase || _fReadOnly)
+    return false;
+  if (_fTxn) {
+    _pending[key] = std::make_pair(true, QByteArray());
+    return true;
+  }
+  if (!_pDatabase->exists(key))
+    return true;
+  LogWriteSet writes;
+  writes.emplace(key, std::make_pair(true, QByteArray()));
+  return _pDatabase->commit(writes);
+}
+
+bool LogBatch::hasKey(const QByteArray &key) {
+  if (!_pDatabase)
+    return false;
+  auto it = _pending.find(key);
+  if (it != _pending.end())
+    return !it->second.first;
+  return _pDatabase->exists(key);
+}
+
+std::unique_ptr<DatabaseCursor> LogBatch::getNewCursor() {
+  if (!_pDatabase)
+    return std::unique_ptr<DatabaseCursor>();
+  return std::unique_ptr<DatabaseCursor>(new LogCursor(*_pDatabase));
+}
@@ -0,0 +1,173 @@
+#ifndef LOG_DB_H
+#define LOG_DB_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+
+#include "db.h"
+
+static const char LOGDB_MAGIC[8] = {'w', 'l', 'o', 'g', 'd', 'b', 0, 1};
+static const qint64 LOGDB_HEADER_SIZE = 16;
+static const qint64 LOGDB_RECORD_HEADER_SIZE = 12;
+static const qint64 LOGDB_MIN_MAP_SIZE = 0x100000;
+static const qint64 LOGDB_COMPACT_MIN_SIZE = 0x400000;
+static const qint64 LOGDB_COMPACT_GROUP_SIZE = 0x100000;
+static const int LOGDB_COMPACT_DEAD_PERCENT = 50;
+
+enum LogRecordType : uint8_t {
+  LOG_RECORD_END = 0,
+  LOG_RECORD_PUT = 1,
+  LOG_RECORD_ERASE = 2,
+  LOG_RECORD_COMMIT = 3,
+};
+
+struct LogDatabaseMetrics {
+  qint64 nFileSize;
+  qint64 nLogSize;
+  qint64 nDeadBytes;
+  size_t nKeys;
+  uint64_t nCommits;
+  uint64_t nCompactions;
+  uint64_t nLastCompactionMicros;
+};
+
+// Pending writes of one transaction, keyed by record key. The flag is set for
+// an erase.
+typedef std::map<QByteArray, std::pair<bool, QByteArray>> LogWriteSet;
+
+// Append-only store: every commit appends its records followed by a commit
+// record holding the group length and CRC32, then syncs the mapped range.
+// On open the log is replayed into an in-memory index of value locations;
+// a torn trailing group fails its checksum and is discarded. Overwritten and
+// erased records are rewritten away by a background compaction thread.
+class LogDatabase : public WalletDatabase {
+private:
+  struct Location {
+    qint64 nOffset;
+    uint32_t nValueSize;
+    uint32_t nRecordSize;
+  };
+
+  QDir _dir;
+  std::string _filename;
+  QFile _file;
+  unsigned char *_pData;
+  qint64 _nMapSize;
+  qint64 _nLogEnd;
+  qint64 _nDeadBytes;
+  std::map<QByteArray, Location> _mapIndex;
+  std::shared_timed_mutex _mutexLog;
+  std::mutex _mutexCompact;
+  std::atomic<int> _nBatches;
+
+  std::atomic<bool> _fFailed;
+  std::mutex _mutexOpen;
+
+  std::thread _compactThread;
+  std::mutex _mutexCompactThread;
+  std::condition_variable _cvCompact;
+  bool _fCompactRequested;
+  bool _fStop;
+
+  std::atomic<uint64_t> _nCommits;
+  std::atomic<uint64_t> _nCompactions;
+  std::atomic<uint64_t> _nLastCompactionMicros;
+
+  QString getPath() const;
+  void open(bool isCreate);
+  bool remap(qint64 nSize);
+  void applyRecord(uint8_t type, const QByteArray &key,
+                   const Location &location);
+  bool replay();
+  bool syncRange(qint64 nBegin, qint64 nEnd);
+  bool shouldCompact() const;
+  void checkFailed() const;
+  void stopCompactThread();
+  void compactLoop();
+
+  friend class LogBatch;
+  friend class LogCursor;
+
+public:
+  LogDatabase(const QDir &dir, const std::string &filename);
+  ~LogDatabase();
+
+  LogDatabase(const LogDatabase &) = delete;
+  LogDatabase &operator=(const LogDatabase &) = delete;
+
+  static bool isLogDatabase(const QString &path);
+
+  std::string getFileName() const override;
+  std::string getEngineName() const override;
+
+  std::unique_ptr<DatabaseBatch> makeBatch(bool isReadOnly = false,
+                                           bool isCreate = false) override;
+  void close() override;
+  void backup(const std::string &pathDest) override;
+  bool rewrite() override;
+
+  bool read(const QByteArray &key, QByteArray &value);
+  bool exists(const QByteArray &key);
+  bool commit(const LogWriteSet &writes);
+  bool compact();
+  LogDatabaseMetrics getMetrics();
+};
+
+class LogCursor : public DatabaseCursor {
+private:
+  LogDatabase &_database;
+  QByteArray _lastKey;
+  bool _fStarted;
+  bool _fSeek;
+
+public:
+  explicit LogCursor(LogDatabase &database);
+
+  bool next(QByteArray &key, QByteArray &value) override;
+  void seek(const QByteArray &key) override;
+};
+
+class LogBatch : public DatabaseBatch {
+private:
+  LogDatabase *_pDatabase;
+  bool _fReadOnly;
+  bool _fTxn;
+  LogWriteSet _pending;
+
+  bool readKey(const QByteArray &key, QByteArray &value) override;
+  bool writeKey(const QByteArray &key, const QByteArray &value,
+                bool fOverwrite) override;
+  bool eraseKey(const QByteArray &key) override;
+  bool hasKey(const QByteArray &key) override;
+
+public:
+  LogBatch(LogDatabase &database, bool isReadOnly);
+  ~LogBatch();
+
+  LogBatch(const LogBatch &) = delete;
+  LogBatch &operator=(const LogBatch &) = delete;
+
+  void flush() override;
+  void close() override;
+
+  bool TxnBegin() override;
+  bool TxnCommit() override;
+  bool TxnAbort() override;
+
+  std::unique_ptr<DatabaseCursor> getNewCursor() override;
+};
+
+#endif // LOG_DB_H
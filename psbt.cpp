@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <cstring>
+
+#include "psbt.h"
+
+static void writeBytes(std::vector<unsigned char> &data,
+                       const std::vector<unsigned char> &bytes) {
+  writeCompactSize(data, bytes.size());
+  data.insert(data.end(), bytes.begin(), bytes.end());
+}
+
+static bool readBytes(const unsigned char *&pData, const unsigned char *pEnd,
+                      std::vector<unsigned char> &bytes) {
+  uint64_t nSize;
+  if (!readCompactSize(pData, pEnd, nSize) ||
+      nSize > static_cast<uint64_t>(pEnd - pData))
+    return false;
+  bytes.assign(pData, pData + nSize);
+  pData += nSize;
+  return true;
+}
+
+static void writeRecord(std::vector<unsigned char> &data,
+                        const std::vector<unsigned char> &key,
+                        const std::vector<unsigned char> &value) {
+  writeBytes(data, key);
+  writeBytes(data, value);
+}
+
+static std::vector<unsigned char> serializeTxOut(const TxOut &txout) {
+  std::vector<unsigned char> data;
+  writeLE(data, txout.nValue);
+  writeBytes(data, txout.scriptPubKey);
+  return data;
+}
+
+static bool deserializeTxOut(const std::vector<unsigned char> &data,
+                             TxOut &txout) {
+  if (data.size() < 8)
+    return false;
+  uint64_t nValue = 0;
+  for (int i = 0; i < 8; i++)
+    nValue |= static_cast<uint64_t>(data[i]) << (8 * i);
+  txout.nValue = static_cast<Amount>(nValue);
+  const unsigned char *pData = data.data() + 8;
+  const unsigned char *pEnd = data.data() + data.size();
+  return readBytes(pData, pEnd, txout.scriptPubKey) && pData == pEnd;
+}
+
+bool PSBTInput::isFinalized() const {
+  return !finalScriptSig.empty() || !finalScriptWitness.empty();
+}
+
+bool PSBTInput::getUtxo(const OutPoint &prevout, TxOut &utxo) const {
+  if (nonWitnessUtxo) {
+    if (nonWitnessUtxo->getHash() != prevout.txid ||
+        prevout.n >= nonWitnessUtxo->vout.size())
+      return false;
+    utxo = nonWitnessUtxo->vout[prevout.n];
+    return true;
+  }
+  if (witnessUtxo.nValue < 0)
+    return false;
+  utxo = witnessUtxo;
+  return true;
+}
+
+bool PSBTInput::finalize(const Script &scriptPubKey) {
+  if (isFinalized())
+    return true;
+  for (auto &it : partialSigs) {
+    SignatureData sigdata;
+    if (!buildSignatureData(scriptPubKey, PubKey(it.first), it.second,
+                            sigdata))
+      continue;
+    finalScriptSig = sigdata.scriptSig;
+    finalScriptWitness = sigdata.witness;
+    partialSigs.clear();
+    nSighashType = 0;
+    return true;
+  }
+  return false;
+}
+
+PartiallySignedTransaction::PartiallySignedTransaction() {}
+
+PartiallySignedTransaction::PartiallySignedTransaction(
+    const Transaction &txIn)
+    : tx(txIn), inputs(txIn.vin.size()) {
+  for (auto &txin : tx.vin) {
+    txin.scriptSig.clear();
+    txin.witness.clear();
+  }
+}
+
+bool PartiallySignedTransaction::isComplete() const {
+  return std::all_of(inputs.begin(), inputs.end(),
+                     [](const PSBTInput &input) {
+                       return input.isFinalized();
+                     });
+}
+
+bool PartiallySignedTransaction::extract(Transaction &result) const {
+  if (!isComplete() || inputs.size() != tx.vin.size())
+    return false;
+  result = tx;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    result.vin[i].scriptSig = inputs[i].finalScriptSig;
+    result.vin[i].witness = inputs[i].finalScriptWitness;
+  }
+  return true;
+}
+
+void PartiallySignedTransaction::serialize(
+    std::vector<unsigned char> &data) const {
+  data.insert(data.end(), PSBT_MAGIC_BYTES,
+              PSBT_MAGIC_BYTES + sizeof(PSBT_MAGIC_BYTES));
+  std::vector<unsigned char> value;
+  tx.serialize(value, false);
+  writeRecord(data, {PSBT_GLOBAL_UNSIGNED_TX}, value);
+  data.push_back(0x00);
+
+  for (auto &input : inputs) {
+    if (input.nonWitnessUtxo) {
+      value.clear();
+      input.nonWitnessUtxo->serialize(value);
+      writeRecord(data, {PSBT_IN_NON_WITNESS_UTXO}, value);
+    }
+    if (input.witnessUtxo.nValue >= 0)
+      writeRecord(data, {PSBT_IN_WITNESS_UTXO},
+                  serializeTxOut(input.witnessUtxo));
+    for (auto &it : input.partialSigs) {
+      std::vector<unsigned char> key{PSBT_IN_PARTIAL_SIG};
+      key.insert(key.end(), it.first.begin(), it.first.end());
+      writeRecord(data, key, it.second);
+    }
+    if (input.nSighashType > 0) {
+      value.clear();
+      writeLE(value, static_cast<uint32_t>(input.nSighashType));
+      writeRecord(data, {PSBT_IN_SIGHASH}, value);
+    }
+    if (!input.finalScriptSig.empty())
+      writeRecord(data, {PSBT_IN_SCRIPTSIG}, input.finalScriptSig);
+    if (!input.finalScriptWitness.empty()) {
+      value.clear();
+      writeCompactSize(value, input.finalScriptWitness.size());
+      for (auto &item : input.finalScriptWitness)
+        writeBytes(value, item);
+      writeRecord(data, {PSBT_IN_SCRIPTWITNESS}, value);
+    }
+    data.push_back(0x00);
+  }
+
+  for (size_t i = 0; i < tx.vout.size(); i++)
+    data.push_back(0x00);
+}
+
+bool PartiallySignedTransaction::deserialize(const unsigned char *pData,
+                                             const unsigned char *pEnd) {
+  if (pEnd - pData < static_cast<ptrdiff_t>(sizeof(PSBT_MAGIC_BYTES)) ||
+      std::memcmp(pData, PSBT_MAGIC_BYTES, sizeof(PSBT_MAGIC_BYTES)) != 0)
+    return false;
+  pData += sizeof(PSBT_MAGIC_BYTES);
+
+  std::vector<unsigned char> key, value;
+  bool fHaveTx = false;
+  while (true) {
+    if (!readBytes(pData, pEnd, key))
+      return false;
+    if (key.empty())
+      break;
+    if (!readBytes(pData, pEnd, value))
+      return false;
+    if (key.size() == 1 && key[0] == PSBT_GLOBAL_UNSIGNED_TX) {
+      const unsigned char *pTx = value.data();
+      if (!tx.deserialize(pTx, value.data() + value.size()) ||
+          pTx != value.data() + value.size())
+        return false;
+      fHaveTx = true;
+    }
+  }
+  if (!fHaveTx)
+    return false;
+
+  inputs.assign(tx.vin.size(), PSBTInput());
+  for (auto &input : inputs) {
+    while (true) {
+      if (!readBytes(pData, pEnd, key))
+        return false;
+      if (key.empty())
+        break;
+      if (!readBytes(pData, pEnd, value))
+        return false;
+
+      if (key[0] != PSBT_IN_PARTIAL_SIG && key.size() != 1)
+        continue;
+      const unsigned char *pValue = value.data();
+      const unsigned char *pValueEnd = value.data() + value.size();
+      switch (key[0]) {
+      case PSBT_IN_NON_WITNESS_UTXO: {
+        std::shared_ptr<Transaction> utxoTx = std::make_shared<Transaction>();
+        if (!utxoTx->deserialize(pValue, pValueEnd))
+          return false;
+        input.nonWitnessUtxo = utxoTx;
+        break;
+      }
+      case PSBT_IN_WITNESS_UTXO:
+        if (!deserializeTxOut(value, input.witnessUtxo))
+          return false;
+        break;
+      case PSBT_IN_PARTIAL_SIG:
+        input.partialSigs[std::vector<unsigned char>(key.begin() + 1,
+                                                     key.end())] = value;
+        break;
+      case PSBT_IN_SIGHASH:
+        if (value.size() != 4)
+          return false;
+        input.nSighashType = value[0] | value[1] << 8 | value[2] << 16 |
+                             value[3] << 24;
+        break;
+      case PSBT_IN_SCRIPTSIG:
+        input.finalScriptSig = value;
+        break;
+      case PSBT_IN_SCRIPTWITNESS: {
+        uint64_t nItems;
+        if (!readCompactCount(pValue, pValueEnd, 1, nItems))
+          return false;
+        input.finalScriptWitness.resize(nItems);
+        for (auto &item : input.finalScriptWitness) {
+          if (!readBytes(pValue, pValueEnd, item))
+            return false;
+        }
+        break;
+      }
+      default:
+        break;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < tx.vout.size(); i++) {
+    while (true) {
+      if (!readBytes(pData, pEnd, key))
+        return false;
+      if (key.empty())
+        break;
+      if (!readBytes(pData, pEnd, value))
+        return false;
+    }
+  }
+  return pData == pEnd;
+}
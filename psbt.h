@@ -0,0 +1,51 @@
+#ifndef PSBT_H
+#define PSBT_H
+
+#include <map>
+#include <vector>
+
+#include "sign.h"
+#include "transaction.h"
+
+static const unsigned char PSBT_MAGIC_BYTES[5] = {'p', 's', 'b', 't', 0xff};
+
+enum PSBTType : unsigned char {
+  PSBT_GLOBAL_UNSIGNED_TX = 0x00,
+  PSBT_IN_NON_WITNESS_UTXO = 0x00,
+  PSBT_IN_WITNESS_UTXO = 0x01,
+  PSBT_IN_PARTIAL_SIG = 0x02,
+  PSBT_IN_SIGHASH = 0x03,
+  PSBT_IN_SCRIPTSIG = 0x07,
+  PSBT_IN_SCRIPTWITNESS = 0x08,
+};
+
+struct PSBTInput {
+  TransactionRef nonWitnessUtxo;
+  TxOut witnessUtxo;
+  std::map<std::vector<unsigned char>, std::vector<unsigned char>>
+      partialSigs;
+  int nSighashType = 0;
+  Script finalScriptSig;
+  std::vector<std::vector<unsigned char>> finalScriptWitness;
+
+  bool isFinalized() const;
+  bool getUtxo(const OutPoint &prevout, TxOut &utxo) const;
+  bool finalize(const Script &scriptPubKey);
+};
+
+class PartiallySignedTransaction {
+public:
+  Transaction tx;
+  std::vector<PSBTInput> inputs;
+
+  PartiallySignedTransaction();
+  explicit PartiallySignedTransaction(const Transaction &txIn);
+
+  bool isComplete() const;
+  bool extract(Transaction &result) const;
+
+  void serialize(std::vector<unsigned char> &data) const;
+  bool deserialize(const unsigned char *pData, const unsigned char *pEnd);
+};
+
+#endif // PSBT_H
@@ -0,0 +1,52 @@
+#include <algorithm>
+
+#include "script.h"
+
+static const unsigned char HASH160_SIZE = 20;
+
+Script getScriptForPubKeyHash(const KeyID &address) {
+  Script script{OP_DUP, OP_HASH160, HASH160_SIZE};
+  script.insert(script.end(), address.begin(), address.end());
+  script.push_back(OP_EQUALVERIFY);
+  script.push_back(OP_CHECKSIG);
+  return script;
+}
+
+Script getScriptForWitnessPubKeyHash(const KeyID &address) {
+  Script script{OP_0, HASH160_SIZE};
+  script.insert(script.end(), address.begin(), address.end());
+  return script;
+}
+
+Script getScriptForScriptHash(const ScriptID &scriptId) {
+  Script script{OP_HASH160, HASH160_SIZE};
+  script.insert(script.end(), scriptId.begin(), scriptId.end());
+  script.push_back(OP_EQUAL);
+  return script;
+}
+
+ScriptID getScriptID(const Script &script) { return hash160(script); }
+
+bool extractKeyID(const Script &script, KeyID &address) {
+  if (script.size() == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 &&
+      script[2] == HASH160_SIZE && script[23] == OP_EQUALVERIFY &&
+      script[24] == OP_CHECKSIG) {
+    std::copy(script.begin() + 3, script.begin() + 23, address.begin());
+    return true;
+  }
+  if (script.size() == 22 && script[0] == OP_0 &&
+      script[1] == HASH160_SIZE) {
+    std::copy(script.begin() + 2, script.end(), address.begin());
+    return true;
+  }
+  return false;
+}
+
+bool extractScriptID(const Script &script, ScriptID &scriptId) {
+  if (script.size() == 23 && script[0] == OP_HASH160 &&
+      script[1] == HASH160_SIZE && script[22] == OP_EQUAL) {
+    std::copy(script.begin() + 2, script.begin() + 22, scriptId.begin());
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,34 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <vector>
+
+#include "hash.h"
+#include "key.h"
+
+typedef std::vector<unsigned char> Script;
+typedef uint160 ScriptID;
+
+enum OpcodeType : unsigned char {
+  OP_0 = 0x00,
+  OP_DUP = 0x76,
+  OP_EQUAL = 0x87,
+  OP_EQUALVERIFY = 0x88,
+  OP_HASH160 = 0xa9,
+  OP_CHECKSIG = 0xac,
+};
+
+enum IsMineType {
+  ISMINE_NO = 0,
+  ISMINE_SPENDABLE = 1,
+};
+
+Script getScriptForPubKeyHash(const KeyID &address);
+Script getScriptForWitnessPubKeyHash(const KeyID &address);
+Script getScriptForScriptHash(const ScriptID &scriptId);
+ScriptID getScriptID(const Script &script);
+
+bool extractKeyID(const Script &script, KeyID &address);
+bool extractScriptID(const Script &script, ScriptID &scriptId);
+
+#endif // SCRIPT_H
@@ -0,0 +1,145 @@
+#include "sign.h"
+
+static void pushData(Script &script, const std::vector<unsigned char> &data) {
+  script.push_back(static_cast<unsigned char>(data.size()));
+  script.insert(script.end(), data.begin(), data.end());
+}
+
+static void writeOutPoint(std::vector<unsigned char> &data,
+                          const OutPoint &outpoint) {
+  data.insert(data.end(), outpoint.txid.begin(), outpoint.txid.end());
+  writeLE(data, outpoint.n);
+}
+
+static bool isWitnessSpend(const Script &scriptPubKey, const KeyID &address,
+                           Script &redeemScript) {
+  Script witnessProgram = getScriptForWitnessPubKeyHash(address);
+  KeyID scriptAddress;
+  ScriptID scriptId;
+  redeemScript.clear();
+  if (extractKeyID(scriptPubKey, scriptAddress) && scriptAddress == address)
+    return scriptPubKey == witnessProgram;
+  if (extractScriptID(scriptPubKey, scriptId) &&
+      scriptId == getScriptID(witnessProgram)) {
+    redeemScript = witnessProgram;
+    return true;
+  }
+  return false;
+}
+
+PrecomputedTransactionData::PrecomputedTransactionData() {}
+
+PrecomputedTransactionData::PrecomputedTransactionData(const Transaction &tx) {
+  std::vector<unsigned char> prevouts, sequences, outputs;
+  for (auto &txin : tx.vin) {
+    writeOutPoint(prevouts, txin.prevout);
+    writeLE(sequences, txin.nSequence);
+  }
+  for (auto &txout : tx.vout) {
+    writeLE(outputs, txout.nValue);
+    writeCompactSize(outputs, txout.scriptPubKey.size());
+    outputs.insert(outputs.end(), txout.scriptPubKey.begin(),
+                   txout.scriptPubKey.end());
+  }
+  hashPrevouts = hash256(prevouts);
+  hashSequence = hash256(sequences);
+  hashOutputs = hash256(outputs);
+  fReady = true;
+}
+
+uint256 signatureHash(const Transaction &tx, unsigned int nIn,
+                      const Script &scriptCode, Amount nAmount, int nHashType,
+                      SigVersion sigVersion,
+                      const PrecomputedTransactionData *pCache) {
+  std::vector<unsigned char> data;
+  if (sigVersion == SigVersion::BASE) {
+    Transaction txCopy = tx;
+    for (unsigned int i = 0; i < txCopy.vin.size(); i++) {
+      txCopy.vin[i].scriptSig = i == nIn ? scriptCode : Script();
+      txCopy.vin[i].witness.clear();
+    }
+    txCopy.serialize(data, false);
+    writeLE(data, static_cast<uint32_t>(nHashType));
+    return hash256(data);
+  }
+
+  PrecomputedTransactionData cache;
+  if (!pCache || !pCache->fReady) {
+    cache = PrecomputedTransactionData(tx);
+    pCache = &cache;
+  }
+  writeLE(data, tx.nVersion);
+  data.insert(data.end(), pCache->hashPrevouts.begin(),
+              pCache->hashPrevouts.end());
+  data.insert(data.end(), pCache->hashSequence.begin(),
+              pCache->hashSequence.end());
+  writeOutPoint(data, tx.vin[nIn].prevout);
+  writeCompactSize(data, scriptCode.size());
+  data.insert(data.end(), scriptCode.begin(), scriptCode.end());
+  writeLE(data, nAmount);
+  writeLE(data, tx.vin[nIn].nSequence);
+  data.insert(data.end(), pCache->hashOutputs.begin(),
+              pCache->hashOutputs.end());
+  writeLE(data, tx.nLockTime);
+  writeLE(data, static_cast<uint32_t>(nHashType));
+  return hash256(data);
+}
+
+bool buildSignatureData(const Script &scriptPubKey, const PubKey &pubKey,
+                        const std::vector<unsigned char> &signature,
+                        SignatureData &sigdata) {
+  KeyID address = pubKey.getID();
+  Script redeemScript;
+  bool fWitness = isWitnessSpend(scriptPubKey, address, redeemScript);
+  if (!fWitness && scriptPubKey != getScriptForPubKeyHash(address))
+    return false;
+
+  sigdata.pubKey = pubKey;
+  sigdata.signature = signature;
+  sigdata.scriptSig.clear();
+  sigdata.witness.clear();
+  if (fWitness) {
+    if (!redeemScript.empty())
+      pushData(sigdata.scriptSig, redeemScript);
+    sigdata.witness = {signature, pubKey.data()};
+  } else {
+    pushData(sigdata.scriptSig, signature);
+    pushData(sigdata.scriptSig, pubKey.data());
+  }
+  return true;
+}
+
+bool produceSignature(const Key &key, const Transaction &tx, unsigned int nIn,
+                      const Script &scriptPubKey, Amount nAmount,
+                      int nHashType, const PrecomputedTransactionData *pCache,
+                      SignatureData &sigdata) {
+  if (nIn >= tx.vin.size())
+    return false;
+
+  PubKey pubKey = key.getPubKey();
+  KeyID address = pubKey.getID();
+  Script redeemScript;
+  bool fWitness = isWitnessSpend(scriptPubKey, address, redeemScript);
+  if (!fWitness && scriptPubKey != getScriptForPubKeyHash(address))
+    return false;
+
+  std::vector<unsigned char> signature;
+  uint256 hash = signatureHash(
+      tx, nIn, getScriptForPubKeyHash(address), nAmount, nHashType,
+      fWitness ? SigVersion::WITNESS_V0 : SigVersion::BASE, pCache);
+  if (!key.sign(hash, signature))
+    return false;
+  signature.push_back(static_cast<unsigned char>(nHashType));
+  return buildSignatureData(scriptPubKey, pubKey, signature, sigdata);
+}
+
+bool signInput(const Key &key, Transaction &tx, unsigned int nIn,
+               const Script &scriptPubKey, Amount nAmount, int nHashType) {
+  SignatureData sigdata;
+  if (!produceSignature(key, tx, nIn, scriptPubKey, nAmount, nHashType,
+                        nullptr, sigdata))
+    return false;
+  tx.vin[nIn].scriptSig = sigdata.scriptSig;
+  tx.vin[nIn].witness = sigdata.witness;
+  return true;
+}
@@ -0,0 +1,48 @@
+#ifndef SIGN_H
+#define SIGN_H
+
+#include <vector>
+
+#include "key.h"
+#include "script.h"
+#include "transaction.h"
+
+enum SigHashType : int {
+  SIGHASH_ALL = 1,
+};
+
+enum class SigVersion { BASE, WITNESS_V0 };
+
+struct PrecomputedTransactionData {
+  uint256 hashPrevouts;
+  uint256 hashSequence;
+  uint256 hashOutputs;
+  bool fReady = false;
+
+  PrecomputedTransactionData();
+  explicit PrecomputedTransactionData(const Transaction &tx);
+};
+
+struct SignatureData {
+  PubKey pubKey;
+  std::vector<unsigned char> signature;
+  Script scriptSig;
+  std::vector<std::vector<unsigned char>> witness;
+};
+
+uint256 signatureHash(const Transaction &tx, unsigned int nIn,
+                      const Script &scriptCode, Amount nAmount, int nHashType,
+                      SigVersion sigVersion,
+                      const PrecomputedTransactionData *pCache = nullptr);
+bool buildSignatureData(const Script &scriptPubKey, const PubKey &pubKey,
+                        const std::vector<unsigned char> &signature,
+                        SignatureData &sigdata);
+bool produceSignature(const Key &key, const Transaction &tx, unsigned int nIn,
+                      const Script &scriptPubKey, Amount nAmount,
+                      int nHashType, const PrecomputedTransactionData *pCache,
+                      SignatureData &sigdata);
+bool signInput(const Key &key, Transaction &tx, unsigned int nIn,
+               const Script &scriptPubKey, Amount nAmount,
+               int nHashType = SIGHASH_ALL);
+
+#endif // SIGN_H
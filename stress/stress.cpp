@@ -0,0 +1,557 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include "berkeley_db.h"
+#include "util.h"
+
+enum StressOp {
+  OP_READ,
+  OP_WRITE,
+  OP_ERASE,
+  OP_SCAN,
+  OP_TXN,
+  OP_BACKUP,
+  OP_FLUSH,
+  OP_RELOAD,
+  OP_COUNT,
+};
+
+static const char *const OP_NAMES[OP_COUNT] = {
+    "read", "write", "erase", "scan", "txn", "backup", "flush", "reload"};
+static const int FINGERPRINT_SIZE = 8;
+
+struct SizeDistribution {
+  enum { FIXED, UNIFORM, EXPONENTIAL } type;
+  int nMin;
+  int nMax;
+
+  int sample(std::mt19937_64 &rng) const;
+};
+
+struct StressConfig {
+  int nThreads;
+  int nSeconds;
+  size_t nKeys;
+  int nTxnSize;
+  int nTxnAbortPercent;
+  int nScanLimit;
+  std::vector<double> weights;
+  SizeDistribution keySize;
+  SizeDistribution valueSize;
+  int nBackupMs;
+  int nFlushMs;
+  int nReloadMs;
+  int nWatchdogSeconds;
+  uint64_t nSeed;
+};
+
+struct ThreadState {
+  std::string name;
+  std::atomic<int> nOp;
+  std::atomic<int64_t> nOpStart;
+  std::vector<int64_t> latencies[OP_COUNT];
+  uint64_t nErrors[OP_COUNT] = {};
+  uint64_t nMisses = 0;
+  uint64_t nCorrupt = 0;
+  std::string firstError;
+
+  ThreadState() : nOp(-1), nOpStart(0) {}
+};
+
+static std::atomic<bool> fStop(false);
+static std::atomic<bool> fJoined(false);
+static std::atomic<uint64_t> nCompleted(0);
+
+static int64_t nowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int SizeDistribution::sample(std::mt19937_64 &rng) const {
+  switch (type) {
+  case UNIFORM:
+    return std::uniform_int_distribution<int>(nMin, nMax)(rng);
+  case EXPONENTIAL: {
+    std::exponential_distribution<double> dist(1.0 / nMin);
+    return std::min(nMax, std::max(1, static_cast<int>(dist(rng))));
+  }
+  default:
+    return nMin;
+  }
+}
+
+// fixed:<n>, uniform:<min>-<max> or exp:<mean> (capped at 16 times the mean).
+static bool parseDistribution(const QString &text, SizeDistribution &dist) {
+  QStringList parts = text.split(':');
+  if (parts.size() != 2)
+    return false;
+  bool fOk = false;
+  if (parts[0] == "fixed") {
+    dist.type = SizeDistribution::FIXED;
+    dist.nMin = dist.nMax = parts[1].toInt(&fOk);
+  } else if (parts[0] == "uniform") {
+    QStringList range = parts[1].split('-');
+    bool fMaxOk = false;
+    if (range.size() != 2)
+      return false;
+    dist.type = SizeDistribution::UNIFORM;
+    dist.nMin = range[0].toInt(&fOk);
+    dist.nMax = range[1].toInt(&fMaxOk);
+    fOk = fOk && fMaxOk && dist.nMin <= dist.nMax;
+  } else if (parts[0] == "exp") {
+    dist.type = SizeDistribution::EXPONENTIAL;
+    dist.nMin = parts[1].toInt(&fOk);
+    dist.nMax = dist.nMin * 16;
+  }
+  return fOk && dist.nMin > 0;
+}
+
+// <op>=<weight>,... over read, write, erase, scan and txn.
+static bool parseMix(const QString &text, std::vector<double> &weights) {
+  weights.assign(OP_TXN + 1, 0);
+  for (const QString &item : text.split(',')) {
+    QStringList parts = item.split('=');
+    if (parts.size() != 2)
+      return false;
+    int nOp = 0;
+    while (nOp <= OP_TXN && parts[0] != OP_NAMES[nOp])
+      nOp++;
+    bool fOk = false;
+    if (nOp > OP_TXN)
+      return false;
+    weights[nOp] = parts[1].toDouble(&fOk);
+    if (!fOk || weights[nOp] < 0)
+      return false;
+  }
+  return std::any_of(weights.begin(), weights.end(),
+                     [](double weight) { return weight > 0; });
+}
+
+static uint64_t fingerprint(const QByteArray &key) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (int i = 0; i < key.size(); i++)
+    hash = (hash ^ static_cast<unsigned char>(key[i])) * 0x100000001b3;
+  return hash;
+}
+
+// Values start with a fingerprint of their key so reads and scans can tell a
+// value that belongs to another record from a stale one.
+static QByteArray makeValue(const QByteArray &key, int nSize) {
+  QByteArray value(std::max(nSize, FINGERPRINT_SIZE), 'v');
+  uint64_t hash = fingerprint(key);
+  std::memcpy(value.data(), &hash, FINGERPRINT_SIZE);
+  return value;
+}
+
+static bool checkValue(const QByteArray &key, const QByteArray &value) {
+  uint64_t hash = fingerprint(key);
+  return value.size() >= FINGERPRINT_SIZE &&
+         std::memcmp(value.constData(), &hash, FINGERPRINT_SIZE) == 0;
+}
+
+static bool runOp(int nOp, WalletDatabase &database, const StressConfig &config,
+                  const std::vector<QByteArray> &keys, std::mt19937_64 &rng,
+                  ThreadState &state) {
+  const QByteArray &key = keys[rng() % keys.size()];
+  switch (nOp) {
+  case OP_READ: {
+    std::unique_ptr<DatabaseBatch> batch = database.makeBatch(true);
+    QByteArray value;
+    if (!batch->read(key, value))
+      state.nMisses++;
+    else if (!checkValue(key, value))
+      state.nCorrupt++;
+    return true;
+  }
+  case OP_WRITE: {
+    std::unique_ptr<DatabaseBatch> batch = database.makeBatch();
+    return batch->write(key, makeValue(key, config.valueSize.sample(rng)));
+  }
+  case OP_ERASE: {
+    std::unique_ptr<DatabaseBatch> batch = database.makeBatch();
+    return batch->erase(key);
+  }
+  case OP_SCAN: {
+    std::unique_ptr<DatabaseBatch> batch = database.makeBatch(true);
+    std::unique_ptr<DatabaseCursor> cursor = batch->getNewCursor();
+    if (!cursor)
+      return false;
+    QByteArray keyData, valueData;
+    for (int i = 0; i < config.nScanLimit && cursor->next(keyData, valueData);
+         i++) {
+      QByteArray scanKey, scanValue;
+      QDataStream keyStream(&keyData, QIODevice::ReadOnly);
+      QDataStream valueStream(&valueData, QIODevice::ReadOnly);
+      keyStream >> scanKey;
+      valueStream >> scanValue;
+      if (!checkValue(scanKey, scanValue))
+        state.nCorrupt++;
+    }
+    return true;
+  }
+  case OP_TXN: {
+    std::unique_ptr<DatabaseBatch> batch = database.makeBatch();
+    if (!batch->TxnBegin())
+      return false;
+    for (int i = 0; i < config.nTxnSize; i++) {
+      const QByteArray &txnKey = keys[rng() % keys.size()];
+      bool fOk = rng() % 5
+                     ? batch->write(txnKey, makeValue(txnKey,
+                                                      config.valueSize.sample(
+                                                          rng)))
+                     : batch->erase(txnKey);
+      if (!fOk) {
+        batch->TxnAbort();
+        return false;
+      }
+    }
+    if (static_cast<int>(rng() % 100) < config.nTxnAbortPercent)
+      return batch->TxnAbort();
+    return batch->TxnCommit();
+  }
+  default:
+    return false;
+  }
+}
+
+static void recordOp(ThreadState &state, int nOp, bool fOk,
+                     const std::string &error) {
+  state.latencies[nOp].push_back(nowMicros() - state.nOpStart);
+  state.nOp = -1;
+  if (!fOk) {
+    state.nErrors[nOp]++;
+    if (state.firstError.empty())
+      state.firstError = std::string(OP_NAMES[nOp]) + ": " +
+                         (error.empty() ? "operation failed" : error);
+  }
+  ++nCompleted;
+}
+
+static void runWorker(WalletDatabase &database, const StressConfig &config,
+                      const std::vector<QByteArray> &keys, ThreadState &state,
+                      uint64_t nSeed) {
+  std::mt19937_64 rng(nSeed);
+  std::discrete_distribution<int> pick(config.weights.begin(),
+                                       config.weights.end());
+  while (!fStop) {
+    int nOp = pick(rng);
+    bool fOk = false;
+    std::string error;
+    state.nOpStart = nowMicros();
+    state.nOp = nOp;
+    try {
+      fOk = runOp(nOp, database, config, keys, rng, state);
+    } catch (const std::exception &e) {
+      error = e.what();
+    }
+    recordOp(state, nOp, fOk, error);
+  }
+}
+
+static void runMaintenance(int nOp, int nIntervalMs,
+                           const std::shared_ptr<BerkeleyEnvironment> &env,
+                           BerkeleyDatabase &database, const QDir &backupDir,
+                           ThreadState &state) {
+  QString backupPath = backupDir.filePath("backup.dat");
+  int64_t nNext = nowMicros() + nIntervalMs * 1000;
+  while (!fStop) {
+    if (nowMicros() < nNext) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+    bool fOk = true;
+    std::string error;
+    state.nOpStart = nowMicros();
+    state.nOp = nOp;
+    try {
+      if (nOp == OP_BACKUP) {
+        QFile::remove(backupPath);
+        database.backup(QString2StdString(backupPath));
+      } else if (nOp == OP_FLUSH) {
+        env->flush(false);
+      } else {
+        env->reloadDbEnv();
+      }
+    } catch (const std::exception &e) {
+      fOk = false;
+      error = e.what();
+    }
+    recordOp(state, nOp, fOk, error);
+    nNext = nowMicros() + nIntervalMs * 1000;
+  }
+}
+
+// A stuck operation means a lock cycle or a lost wakeup on cvDbInUse. The
+// threads cannot be joined then, so report what every thread is doing and
+// exit. The watchdog keeps running until the joins finish so a hang on
+// shutdown is caught as well.
+static void runWatchdog(const StressConfig &config,
+                        const std::vector<std::unique_ptr<ThreadState>> &states,
+                        int64_t nStart) {
+  const int64_t nLimit = config.nWatchdogSeconds * 1000000LL;
+  int64_t nNextReport = nowMicros() + 1000000;
+  uint64_t nLastCompleted = 0;
+  while (!fJoined) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int64_t nNow = nowMicros();
+
+    bool fStalled = false;
+    for (const auto &state : states) {
+      if (state->nOp >= 0 && nNow - state->nOpStart > nLimit)
+        fStalled = true;
+    }
+    if (fStalled) {
+      std::fprintf(stderr, "DEADLOCK: no progress for %d s\n",
+                   config.nWatchdogSeconds);
+      for (const auto &state : states) {
+        int nOp = state->nOp;
+        if (nOp >= 0)
+          std::fprintf(stderr, "  %-12s in %-6s for %.1f s\n",
+                       state->name.c_str(), OP_NAMES[nOp],
+                       (nNow - state->nOpStart) / 1e6);
+        else
+          std::fprintf(stderr, "  %-12s idle\n", state->name.c_str());
+      }
+      std::fflush(stderr);
+      std::_Exit(2);
+    }
+
+    if (!fStop && nNow >= nNextReport) {
+      uint64_t nTotal = nCompleted;
+      std::printf("%5.0f s %10llu ops/s\n", (nNow - nStart) / 1e6,
+                  static_cast<unsigned long long>(nTotal - nLastCompleted));
+      std::fflush(stdout);
+      nLastCompleted = nTotal;
+      nNextReport += 1000000;
+    }
+  }
+}
+
+static int64_t percentile(const std::vector<int64_t> &sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  size_t nIndex = static_cast<size_t>(p * sorted.size());
+  return sorted[std::min(nIndex, sorted.size() - 1)];
+}
+
+static int report(const StressConfig &config,
+                  const std::vector<std::unique_ptr<ThreadState>> &states,
+                  int64_t nMicros) {
+  uint64_t nErrors = 0, nMisses = 0, nCorrupt = 0;
+  std::printf("\n%-7s %9s %7s %10s %8s %8s %8s %9s %9s\n", "op", "count",
+              "errors", "ops/s", "p50us", "p90us", "p99us", "p99.9us",
+              "maxus");
+  for (int nOp = 0; nOp < OP_COUNT; nOp++) {
+    std::vector<int64_t> latencies;
+    uint64_t nOpErrors = 0;
+    for (const auto &state : states) {
+      latencies.insert(latencies.end(), state->latencies[nOp].begin(),
+                       state->latencies[nOp].end());
+      nOpErrors += state->nErrors[nOp];
+    }
+    if (latencies.empty())
+      continue;
+    std::sort(latencies.begin(), latencies.end());
+    nErrors += nOpErrors;
+    std::printf("%-7s %9zu %7llu %10.0f %8lld %8lld %8lld %9lld %9lld\n",
+                OP_NAMES[nOp], latencies.size(),
+                static_cast<unsigned long long>(nOpErrors),
+                latencies.size() * 1e6 / std::max<int64_t>(nMicros, 1),
+                static_cast<long long>(percentile(latencies, 0.5)),
+                static_cast<long long>(percentile(latencies, 0.9)),
+                static_cast<long long>(percentile(latencies, 0.99)),
+                static_cast<long long>(percentile(latencies, 0.999)),
+                static_cast<long long>(latencies.back()));
+  }
+
+  for (const auto &state : states) {
+    nMisses += state->nMisses;
+    nCorrupt += state->nCorrupt;
+    if (!state->firstError.empty())
+      std::printf("%s: first error: %s\n", state->name.c_str(),
+                  state->firstError.c_str());
+  }
+  std::printf("\n%llu ops in %.1f s with %d threads, %llu read misses, "
+              "%llu corrupt values, %llu errors\n",
+              static_cast<unsigned long long>(nCompleted.load()),
+              nMicros / 1e6, config.nThreads,
+              static_cast<unsigned long long>(nMisses),
+              static_cast<unsigned long long>(nCorrupt),
+              static_cast<unsigned long long>(nErrors));
+  return (nErrors || nCorrupt) ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("wallet_stress");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Concurrent load generator for the Berkeley DB storage layer");
+  parser.addHelpOption();
+  QCommandLineOption datadirOption(
+      "datadir", "Database environment directory (default: temporary).",
+      "dir");
+  QCommandLineOption threadsOption("threads", "Worker threads.", "n", "8");
+  QCommandLineOption durationOption("duration", "Seconds to run.", "seconds",
+                                    "10");
+  QCommandLineOption mixOption(
+      "mix", "Operation weights over read, write, erase, scan and txn.",
+      "mix", "read=50,write=25,erase=5,scan=5,txn=15");
+  QCommandLineOption keysOption("keys", "Number of distinct keys.", "n",
+                                "10000");
+  QCommandLineOption keysizeOption(
+      "keysize", "Key size: fixed:<n>, uniform:<min>-<max> or exp:<mean>.",
+      "dist", "uniform:16-48");
+  QCommandLineOption valuesizeOption("valuesize", "Value size distribution.",
+                                     "dist", "exp:128");
+  QCommandLineOption txnsizeOption("txnsize", "Writes per transaction.", "n",
+                                   "10");
+  QCommandLineOption txnabortOption(
+      "txnabort", "Percentage of transactions aborted.", "percent", "10");
+  QCommandLineOption scanlimitOption("scanlimit", "Records read per scan.",
+                                     "n", "1000");
+  QCommandLineOption backupOption(
+      "backup", "Back up the database every <ms> (default: off).", "ms", "0");
+  QCommandLineOption flushOption(
+      "flush", "Flush the environment every <ms> (default: off).", "ms", "0");
+  QCommandLineOption reloadOption(
+      "reload", "Reload the environment every <ms> (default: off).", "ms",
+      "0");
+  QCommandLineOption watchdogOption(
+      "watchdog", "Report a deadlock when an operation runs this long.",
+      "seconds", "30");
+  QCommandLineOption seedOption("seed", "Random seed.", "n", "1");
+  for (const QCommandLineOption &option :
+       {datadirOption, threadsOption, durationOption, mixOption, keysOption,
+        keysizeOption, valuesizeOption, txnsizeOption, txnabortOption,
+        scanlimitOption, backupOption, flushOption, reloadOption,
+        watchdogOption, seedOption})
+    parser.addOption(option);
+  parser.process(app);
+
+  StressConfig config;
+  config.nThreads = std::max(1, parser.value(threadsOption).toInt());
+  config.nSeconds = std::max(1, parser.value(durationOption).toInt());
+  config.nKeys = std::max(1, parser.value(keysOption).toInt());
+  config.nTxnSize = std::max(1, parser.value(txnsizeOption).toInt());
+  config.nTxnAbortPercent = parser.value(txnabortOption).toInt();
+  config.nScanLimit = std::max(1, parser.value(scanlimitOption).toInt());
+  config.nBackupMs = parser.value(backupOption).toInt();
+  config.nFlushMs = parser.value(flushOption).toInt();
+  config.nReloadMs = parser.value(reloadOption).toInt();
+  config.nWatchdogSeconds =
+      std::max(1, parser.value(watchdogOption).toInt());
+  config.nSeed = parser.value(seedOption).toULongLong();
+  if (!parseMix(parser.value(mixOption), config.weights) ||
+      !parseDistribution(parser.value(keysizeOption), config.keySize) ||
+      !parseDistribution(parser.value(valuesizeOption), config.valueSize)) {
+    std::fprintf(stderr, "wallet_stress: invalid -mix, -keysize or "
+                         "-valuesize\n");
+    return 1;
+  }
+
+  QTemporaryDir tempDir;
+  QDir datadir(parser.isSet(datadirOption) ? parser.value(datadirOption)
+                                           : tempDir.path());
+  QDir backupDir(datadir.filePath("backups"));
+
+  std::vector<QByteArray> keys;
+  keys.reserve(config.nKeys);
+  for (size_t i = 0; i < config.nKeys; i++) {
+    std::mt19937_64 rng(config.nSeed ^ (i * 0x9e3779b97f4a7c15));
+    QByteArray key(config.keySize.sample(rng), 0);
+    for (int j = 0; j < key.size(); j++)
+      key.data()[j] = static_cast<char>(rng());
+    keys.push_back(key);
+  }
+
+  int ret = 0;
+  try {
+    createDirectories(datadir);
+    createDirectories(backupDir);
+    std::shared_ptr<BerkeleyEnvironment> env(new BerkeleyEnvironment(datadir));
+    {
+      BerkeleyDatabase database(env, "stress.dat");
+      {
+        std::mt19937_64 rng(config.nSeed);
+        std::unique_ptr<DatabaseBatch> batch = database.makeBatch(false, true);
+        for (size_t i = 0; i < keys.size(); i += 1000) {
+          batch->TxnBegin();
+          for (size_t j = i; j < std::min(keys.size(), i + 1000); j++)
+            batch->write(keys[j], makeValue(keys[j],
+                                            config.valueSize.sample(rng)));
+          batch->TxnCommit();
+        }
+      }
+
+      std::vector<std::unique_ptr<ThreadState>> states;
+      std::vector<std::thread> threads;
+      for (int t = 0; t < config.nThreads; t++) {
+        states.emplace_back(new ThreadState());
+        states.back()->name = "worker-" + std::to_string(t);
+      }
+      const std::vector<std::pair<int, int>> maintenance = {
+          {OP_BACKUP, config.nBackupMs},
+          {OP_FLUSH, config.nFlushMs},
+          {OP_RELOAD, config.nReloadMs}};
+      for (const auto &task : maintenance) {
+        if (task.second <= 0)
+          continue;
+        states.emplace_back(new ThreadState());
+        states.back()->name = OP_NAMES[task.first];
+      }
+
+      int64_t nStart = nowMicros();
+      int64_t nEnd = nStart + config.nSeconds * 1000000LL;
+      for (int t = 0; t < config.nThreads; t++)
+        threads.emplace_back(runWorker, std::ref(database), std::cref(config),
+                             std::cref(keys), std::ref(*states[t]),
+                             config.nSeed + t + 1);
+      size_t nState = config.nThreads;
+      for (const auto &task : maintenance) {
+        if (task.second <= 0)
+          continue;
+        threads.emplace_back(runMaintenance, task.first, task.second,
+                             std::cref(env), std::ref(database),
+                             std::cref(backupDir), std::ref(*states[nState++]));
+      }
+      std::thread watchdog(runWatchdog, std::cref(config), std::cref(states),
+                           nStart);
+
+      while (nowMicros() < nEnd)
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      fStop = true;
+      for (auto &thread : threads)
+        thread.join();
+      int64_t nMicros = nowMicros() - nStart;
+      fJoined = true;
+      watchdog.join();
+
+      ret = report(config, states, nMicros);
+    }
+    env->flush(true);
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "wallet_stress: %s\n", e.what());
+    ret = 1;
+  }
+  return ret;
+}
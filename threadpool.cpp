@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(unsigned int nThreads) {
+  _fStop = false;
+  if (nThreads == 0)
+    nThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned int i = 0; i < nThreads; i++)
+    _threads.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    const std::lock_guard<std::mutex> lock(_mutexTasks);
+    _fStop = true;
+  }
+  _cvTasks.notify_all();
+  for (auto &thread : _threads)
+    thread.join();
+}
+
+unsigned int ThreadPool::size() const { return _threads.size(); }
+
+void ThreadPool::post(std::function<void()> task) {
+  std::string errorMsg = "Cannot post task: ";
+  {
+    const std::lock_guard<std::mutex> lock(_mutexTasks);
+    if (_fStop)
+      throw std::runtime_error(errorMsg + "Thread pool is stopped");
+    _tasks.push_back(std::move(task));
+  }
+  _cvTasks.notify_one();
+}
+
+void ThreadPool::parallelFor(
+    size_t nItems, const std::function<void(size_t begin, size_t end)> &fn) {
+  size_t nSlices = std::min<size_t>(nItems, _threads.size());
+  std::vector<std::future<void>> results;
+  for (size_t i = 0; i < nSlices; i++) {
+    size_t begin = nItems * i / nSlices;
+    size_t end = nItems * (i + 1) / nSlices;
+    results.push_back(submit([&fn, begin, end]() { fn(begin, end); }));
+  }
+  for (auto &result : results)
+    result.wait();
+  for (auto &result : results)
+    result.get();
+}
+
+void ThreadPool::parallelForEach(size_t nItems,
+                                 const std::function<void(size_t)> &fn) {
+  struct Slice {
+    std::mutex mutex;
+    size_t nBegin;
+    size_t nEnd;
+  };
+
+  size_t nSlices = std::min<size_t>(nItems, _threads.size());
+  std::vector<Slice> slices(nSlices);
+  for (size_t i = 0; i < nSlices; i++) {
+    slices[i].nBegin = nItems * i / nSlices;
+    slices[i].nEnd = nItems * (i + 1) / nSlices;
+  }
+
+  auto takeOwn = [&slices](size_t nSlice, size_t &nItem) {
+    const std::lock_guard<std::mutex> lock(slices[nSlice].mutex);
+    if (slices[nSlice].nBegin == slices[nSlice].nEnd)
+      return false;
+    nItem = slices[nSlice].nBegin++;
+    return true;
+  };
+
+  auto steal = [&slices, nSlices](size_t nSlice) {
+    while (true) {
+      size_t nVictim = nSlices, nLargest = 0;
+      for (size_t i = 0; i < nSlices; i++) {
+        const std::lock_guard<std::mutex> lock(slices[i].mutex);
+        if (slices[i].nEnd - slices[i].nBegin > nLargest) {
+          nLargest = slices[i].nEnd - slices[i].nBegin;
+          nVictim = i;
+        }
+      }
+      if (nVictim == nSlices)
+        return false;
+
+      size_t nBegin, nEnd;
+      {
+        const std::lock_guard<std::mutex> lock(slices[nVictim].mutex);
+        Slice &victim = slices[nVictim];
+        if (victim.nBegin == victim.nEnd)
+          continue;
+        nBegin = victim.nBegin + (victim.nEnd - victim.nBegin) / 2;
+        nEnd = victim.nEnd;
+        victim.nEnd = nBegin;
+      }
+      const std::lock_guard<std::mutex> lock(slices[nSlice].mutex);
+      slices[nSlice].nBegin = nBegin;
+      slices[nSlice].nEnd = nEnd;
+      return true;
+    }
+  };
+
+  std::vector<std::future<void>> results;
+  for (size_t i = 0; i < nSlices; i++) {
+    results.push_back(submit([&fn, &takeOwn, &steal, i]() {
+      size_t nItem;
+      do {
+        while (takeOwn(i, nItem))
+          fn(nItem);
+      } while (steal(i));
+    }));
+  }
+  for (auto &result : results)
+    result.wait();
+  for (auto &result : results)
+    result.get();
+}
+
+void ThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(_mutexTasks);
+      _cvTasks.wait(lock, [this]() { return _fStop || !_tasks.empty(); });
+      if (_tasks.empty())
+        return;
+      task = std::move(_tasks.front());
+      _tasks.pop_front();
+    }
+    task();
+  }
+}
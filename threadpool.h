@@ -0,0 +1,49 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+private:
+  std::vector<std::thread> _threads;
+  std::deque<std::function<void()>> _tasks;
+  std::mutex _mutexTasks;
+  std::condition_variable _cvTasks;
+  bool _fStop;
+
+  void workerLoop();
+
+public:
+  explicit ThreadPool(unsigned int nThreads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  unsigned int size() const;
+
+  void post(std::function<void()> task);
+  void parallelFor(size_t nItems,
+                   const std::function<void(size_t begin, size_t end)> &fn);
+  // Each worker drains its own slice of [0, nItems) and, once empty, steals
+  // the upper half of the largest remaining slice. Use it when item costs are
+  // uneven.
+  void parallelForEach(size_t nItems, const std::function<void(size_t)> &fn);
+
+  template <typename F> auto submit(F &&f) -> std::future<decltype(f())> {
+    typedef decltype(f()) R;
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    std::future<R> result = task->get_future();
+    post([task]() { (*task)(); });
+    return result;
+  }
+};
+
+#endif // THREADPOOL_H
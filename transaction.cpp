@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <cstring>
+
+#include "transaction.h"
+
+static const uint64_t MAX_VECTOR_SIZE = 0x2000000;
+
+template <typename T>
+static bool readLE(const unsigned char *&pData, const unsigned char *pEnd,
+                   T &value) {
+  if (static_cast<size_t>(pEnd - pData) < sizeof(T))
+    return false;
+  uint64_t result = 0;
+  for (size_t i = 0; i < sizeof(T); i++)
+    result |= static_cast<uint64_t>(pData[i]) << (8 * i);
+  value = static_cast<T>(result);
+  pData += sizeof(T);
+  return true;
+}
+
+static void writeBytes(std::vector<unsigned char> &data,
+                       const std::vector<unsigned char> &bytes) {
+  writeCompactSize(data, bytes.size());
+  data.insert(data.end(), bytes.begin(), bytes.end());
+}
+
+static bool readBytes(const unsigned char *&pData, const unsigned char *pEnd,
+                      std::vector<unsigned char> &bytes) {
+  uint64_t nSize;
+  if (!readCompactSize(pData, pEnd, nSize) ||
+      nSize > static_cast<uint64_t>(pEnd - pData))
+    return false;
+  bytes.assign(pData, pData + nSize);
+  pData += nSize;
+  return true;
+}
+
+void writeCompactSize(std::vector<unsigned char> &data, uint64_t nSize) {
+  if (nSize < 253) {
+    data.push_back(static_cast<unsigned char>(nSize));
+  } else if (nSize <= 0xffff) {
+    data.push_back(253);
+    writeLE(data, static_cast<uint16_t>(nSize));
+  } else if (nSize <= 0xffffffff) {
+    data.push_back(254);
+    writeLE(data, static_cast<uint32_t>(nSize));
+  } else {
+    data.push_back(255);
+    writeLE(data, nSize);
+  }
+}
+
+bool readCompactSize(const unsigned char *&pData, const unsigned char *pEnd,
+                     uint64_t &nSize) {
+  if (pData >= pEnd)
+    return false;
+  unsigned char prefix = *pData++;
+  if (prefix < 253) {
+    nSize = prefix;
+    return true;
+  }
+  if (prefix == 253) {
+    uint16_t value;
+    if (!readLE(pData, pEnd, value))
+      return false;
+    nSize = value;
+  } else if (prefix == 254) {
+    uint32_t value;
+    if (!readLE(pData, pEnd, value))
+      return false;
+    nSize = value;
+  } else {
+    if (!readLE(pData, pEnd, nSize))
+      return false;
+  }
+  return nSize <= MAX_VECTOR_SIZE;
+}
+
+bool readCompactCount(const unsigned char *&pData, const unsigned char *pEnd,
+                      size_t nMinItemSize, uint64_t &nCount) {
+  // Every item takes at least nMinItemSize bytes, so a count the remaining
+  // input cannot hold is rejected before anything is allocated for it.
+  return readCompactSize(pData, pEnd, nCount) &&
+         nCount <= static_cast<uint64_t>(pEnd - pData) / nMinItemSize;
+}
+
+OutPoint::OutPoint() : n(0xffffffff) { txid.fill(0); }
+
+OutPoint::OutPoint(const uint256 &txidIn, uint32_t nIn)
+    : txid(txidIn), n(nIn) {}
+
+bool OutPoint::isNull() const {
+  return n == 0xffffffff &&
+         std::all_of(txid.begin(), txid.end(),
+                     [](unsigned char c) { return c == 0; });
+}
+
+bool OutPoint::operator==(const OutPoint &other) const {
+  return n == other.n && txid == other.txid;
+}
+
+bool OutPoint::operator!=(const OutPoint &other) const {
+  return !(*this == other);
+}
+
+bool OutPoint::operator<(const OutPoint &other) const {
+  return txid < other.txid || (txid == other.txid && n < other.n);
+}
+
+size_t OutPointHasher::operator()(const OutPoint &outpoint) const {
+  return ArrayHasher()(outpoint.txid) ^ (outpoint.n * 0x9e3779b97f4a7c15ULL);
+}
+
+bool Transaction::isCoinBase() const {
+  return vin.size() == 1 && vin[0].prevout.isNull();
+}
+
+bool Transaction::hasWitness() const {
+  return std::any_of(vin.begin(), vin.end(),
+                     [](const TxIn &txin) { return !txin.witness.empty(); });
+}
+
+uint256 Transaction::getHash() const {
+  std::vector<unsigned char> data;
+  serialize(data, false);
+  return hash256(data);
+}
+
+Amount Transaction::getValueOut() const {
+  Amount nValue = 0;
+  for (auto &txout : vout)
+    nValue += txout.nValue;
+  return nValue;
+}
+
+void Transaction::serialize(std::vector<unsigned char> &data,
+                            bool fWitness) const {
+  fWitness = fWitness && hasWitness();
+  writeLE(data, nVersion);
+  if (fWitness) {
+    data.push_back(0x00);
+    data.push_back(0x01);
+  }
+  writeCompactSize(data, vin.size());
+  for (auto &txin : vin) {
+    data.insert(data.end(), txin.prevout.txid.begin(),
+                txin.prevout.txid.end());
+    writeLE(data, txin.prevout.n);
+    writeBytes(data, txin.scriptSig);
+    writeLE(data, txin.nSequence);
+  }
+  writeCompactSize(data, vout.size());
+  for (auto &txout : vout) {
+    writeLE(data, txout.nValue);
+    writeBytes(data, txout.scriptPubKey);
+  }
+  if (fWitness) {
+    for (auto &txin : vin) {
+      writeCompactSize(data, txin.witness.size());
+      for (auto &item : txin.witness)
+        writeBytes(data, item);
+    }
+  }
+  writeLE(data, nLockTime);
+}
+
+bool Transaction::deserialize(const unsigned char *&pData,
+                              const unsigned char *pEnd) {
+  uint64_t nSize;
+  bool fWitness = false;
+  if (!readLE(pData, pEnd, nVersion))
+    return false;
+  if (pEnd - pData >= 2 && pData[0] == 0x00 && pData[1] == 0x01) {
+    fWitness = true;
+    pData += 2;
+  }
+
+  // prevout, empty scriptSig and nSequence.
+  if (!readCompactCount(pData, pEnd, 32 + 4 + 1 + 4, nSize))
+    return false;
+  vin.assign(nSize, TxIn());
+  for (auto &txin : vin) {
+    if (pEnd - pData < static_cast<ptrdiff_t>(txin.prevout.txid.size()))
+      return false;
+    std::memcpy(txin.prevout.txid.data(), pData, txin.prevout.txid.size());
+    pData += txin.prevout.txid.size();
+    if (!readLE(pData, pEnd, txin.prevout.n) ||
+        !readBytes(pData, pEnd, txin.scriptSig) ||
+        !readLE(pData, pEnd, txin.nSequence))
+      return false;
+  }
+
+  // nValue and empty scriptPubKey.
+  if (!readCompactCount(pData, pEnd, 8 + 1, nSize))
+    return false;
+  vout.assign(nSize, TxOut());
+  for (auto &txout : vout) {
+    if (!readLE(pData, pEnd, txout.nValue) ||
+        !readBytes(pData, pEnd, txout.scriptPubKey))
+      return false;
+  }
+
+  if (fWitness) {
+    for (auto &txin : vin) {
+      if (!readCompactCount(pData, pEnd, 1, nSize))
+        return false;
+      txin.witness.resize(nSize);
+      for (auto &item : txin.witness) {
+        if (!readBytes(pData, pEnd, item))
+          return false;
+      }
+    }
+  }
+
+  return readLE(pData, pEnd, nLockTime);
+}
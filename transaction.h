@@ -0,0 +1,77 @@
+#ifndef TRANSACTION_H
+#define TRANSACTION_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "hash.h"
+#include "script.h"
+
+typedef int64_t Amount;
+
+static const Amount COIN = 100000000;
+static const Amount MAX_MONEY = 21000000 * COIN;
+static const int COINBASE_MATURITY = 100;
+
+struct OutPoint {
+  uint256 txid;
+  uint32_t n;
+
+  OutPoint();
+  OutPoint(const uint256 &txidIn, uint32_t nIn);
+
+  bool isNull() const;
+  bool operator==(const OutPoint &other) const;
+  bool operator!=(const OutPoint &other) const;
+  bool operator<(const OutPoint &other) const;
+};
+
+struct OutPointHasher {
+  size_t operator()(const OutPoint &outpoint) const;
+};
+
+struct TxIn {
+  OutPoint prevout;
+  Script scriptSig;
+  std::vector<std::vector<unsigned char>> witness;
+  uint32_t nSequence = 0xffffffff;
+};
+
+struct TxOut {
+  Amount nValue = -1;
+  Script scriptPubKey;
+};
+
+class Transaction {
+public:
+  int32_t nVersion = 2;
+  std::vector<TxIn> vin;
+  std::vector<TxOut> vout;
+  uint32_t nLockTime = 0;
+
+  bool isCoinBase() const;
+  bool hasWitness() const;
+  uint256 getHash() const;
+  Amount getValueOut() const;
+
+  void serialize(std::vector<unsigned char> &data,
+                 bool fWitness = true) const;
+  bool deserialize(const unsigned char *&pData, const unsigned char *pEnd);
+};
+
+typedef std::shared_ptr<const Transaction> TransactionRef;
+
+template <typename T> void writeLE(std::vector<unsigned char> &data, T value) {
+  for (size_t i = 0; i < sizeof(T); i++)
+    data.push_back(static_cast<unsigned char>(
+        static_cast<uint64_t>(value) >> (8 * i)));
+}
+
+void writeCompactSize(std::vector<unsigned char> &data, uint64_t nSize);
+bool readCompactSize(const unsigned char *&pData, const unsigned char *pEnd,
+                     uint64_t &nSize);
+bool readCompactCount(const unsigned char *&pData, const unsigned char *pEnd,
+                      size_t nMinItemSize, uint64_t &nCount);
+
+#endif // TRANSACTION_H
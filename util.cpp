@@ -1,3 +1,4 @@
+#include <cstdint>
 #include <mutex>
 #include <set>
 
@@ -12,6 +13,62 @@ QString StdString2QString(const std::string &s) {
   return QString::fromStdString(s);
 }
 
+std::vector<unsigned char> QByteArray2Bytes(const QByteArray &s) {
+  return std::vector<unsigned char>(s.begin(), s.end());
+}
+
+std::string HexStr(const unsigned char *data, size_t size) {
+  static const char hexDigits[] = "0123456789abcdef";
+  std::string result(size * 2, '0');
+  for (size_t i = 0; i < size; i++) {
+    result[2 * i] = hexDigits[data[i] >> 4];
+    result[2 * i + 1] = hexDigits[data[i] & 0x0f];
+  }
+  return result;
+}
+
+uint32_t crc32(const unsigned char *pData, size_t nSize) {
+  static uint32_t table[256];
+  static std::once_flag tableFlag;
+  std::call_once(tableFlag, []() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+  });
+
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < nSize; i++)
+    crc = table[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+  return crc ^ 0xFFFFFFFF;
+}
+
+bool ParseHex(const std::string &s, std::vector<unsigned char> &data) {
+  auto hexValue = [](char c) {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    return -1;
+  };
+
+  if (s.size() % 2 != 0)
+    return false;
+  data.resize(s.size() / 2);
+  for (size_t i = 0; i < data.size(); i++) {
+    int high = hexValue(s[2 * i]);
+    int low = hexValue(s[2 * i + 1]);
+    if (high < 0 || low < 0)
+      return false;
+    data[i] = static_cast<unsigned char>((high << 4) | low);
+  }
+  return true;
+}
+
 void createDirectories(const QDir &pathDir) {
   std::string errorMsg = "Cannot create directories: ";
   if (!QDir::root().mkpath(pathDir.absolutePath()))
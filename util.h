@@ -2,13 +2,29 @@
 #define UTIL_H
 
 #include <chrono>
+#include <cstdint>
 #include <string>
+#include <vector>
 
+#include <QByteArray>
 #include <QDir>
 
 std::string QString2StdString(const QString &s);
 QString StdString2QString(const std::string &s);
 
+std::vector<unsigned char> QByteArray2Bytes(const QByteArray &s);
+template <typename T> QByteArray Bytes2QByteArray(const T &s) {
+  return QByteArray(reinterpret_cast<const char *>(s.data()), s.size());
+}
+
+std::string HexStr(const unsigned char *data, size_t size);
+template <typename T> std::string HexStr(const T &s) {
+  return HexStr(s.data(), s.size());
+}
+bool ParseHex(const std::string &s, std::vector<unsigned char> &data);
+
+uint32_t crc32(const unsigned char *pData, size_t nSize);
+
 void createDirectories(const QDir &pathDir);
 
 void lockDirectory(const QDir &pathDir, const std::string &lockfileName);
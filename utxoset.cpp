@@ -0,0 +1,222 @@
+#include "utxoset.h"
+
+UtxoSet::UtxoSet() { _nTipHeight = -1; }
+
+void UtxoSet::clear() {
+  _vOutPoints.clear();
+  _vAmounts.clear();
+  _vHeights.clear();
+  _vFlags.clear();
+  _mapPositions.clear();
+  _balances = WalletBalances();
+}
+
+size_t UtxoSet::size() const { return _vOutPoints.size(); }
+
+void UtxoSet::account(size_t nPos, int nSign) {
+  Amount nValue = nSign * _vAmounts[nPos];
+  int32_t nHeight = _vHeights[nPos];
+  uint8_t nFlags = _vFlags[nPos];
+
+  if (nHeight < 0) {
+    if (nFlags & UTXO_COINBASE)
+      _balances.immature_balance += nValue;
+    else if (nFlags & UTXO_FROM_ME)
+      _balances.balance += nValue;
+    else
+      _balances.unconfirmed_balance += nValue;
+  } else if ((nFlags & UTXO_COINBASE) &&
+             _nTipHeight - nHeight + 1 <= COINBASE_MATURITY) {
+    _balances.immature_balance += nValue;
+  } else {
+    _balances.balance += nValue;
+  }
+}
+
+bool UtxoSet::contains(const OutPoint &outpoint) const {
+  return _mapPositions.count(outpoint);
+}
+
+bool UtxoSet::get(const OutPoint &outpoint, Amount &nValue, int32_t &nHeight,
+                  uint8_t &nFlags) const {
+  auto it = _mapPositions.find(outpoint);
+  if (it == _mapPositions.end())
+    return false;
+  nValue = _vAmounts[it->second];
+  nHeight = _vHeights[it->second];
+  nFlags = _vFlags[it->second];
+  return true;
+}
+
+void UtxoSet::add(const OutPoint &outpoint, Amount nValue, int32_t nHeight,
+                  uint8_t nFlags) {
+  if (_mapPositions.count(outpoint))
+    remove(outpoint);
+
+  _mapPositions[outpoint] = _vOutPoints.size();
+  _vOutPoints.push_back(outpoint);
+  _vAmounts.push_back(nValue);
+  _vHeights.push_back(nHeight);
+  _vFlags.push_back(nFlags);
+  account(_vOutPoints.size() - 1, 1);
+}
+
+bool UtxoSet::remove(const OutPoint &outpoint) {
+  auto it = _mapPositions.find(outpoint);
+  if (it == _mapPositions.end())
+    return false;
+
+  size_t nPos = it->second;
+  size_t nLast = _vOutPoints.size() - 1;
+  account(nPos, -1);
+  _mapPositions.erase(it);
+  if (nPos != nLast) {
+    _vOutPoints[nPos] = _vOutPoints[nLast];
+    _vAmounts[nPos] = _vAmounts[nLast];
+    _vHeights[nPos] = _vHeights[nLast];
+    _vFlags[nPos] = _vFlags[nLast];
+    _mapPositions[_vOutPoints[nPos]] = nPos;
+  }
+  _vOutPoints.pop_back();
+  _vAmounts.pop_back();
+  _vHeights.pop_back();
+  _vFlags.pop_back();
+  return true;
+}
+
+bool UtxoSet::setHeight(const OutPoint &outpoint, int32_t nHeight) {
+  auto it = _mapPositions.find(outpoint);
+  if (it == _mapPositions.end())
+    return false;
+  account(it->second, -1);
+  _vHeights[it->second] = nHeight;
+  account(it->second, 1);
+  return true;
+}
+
+bool UtxoSet::setFlag(const OutPoint &outpoint, uint8_t nFlag, bool fSet) {
+  auto it = _mapPositions.find(outpoint);
+  if (it == _mapPositions.end())
+    return false;
+  account(it->second, -1);
+  if (fSet)
+    _vFlags[it->second] |= nFlag;
+  else
+    _vFlags[it->second] &= ~nFlag;
+  account(it->second, 1);
+  return true;
+}
+
+void UtxoSet::setTipHeight(int32_t nHeight) {
+  _nTipHeight = nHeight;
+
+  const size_t nSize = _vAmounts.size();
+  const Amount *pAmounts = _vAmounts.data();
+  const int32_t *pHeights = _vHeights.data();
+  const uint8_t *pFlags = _vFlags.data();
+  int32_t nImmatureHeight = nHeight - COINBASE_MATURITY + 1;
+  Amount nTrusted = 0, nPending = 0, nImmature = 0;
+  for (size_t i = 0; i < nSize; i++) {
+    int64_t fUnconfirmed = pHeights[i] < 0;
+    int64_t fCoinBase = (pFlags[i] & UTXO_COINBASE) != 0;
+    int64_t fFromMe = (pFlags[i] & UTXO_FROM_ME) != 0;
+    int64_t fImmature =
+        fCoinBase & (fUnconfirmed | (pHeights[i] >= nImmatureHeight));
+    int64_t fPending = fUnconfirmed & (1 - fCoinBase) & (1 - fFromMe);
+    int64_t fTrusted = (1 - fImmature) & (1 - fPending);
+    nTrusted += pAmounts[i] & -fTrusted;
+    nPending += pAmounts[i] & -fPending;
+    nImmature += pAmounts[i] & -fImmature;
+  }
+  _balances.balance = nTrusted;
+  _balances.unconfirmed_balance = nPending;
+  _balances.immature_balance = nImmature;
+}
+
+int32_t UtxoSet::getTipHeight() const { return _nTipHeight; }
+
+const WalletBalances &UtxoSet::getBalances() const { return _balances; }
+
+Amount UtxoSet::sumFiltered(int nMinDepth, uint8_t nRequiredFlags,
+                            uint8_t nExcludedFlags) const {
+  const size_t nSize = _vAmounts.size();
+  const Amount *pAmounts = _vAmounts.data();
+  const int32_t *pHeights = _vHeights.data();
+  const uint8_t *pFlags = _vFlags.data();
+  int32_t nMaxHeight = _nTipHeight - nMinDepth + 1;
+  Amount nTotal = 0;
+  for (size_t i = 0; i < nSize; i++) {
+    int64_t fDepth = (nMinDepth <= 0) |
+                     ((pHeights[i] >= 0) & (pHeights[i] <= nMaxHeight));
+    int64_t fFlags = ((pFlags[i] & nRequiredFlags) == nRequiredFlags) &
+                     ((pFlags[i] & nExcludedFlags) == 0);
+    nTotal += pAmounts[i] & -(fDepth & fFlags);
+  }
+  return nTotal;
+}
+
+static inline int64_t spendableMask(int32_t nHeight, uint8_t nFlags,
+                                    int32_t nImmatureHeight,
+                                    int32_t nMaxHeight, int nMinDepth) {
+  int64_t fUnconfirmed = nHeight < 0;
+  int64_t fCoinBase = (nFlags & UTXO_COINBASE) != 0;
+  int64_t fFromMe = (nFlags & UTXO_FROM_ME) != 0;
+  int64_t fLocked = (nFlags & UTXO_LOCKED) != 0;
+  int64_t fImmature = fCoinBase & (fUnconfirmed | (nHeight >= nImmatureHeight));
+  int64_t fPending = fUnconfirmed & (1 - fCoinBase) & (1 - fFromMe);
+  int64_t fDepth =
+      (nMinDepth <= 0) | ((1 - fUnconfirmed) & (nHeight <= nMaxHeight));
+  return (1 - fImmature) & (1 - fPending) & (1 - fLocked) & fDepth;
+}
+
+bool UtxoSet::isSpendable(const OutPoint &outpoint, int nMinDepth) const {
+  auto it = _mapPositions.find(outpoint);
+  if (it == _mapPositions.end())
+    return false;
+  return spendableMask(_vHeights[it->second], _vFlags[it->second],
+                       _nTipHeight - COINBASE_MATURITY + 1,
+                       _nTipHeight - nMinDepth + 1, nMinDepth);
+}
+
+Amount UtxoSet::sumSpendable(int nMinDepth) const {
+  const size_t nSize = _vAmounts.size();
+  const Amount *pAmounts = _vAmounts.data();
+  const int32_t *pHeights = _vHeights.data();
+  const uint8_t *pFlags = _vFlags.data();
+  int32_t nImmatureHeight = _nTipHeight - COINBASE_MATURITY + 1;
+  int32_t nMaxHeight = _nTipHeight - nMinDepth + 1;
+  Amount nTotal = 0;
+  for (size_t i = 0; i < nSize; i++)
+    nTotal += pAmounts[i] & -spendableMask(pHeights[i], pFlags[i],
+                                           nImmatureHeight, nMaxHeight,
+                                           nMinDepth);
+  return nTotal;
+}
+
+void UtxoSet::getSpendable(int nMinDepth,
+                           std::vector<uint32_t> &vPositions) const {
+  const size_t nSize = _vAmounts.size();
+  const int32_t *pHeights = _vHeights.data();
+  const uint8_t *pFlags = _vFlags.data();
+  int32_t nImmatureHeight = _nTipHeight - COINBASE_MATURITY + 1;
+  int32_t nMaxHeight = _nTipHeight - nMinDepth + 1;
+  vPositions.resize(nSize + 1);
+  uint32_t *pPositions = vPositions.data();
+  size_t nCount = 0;
+  for (size_t i = 0; i < nSize; i++) {
+    pPositions[nCount] = static_cast<uint32_t>(i);
+    nCount += spendableMask(pHeights[i], pFlags[i], nImmatureHeight,
+                            nMaxHeight, nMinDepth);
+  }
+  vPositions.resize(nCount);
+}
+
+const std::vector<OutPoint> &UtxoSet::getOutPoints() const {
+  return _vOutPoints;
+}
+
+const std::vector<Amount> &UtxoSet::getAmounts() const { return _vAmounts; }
+
+const std::vector<int32_t> &UtxoSet::getHeights() const { return _vHeights; }
+
+const std::vector<uint8_t> &UtxoSet::getFlags() const { return _vFlags; }
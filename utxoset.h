@@ -0,0 +1,67 @@
+#ifndef UTXOSET_H
+#define UTXOSET_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "transaction.h"
+
+enum UtxoFlag : uint8_t {
+  UTXO_COINBASE = 1 << 0,
+  UTXO_FROM_ME = 1 << 1,
+  UTXO_LOCKED = 1 << 2,
+};
+
+struct WalletBalances {
+  Amount balance = 0;
+  Amount unconfirmed_balance = 0;
+  Amount immature_balance = 0;
+};
+
+class UtxoSet {
+private:
+  std::vector<OutPoint> _vOutPoints;
+  std::vector<Amount> _vAmounts;
+  std::vector<int32_t> _vHeights;
+  std::vector<uint8_t> _vFlags;
+  std::unordered_map<OutPoint, uint32_t, OutPointHasher> _mapPositions;
+
+  int32_t _nTipHeight;
+  WalletBalances _balances;
+
+  void account(size_t nPos, int nSign);
+
+public:
+  UtxoSet();
+
+  void clear();
+  size_t size() const;
+
+  bool contains(const OutPoint &outpoint) const;
+  bool get(const OutPoint &outpoint, Amount &nValue, int32_t &nHeight,
+           uint8_t &nFlags) const;
+
+  void add(const OutPoint &outpoint, Amount nValue, int32_t nHeight,
+           uint8_t nFlags);
+  bool remove(const OutPoint &outpoint);
+  bool setHeight(const OutPoint &outpoint, int32_t nHeight);
+  bool setFlag(const OutPoint &outpoint, uint8_t nFlag, bool fSet);
+
+  void setTipHeight(int32_t nHeight);
+  int32_t getTipHeight() const;
+
+  const WalletBalances &getBalances() const;
+  Amount sumFiltered(int nMinDepth, uint8_t nRequiredFlags,
+                     uint8_t nExcludedFlags) const;
+  bool isSpendable(const OutPoint &outpoint, int nMinDepth) const;
+  Amount sumSpendable(int nMinDepth) const;
+  void getSpendable(int nMinDepth, std::vector<uint32_t> &vPositions) const;
+
+  const std::vector<OutPoint> &getOutPoints() const;
+  const std::vector<Amount> &getAmounts() const;
+  const std::vector<int32_t> &getHeights() const;
+  const std::vector<uint8_t> &getFlags() const;
+};
+
+#endif // UTXOSET_H
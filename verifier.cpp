@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+#include "verifier.h"
+
+RecordVerifier::RecordVerifier(WalletDatabase &database,
+                               uint64_t nBytesPerSec, size_t nSliceRecords)
+    : _database(database), _nBytesPerSec(std::max<uint64_t>(1, nBytesPerSec)),
+      _nPasses(0), _nChecked(0), _nUnchecked(0), _nBytes(0) {
+  _nSliceRecords = std::max<size_t>(1, nSliceRecords);
+  _fStop = false;
+}
+
+RecordVerifier::~RecordVerifier() { stop(); }
+
+void RecordVerifier::start() {
+  const std::lock_guard<std::mutex> lock(_mutexVerifier);
+  if (_verifyThread.joinable())
+    return;
+  _fStop = false;
+  _verifyThread = std::thread(&RecordVerifier::verifyLoop, this);
+}
+
+void RecordVerifier::stop() {
+  {
+    const std::lock_guard<std::mutex> lock(_mutexVerifier);
+    _fStop = true;
+  }
+  _cvStop.notify_all();
+  if (_verifyThread.joinable())
+    _verifyThread.join();
+}
+
+void RecordVerifier::setRate(uint64_t nBytesPerSec) {
+  _nBytesPerSec = std::max<uint64_t>(1, nBytesPerSec);
+}
+
+bool RecordVerifier::verifySlice(uint64_t &nBytes) {
+  QByteArray resumeKey;
+  {
+    const std::lock_guard<std::mutex> lock(_mutexVerifier);
+    resumeKey = _resumeKey;
+  }
+
+  std::unique_ptr<DatabaseBatch> batch = _database.makeBatch(true);
+  std::unique_ptr<DatabaseCursor> cursor = batch->getNewCursor();
+  if (!cursor)
+    throw std::runtime_error("Cannot verify records: no cursor");
+  cursor->seek(resumeKey);
+
+  QByteArray keyData, valueData;
+  size_t nRecords = 0;
+  nBytes = 0;
+  while (nRecords < _nSliceRecords && cursor->next(keyData, valueData)) {
+    nRecords++;
+    nBytes += keyData.size() + valueData.size();
+    int nSize = valueData.size();
+    if (batch->checkRecord(keyData, valueData) && valueData.size() == nSize)
+      _nUnchecked++;
+    else
+      _nChecked++;
+  }
+  cursor.reset();
+  batch->close();
+  _nBytes += nBytes;
+
+  bool fPassDone = nRecords < _nSliceRecords;
+  const std::lock_guard<std::mutex> lock(_mutexVerifier);
+  _resumeKey = fPassDone ? QByteArray() : keyData.append('\0');
+  return fPassDone;
+}
+
+void RecordVerifier::verifyLoop() {
+  std::unique_lock<std::mutex> lock(_mutexVerifier);
+  while (!_fStop) {
+    lock.unlock();
+    bool fPassDone = false;
+    uint64_t nBytes = 0;
+    try {
+      fPassDone = verifySlice(nBytes);
+    } catch (const std::exception &) {
+      fPassDone = true;
+    }
+    lock.lock();
+
+    std::chrono::microseconds pause(nBytes * 1000000 / _nBytesPerSec);
+    if (fPassDone) {
+      _nPasses++;
+      pause = std::max<std::chrono::microseconds>(
+          pause, std::chrono::seconds(VERIFY_PASS_INTERVAL_SECS));
+    }
+    _cvStop.wait_for(lock, pause, [this]() { return _fStop; });
+  }
+}
+
+VerifierMetrics RecordVerifier::getMetrics() {
+  VerifierMetrics metrics;
+  metrics.nPasses = _nPasses;
+  metrics.nChecked = _nChecked;
+  metrics.nUnchecked = _nUnchecked;
+  metrics.nBytes = _nBytes;
+  metrics.nCorruptKeys = _database.getCorruptKeys().size();
+  {
+    const std::lock_guard<std::mutex> lock(_mutexVerifier);
+    metrics.resumeKey = _resumeKey;
+  }
+  return metrics;
+}
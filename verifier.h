@@ -0,0 +1,67 @@
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "db.h"
+
+static const size_t DEFAULT_VERIFY_SLICE_RECORDS = 256;
+static const uint64_t DEFAULT_VERIFY_BYTES_PER_SEC = 1 << 20;
+static const int64_t VERIFY_PASS_INTERVAL_SECS = 600;
+
+struct VerifierMetrics {
+  uint64_t nPasses;
+  uint64_t nChecked;
+  uint64_t nUnchecked;
+  uint64_t nBytes;
+  size_t nCorruptKeys;
+  QByteArray resumeKey;
+};
+
+// Walks the database in short read-only cursor slices, checking record
+// envelopes. Each slice opens its own batch and resumes just past the last
+// key seen, so writers are never blocked for long and no cursor is held
+// between slices. Throughput is capped at nBytesPerSec; corrupt keys go to
+// the database's registry and the walk carries on.
+class RecordVerifier {
+private:
+  WalletDatabase &_database;
+  std::atomic<uint64_t> _nBytesPerSec;
+  size_t _nSliceRecords;
+
+  QByteArray _resumeKey;
+  bool _fStop;
+  std::mutex _mutexVerifier;
+  std::condition_variable _cvStop;
+  std::thread _verifyThread;
+
+  std::atomic<uint64_t> _nPasses;
+  std::atomic<uint64_t> _nChecked;
+  std::atomic<uint64_t> _nUnchecked;
+  std::atomic<uint64_t> _nBytes;
+
+  bool verifySlice(uint64_t &nBytes);
+  void verifyLoop();
+
+public:
+  explicit RecordVerifier(
+      WalletDatabase &database,
+      uint64_t nBytesPerSec = DEFAULT_VERIFY_BYTES_PER_SEC,
+      size_t nSliceRecords = DEFAULT_VERIFY_SLICE_RECORDS);
+  ~RecordVerifier();
+
+  RecordVerifier(const RecordVerifier &) = delete;
+  RecordVerifier &operator=(const RecordVerifier &) = delete;
+
+  void start();
+  void stop();
+  void setRate(uint64_t nBytesPerSec);
+
+  VerifierMetrics getMetrics();
+};
+
+#endif // VERIFIER_H
@@ -1,3 +1,1507 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <unordered_set>
+
+#include "blockfile.h"
+#include "sign.h"
+#include "util.h"
 #include "wallet.h"
 
-Wallet::Wallet() {}
+Wallet::Wallet(const std::shared_ptr<BerkeleyEnvironment> &env,
+               const std::string &filename)
+    : Wallet(std::unique_ptr<WalletDatabase>(
+          new BerkeleyDatabase(env, filename))) {}
+
+Wallet::Wallet(std::unique_ptr<WalletDatabase> database)
+    : _database(std::move(database)), _verifier(*_database),
+      _keyPool([this](unsigned int nKeys) { return topUpKeyPool(nKeys); }) {
+  _nMasterKeyMaxId = 0;
+  _nRelockTimeout = 0;
+  _fEncryptionPending = false;
+  _nRescanHeight = -1;
+  _fScanning = false;
+  _fAbortRescan = false;
+  _dScanProgress = 0;
+  _nSignatures = 0;
+  _nSigningBatches = 0;
+  _nLastBatchSignatures = 0;
+  _nLastBatchMicros = 0;
+  _nSigningMicros = 0;
+
+  std::string errorMsg = "Cannot load wallet: ";
+  WalletBatch batch(*_database, false, true);
+  if (!batch.loadWallet(*this))
+    throw std::runtime_error(errorMsg + _database->getFileName());
+
+  _addressIndex.assign(_mapAddressBook);
+  _keyIndex.reserve(_mapKeys.size() + _mapCryptedKeys.size());
+  for (auto &it : _mapKeys)
+    _keyIndex.addKey(it.second.first);
+  for (auto &it : _mapCryptedKeys)
+    _keyIndex.addKey(it.second.first);
+  for (auto &it : _mapWallet) {
+    if (!it.second.fAbandoned)
+      applyTransaction(it.first, it.second);
+  }
+  _keyPool.sort();
+  _keyPool.start();
+}
+
+Wallet::~Wallet() {
+  _keyPool.stop();
+  _verifier.stop();
+  lock();
+  _database.reset();
+}
+
+std::string Wallet::getWalletName() { return _database->getFileName(); }
+
+WalletDatabase &Wallet::getDatabase() { return *_database; }
+
+RecordVerifier &Wallet::getVerifier() { return _verifier; }
+
+bool Wallet::isCrypted() {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  return !_mapMasterKeys.empty();
+}
+
+bool Wallet::decryptMasterKey(const SecureString &wallet_passphrase,
+                              const MasterKey &masterKey,
+                              SecureBytes &vMasterKey) {
+  Crypter crypter;
+  if (!crypter.setKeyFromPassphrase(wallet_passphrase, masterKey.salt,
+                                    masterKey.nDeriveIterations))
+    return false;
+  if (!crypter.decrypt(masterKey.cryptedKey, vMasterKey) ||
+      vMasterKey.size() != KEY_SIZE)
+    return false;
+  return checkMasterKey(vMasterKey);
+}
+
+bool Wallet::checkMasterKey(const SecureBytes &vMasterKey) {
+  if (_mapCryptedKeys.empty())
+    return true;
+
+  const auto &entry = _mapCryptedKeys.begin()->second;
+  SecureBytes secret;
+  Key key;
+  if (!decryptSecret(vMasterKey, entry.second, hash256(entry.first.data()),
+                     secret) ||
+      !key.set(secret))
+    return false;
+  return key.verifyPubKey(entry.first);
+}
+
+bool Wallet::encryptWallet(const SecureString &wallet_passphrase) {
+  {
+    const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+    if (isCrypted()) {
+      if (!_fEncryptionPending || !unlock(wallet_passphrase))
+        return false;
+    } else {
+      SecureBytes vMasterKey(KEY_SIZE);
+      getRandBytes(vMasterKey.data(), vMasterKey.size());
+
+      MasterKey masterKey;
+      masterKey.salt.resize(SALT_SIZE);
+      getRandBytes(masterKey.salt.data(), masterKey.salt.size());
+      masterKey.nDeriveIterations = DEFAULT_DERIVE_ITERATIONS;
+
+      Crypter crypter;
+      if (!crypter.setKeyFromPassphrase(wallet_passphrase, masterKey.salt,
+                                        masterKey.nDeriveIterations) ||
+          !crypter.encrypt(vMasterKey, masterKey.cryptedKey))
+        return false;
+
+      EncryptionState state;
+      state.nMasterKeyId = _nMasterKeyMaxId + 1;
+      state.nEncrypted = 0;
+      state.nTotal = _mapKeys.size();
+
+      WalletBatch batch(*_database);
+      if (!batch.TxnBegin())
+        return false;
+      if (!batch.writeMasterKey(state.nMasterKeyId, masterKey) ||
+          !batch.writeEncryptionState(state)) {
+        batch.TxnAbort();
+        return false;
+      }
+      if (!batch.TxnCommit())
+        return false;
+
+      _nMasterKeyMaxId = state.nMasterKeyId;
+      _mapMasterKeys[state.nMasterKeyId] = masterKey;
+      _session.open(vMasterKey, wallet_passphrase, 0);
+      _encryptionState = state;
+      _fEncryptionPending = true;
+    }
+  }
+
+  bool fSuccess = continueEncryption();
+  lock();
+  return fSuccess;
+}
+
+bool Wallet::continueEncryption() {
+  if (!isEncryptionPending())
+    return true;
+
+  bool fDone = false;
+  while (!fDone) {
+    const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+    if (!_fEncryptionPending)
+      return true;
+    SecureBytes vMasterKey;
+    if (!_session.getMasterKey(vMasterKey))
+      return false;
+
+    std::vector<std::map<KeyID, std::pair<PubKey, Key>>::iterator> chunk;
+    for (auto it = _mapKeys.begin();
+         it != _mapKeys.end() && chunk.size() < ENCRYPTION_CHUNK_SIZE; ++it)
+      chunk.push_back(it);
+
+    std::vector<std::vector<unsigned char>> cryptedSecrets(chunk.size());
+    std::atomic<bool> fFailed(false);
+    _pool.parallelFor(chunk.size(), [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        const PubKey &pubKey = chunk[i]->second.first;
+        const Key &key = chunk[i]->second.second;
+        if (!encryptSecret(vMasterKey, key.getSecret(),
+                           hash256(pubKey.data()), cryptedSecrets[i]))
+          fFailed = true;
+      }
+    });
+    if (fFailed)
+      return false;
+
+    fDone = chunk.size() == _mapKeys.size();
+    EncryptionState state = _encryptionState;
+    state.nEncrypted += chunk.size();
+
+    WalletBatch batch(*_database);
+    if (!batch.TxnBegin())
+      return false;
+    bool fWritten = true;
+    for (size_t i = 0; i < chunk.size() && fWritten; i++)
+      fWritten = batch.writeCryptedKey(chunk[i]->second.first,
+                                       cryptedSecrets[i]);
+    if (fWritten)
+      fWritten = fDone ? batch.eraseEncryptionState()
+                       : batch.writeEncryptionState(state);
+    if (!fWritten) {
+      batch.TxnAbort();
+      return false;
+    }
+    if (!batch.TxnCommit())
+      return false;
+
+    for (size_t i = 0; i < chunk.size(); i++) {
+      _mapCryptedKeys[chunk[i]->first] =
+          std::make_pair(chunk[i]->second.first, cryptedSecrets[i]);
+      _mapKeys.erase(chunk[i]);
+    }
+    _encryptionState = state;
+    _fEncryptionPending = !fDone;
+  }
+
+  // The erased plaintext keys are still in the file's free space and logs.
+  // The rewrite waits for open batches, so it runs without the wallet lock.
+  return _database->rewrite();
+}
+
+bool Wallet::changeWalletPassphrase(
+    const SecureString &old_wallet_passphrase,
+    const SecureString &new_wallet_passphrase) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  for (auto &it : _mapMasterKeys) {
+    SecureBytes vMasterKey;
+    if (!decryptMasterKey(old_wallet_passphrase, it.second, vMasterKey))
+      continue;
+
+    MasterKey masterKey = it.second;
+    getRandBytes(masterKey.salt.data(), masterKey.salt.size());
+    masterKey.nDeriveIterations = DEFAULT_DERIVE_ITERATIONS;
+
+    Crypter crypter;
+    if (!crypter.setKeyFromPassphrase(new_wallet_passphrase, masterKey.salt,
+                                      masterKey.nDeriveIterations) ||
+        !crypter.encrypt(vMasterKey, masterKey.cryptedKey))
+      return false;
+
+    WalletBatch batch(*_database);
+    if (!batch.writeMasterKey(it.first, masterKey))
+      return false;
+    it.second = masterKey;
+    _session.updatePassphrase(new_wallet_passphrase);
+    return true;
+  }
+  return false;
+}
+
+bool Wallet::backupWallet(const std::string &filename,
+                          const SecureString &passphrase, BackupStats &stats) {
+  SecureBytes vMasterKey;
+  MasterKey masterKey;
+  bool fCrypted;
+  {
+    // The lock is only held to derive the master key; records are streamed
+    // from a read-only cursor of their own while the wallet stays usable.
+    const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+    fCrypted = isCrypted();
+    if (fCrypted) {
+      // Reuse the wallet's own master key record so the backup opens with the
+      // wallet passphrase.
+      auto it = _mapMasterKeys.begin();
+      while (it != _mapMasterKeys.end() &&
+             !decryptMasterKey(passphrase, it->second, vMasterKey))
+        ++it;
+      if (it == _mapMasterKeys.end())
+        return false;
+      masterKey = it->second;
+    }
+  }
+  if (!fCrypted) {
+    vMasterKey.resize(KEY_SIZE);
+    getRandBytes(vMasterKey.data(), vMasterKey.size());
+    masterKey.salt.resize(SALT_SIZE);
+    getRandBytes(masterKey.salt.data(), masterKey.salt.size());
+    masterKey.nDeriveIterations = DEFAULT_DERIVE_ITERATIONS;
+
+    Crypter crypter;
+    if (!crypter.setKeyFromPassphrase(passphrase, masterKey.salt,
+                                      masterKey.nDeriveIterations) ||
+        !crypter.encrypt(vMasterKey, masterKey.cryptedKey))
+      return false;
+  }
+
+  writeBackup(*_database, vMasterKey, masterKey, filename, stats);
+  return true;
+}
+
+bool Wallet::isEncryptionPending() {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  return _fEncryptionPending;
+}
+
+double Wallet::getEncryptionProgress() {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  if (!_fEncryptionPending)
+    return isCrypted() ? 1.0 : 0.0;
+  if (_encryptionState.nTotal == 0)
+    return 0.0;
+  return static_cast<double>(_encryptionState.nEncrypted) /
+         _encryptionState.nTotal;
+}
+
+bool Wallet::isLocked() {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  return isCrypted() && !_session.isOpen();
+}
+
+bool Wallet::lock() {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  if (!isCrypted())
+    return false;
+  _session.wipe();
+  _eventBus.notifyStatusChanged();
+  _eventBus.notifyCanGetAddressesChanged();
+  return true;
+}
+
+bool Wallet::unlock(const SecureString &wallet_passphrase) {
+  return unlock(wallet_passphrase, getRelockTimeout());
+}
+
+bool Wallet::unlock(const SecureString &wallet_passphrase,
+                    int64_t nTimeoutSeconds) {
+  if (_session.reopen(wallet_passphrase, nTimeoutSeconds))
+    return true;
+
+  {
+    const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+    bool fUnlocked = false;
+    for (auto &it : _mapMasterKeys) {
+      SecureBytes vMasterKey;
+      if (decryptMasterKey(wallet_passphrase, it.second, vMasterKey)) {
+        _session.open(vMasterKey, wallet_passphrase, nTimeoutSeconds);
+        fUnlocked = true;
+        break;
+      }
+    }
+    if (!fUnlocked)
+      return false;
+  }
+
+  continueEncryption();
+  _keyPool.requestRefill();
+  _eventBus.notifyStatusChanged();
+  _eventBus.notifyCanGetAddressesChanged();
+  return true;
+}
+
+void Wallet::setRelockTimeout(int64_t nTimeoutSeconds) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  _nRelockTimeout = nTimeoutSeconds;
+}
+
+int64_t Wallet::getRelockTimeout() {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  return _nRelockTimeout;
+}
+
+bool Wallet::addKeyPubKey(const Key &key, const PubKey &pubKey) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  KeyID address = pubKey.getID();
+  WalletBatch batch(*_database);
+
+  if (!isCrypted()) {
+    if (!batch.writeKey(pubKey, key))
+      return false;
+    _mapKeys[address] = std::make_pair(pubKey, key);
+    _keyIndex.addKey(pubKey);
+    return true;
+  }
+
+  SecureBytes vMasterKey;
+  std::vector<unsigned char> cryptedSecret;
+  if (!_session.getMasterKey(vMasterKey) ||
+      !encryptSecret(vMasterKey, key.getSecret(), hash256(pubKey.data()),
+                     cryptedSecret))
+    return false;
+  if (!batch.writeCryptedKey(pubKey, cryptedSecret))
+    return false;
+  _mapCryptedKeys[address] = std::make_pair(pubKey, cryptedSecret);
+  _keyIndex.addKey(pubKey);
+  _session.cacheKey(address, key);
+  return true;
+}
+
+bool Wallet::haveKey(const KeyID &address) {
+  return _keyIndex.haveKey(address);
+}
+
+bool Wallet::getKey(const KeyID &address, Key &key) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  auto itKey = _mapKeys.find(address);
+  if (itKey != _mapKeys.end()) {
+    key = itKey->second.second;
+    return true;
+  }
+
+  auto itCrypted = _mapCryptedKeys.find(address);
+  if (itCrypted == _mapCryptedKeys.end())
+    return false;
+  if (_session.getCachedKey(address, key))
+    return true;
+
+  SecureBytes vMasterKey;
+  SecureBytes secret;
+  if (!_session.getMasterKey(vMasterKey) ||
+      !decryptSecret(vMasterKey, itCrypted->second.second,
+                     hash256(itCrypted->second.first.data()), secret) ||
+      !key.set(secret))
+    return false;
+  _session.cacheKey(address, key);
+  return true;
+}
+
+bool Wallet::getPubKey(const Script &, const KeyID &address,
+                       PubKey &pub_key) {
+  return _keyIndex.getPubKey(address, pub_key);
+}
+
+bool Wallet::getPrivKey(const Script &, const KeyID &address, Key &key) {
+  return getKey(address, key);
+}
+
+IsMineType Wallet::isMine(const Script &script) {
+  return _keyIndex.isMine(script);
+}
+
+bool Wallet::topUpKeyPool(unsigned int nKeys) {
+  SecureBytes vMasterKey;
+  bool fCrypted = isCrypted();
+  if (fCrypted && !_session.getMasterKey(vMasterKey))
+    return false;
+
+  std::vector<std::pair<PubKey, Key>> keys(nKeys);
+  std::vector<std::vector<unsigned char>> cryptedSecrets(nKeys);
+  for (unsigned int i = 0; i < nKeys; i++) {
+    keys[i].second.makeNewKey();
+    keys[i].first = keys[i].second.getPubKey();
+    if (fCrypted && !encryptSecret(vMasterKey, keys[i].second.getSecret(),
+                                   hash256(keys[i].first.data()),
+                                   cryptedSecrets[i]))
+      return false;
+  }
+
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  if (isCrypted() != fCrypted)
+    return false;
+
+  std::vector<KeyPoolEntry> entries(nKeys);
+  int64_t nIndex = _keyPool.getMaxIndex();
+  WalletBatch batch(*_database);
+  if (!batch.TxnBegin())
+    return false;
+  bool fWritten = true;
+  for (unsigned int i = 0; i < nKeys && fWritten; i++) {
+    entries[i].nIndex = ++nIndex;
+    entries[i].nTime = getTime();
+    entries[i].pubKey = keys[i].first;
+    fWritten = (fCrypted ? batch.writeCryptedKey(keys[i].first,
+                                                 cryptedSecrets[i])
+                         : batch.writeKey(keys[i].first, keys[i].second)) &&
+               batch.writePool(entries[i]);
+  }
+  if (!fWritten) {
+    batch.TxnAbort();
+    return false;
+  }
+  if (!batch.TxnCommit())
+    return false;
+
+  for (unsigned int i = 0; i < nKeys; i++) {
+    KeyID address = keys[i].first.getID();
+    if (fCrypted)
+      _mapCryptedKeys[address] =
+          std::make_pair(keys[i].first, cryptedSecrets[i]);
+    else
+      _mapKeys[address] = keys[i];
+    _keyIndex.addKey(keys[i].first);
+    _keyPool.push(entries[i]);
+  }
+  return true;
+}
+
+bool Wallet::getNewDestination(const std::string label, KeyID &dest) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  KeyPoolEntry entry;
+  if (!_keyPool.pop(entry) && (!topUpKeyPool(1) || !_keyPool.pop(entry)))
+    return false;
+
+  KeyID address = entry.pubKey.getID();
+  WalletBatch batch(*_database);
+  if (!batch.TxnBegin())
+    return false;
+  if (!batch.erasePool(entry.nIndex) ||
+      (!label.empty() && !batch.writeName(address, label))) {
+    batch.TxnAbort();
+    _keyPool.push(entry);
+    return false;
+  }
+  if (!batch.TxnCommit()) {
+    _keyPool.push(entry);
+    return false;
+  }
+
+  if (!label.empty()) {
+    _mapAddressBook[address] = label;
+    _addressIndex.set(address, label);
+    _eventBus.notifyAddressBookChanged(address, label, true, "receive",
+                                       CT_NEW);
+  }
+  dest = address;
+  return true;
+}
+
+bool Wallet::setAddressBook(const KeyID &address, const std::string &label) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  WalletBatch batch(*_database);
+  if (!batch.writeName(address, label))
+    return false;
+
+  bool fNew = _mapAddressBook.find(address) == _mapAddressBook.end();
+  _mapAddressBook[address] = label;
+  _addressIndex.set(address, label);
+  bool fIsMine = haveKey(address);
+  _eventBus.notifyAddressBookChanged(address, label, fIsMine,
+                                     fIsMine ? "receive" : "send",
+                                     fNew ? CT_NEW : CT_UPDATED);
+  return true;
+}
+
+bool Wallet::delAddressBook(const KeyID &address) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  auto it = _mapAddressBook.find(address);
+  if (it == _mapAddressBook.end())
+    return false;
+  WalletBatch batch(*_database);
+  if (!batch.eraseName(address))
+    return false;
+
+  _mapAddressBook.erase(it);
+  _addressIndex.erase(address);
+  bool fIsMine = haveKey(address);
+  _eventBus.notifyAddressBookChanged(address, "", fIsMine,
+                                     fIsMine ? "receive" : "send", CT_DELETED);
+  return true;
+}
+
+AddressPage Wallet::searchAddressBook(const std::string &query,
+                                      bool fSubstring, size_t nOffset,
+                                      size_t nLimit) {
+  return fSubstring ? _addressIndex.findSubstring(query, nOffset, nLimit)
+                    : _addressIndex.findPrefix(query, nOffset, nLimit);
+}
+
+bool Wallet::canGetAddresses() {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  return _keyPool.size() > 0 || !isLocked();
+}
+
+KeyPoolMetrics Wallet::getKeyPoolMetrics() { return _keyPool.getMetrics(); }
+
+IsMineType Wallet::txinIsMine(const TxIn &txin) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  auto it = _mapWallet.find(txin.prevout.txid);
+  if (it == _mapWallet.end() || txin.prevout.n >= it->second.tx->vout.size())
+    return ISMINE_NO;
+  return txoutIsMine(it->second.tx->vout[txin.prevout.n]);
+}
+
+IsMineType Wallet::txoutIsMine(const TxOut &txout) {
+  return _keyIndex.isMine(txout.scriptPubKey);
+}
+
+Amount Wallet::getDebit(const TxIn &txin) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  if (txinIsMine(txin) == ISMINE_NO)
+    return 0;
+  return _mapWallet[txin.prevout.txid].tx->vout[txin.prevout.n].nValue;
+}
+
+Amount Wallet::getCredit(const TxOut &txout) {
+  return txoutIsMine(txout) == ISMINE_NO ? 0 : txout.nValue;
+}
+
+bool Wallet::isFromMe(const Transaction &tx) {
+  if (tx.vin.empty())
+    return false;
+  for (auto &txin : tx.vin) {
+    if (txinIsMine(txin) == ISMINE_NO)
+      return false;
+  }
+  return true;
+}
+
+uint8_t Wallet::getUtxoFlags(const Transaction &tx) {
+  if (tx.isCoinBase())
+    return UTXO_COINBASE;
+  return isFromMe(tx) ? UTXO_FROM_ME : 0;
+}
+
+void Wallet::applyTransaction(const uint256 &txid, const WalletTx &wtx) {
+  const Transaction &tx = *wtx.tx;
+  if (!tx.isCoinBase()) {
+    for (auto &txin : tx.vin) {
+      if (txinIsMine(txin) == ISMINE_NO)
+        continue;
+      _mapSpends[txin.prevout] = txid;
+      _utxoSet.remove(txin.prevout);
+    }
+  }
+
+  uint8_t nFlags = getUtxoFlags(tx);
+  for (uint32_t i = 0; i < tx.vout.size(); i++) {
+    OutPoint outpoint(txid, i);
+    if (txoutIsMine(tx.vout[i]) != ISMINE_NO && !_mapSpends.count(outpoint))
+      _utxoSet.add(outpoint, tx.vout[i].nValue, wtx.nHeight, nFlags);
+  }
+}
+
+void Wallet::unapplyTransaction(const uint256 &txid, const WalletTx &wtx) {
+  const Transaction &tx = *wtx.tx;
+  for (uint32_t i = 0; i < tx.vout.size(); i++)
+    _utxoSet.remove(OutPoint(txid, i));
+  if (tx.isCoinBase())
+    return;
+
+  for (auto &txin : tx.vin) {
+    auto itSpend = _mapSpends.find(txin.prevout);
+    if (itSpend == _mapSpends.end() || itSpend->second != txid)
+      continue;
+    _mapSpends.erase(itSpend);
+
+    auto itPrev = _mapWallet.find(txin.prevout.txid);
+    if (itPrev == _mapWallet.end() || itPrev->second.fAbandoned)
+      continue;
+    const TxOut &txout = itPrev->second.tx->vout[txin.prevout.n];
+    if (txoutIsMine(txout) != ISMINE_NO)
+      _utxoSet.add(txin.prevout, txout.nValue, itPrev->second.nHeight,
+                   getUtxoFlags(*itPrev->second.tx));
+  }
+}
+
+bool Wallet::addToWallet(WalletBatch &batch, const TransactionRef &tx,
+                         int32_t nHeight, bool &fAdded) {
+  uint256 txid = tx->getHash();
+  auto it = _mapWallet.find(txid);
+  fAdded = it != _mapWallet.end();
+  if (fAdded) {
+    if (nHeight >= 0 && it->second.nHeight != nHeight)
+      return confirmTransaction(batch, txid, nHeight);
+    return true;
+  }
+
+  bool fRelevant = false;
+  for (auto &txout : tx->vout)
+    fRelevant = fRelevant || txoutIsMine(txout) != ISMINE_NO;
+  if (!tx->isCoinBase()) {
+    for (auto &txin : tx->vin)
+      fRelevant = fRelevant || txinIsMine(txin) != ISMINE_NO;
+  }
+  if (!fRelevant)
+    return true;
+
+  WalletTx wtx;
+  wtx.tx = tx;
+  wtx.nHeight = nHeight;
+  wtx.nTimeReceived = getTime();
+  if (!batch.writeTx(wtx))
+    return false;
+
+  _mapWallet[txid] = wtx;
+  applyTransaction(txid, wtx);
+  _eventBus.notifyTransactionChanged(txid, CT_NEW);
+  fAdded = true;
+  return true;
+}
+
+bool Wallet::addToWallet(const TransactionRef &tx, int32_t nHeight) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  WalletBatch batch(*_database);
+  bool fAdded;
+  return addToWallet(batch, tx, nHeight, fAdded) && fAdded;
+}
+
+bool Wallet::confirmTransaction(WalletBatch &batch, const uint256 &txid,
+                                int32_t nHeight) {
+  auto it = _mapWallet.find(txid);
+  if (it == _mapWallet.end())
+    return false;
+
+  WalletTx wtx = it->second;
+  bool fWasAbandoned = wtx.fAbandoned;
+  wtx.nHeight = nHeight;
+  wtx.fAbandoned = false;
+  if (!batch.writeTx(wtx))
+    return false;
+  it->second = wtx;
+
+  if (fWasAbandoned) {
+    applyTransaction(txid, wtx);
+  } else {
+    for (uint32_t i = 0; i < wtx.tx->vout.size(); i++)
+      _utxoSet.setHeight(OutPoint(txid, i), nHeight);
+  }
+  _eventBus.notifyTransactionChanged(txid, CT_UPDATED);
+  return true;
+}
+
+// Reverts in-memory changes made by addToWallet() calls whose transaction did
+// not commit. Each entry holds a txid and its WalletTx from before the call,
+// with no tx if it was not in the wallet yet.
+void Wallet::undoAddToWallet(
+    const std::vector<std::pair<uint256, WalletTx>> &vUndo) {
+  for (auto itUndo = vUndo.rbegin(); itUndo != vUndo.rend(); ++itUndo) {
+    const uint256 &txid = itUndo->first;
+    const WalletTx &wtxPrev = itUndo->second;
+    auto it = _mapWallet.find(txid);
+    if (it == _mapWallet.end())
+      continue;
+    if (!wtxPrev.tx) {
+      unapplyTransaction(txid, it->second);
+      _mapWallet.erase(it);
+      _eventBus.notifyTransactionChanged(txid, CT_DELETED);
+      continue;
+    }
+    if (it->second.nHeight == wtxPrev.nHeight &&
+        it->second.fAbandoned == wtxPrev.fAbandoned)
+      continue;
+    if (wtxPrev.fAbandoned) {
+      unapplyTransaction(txid, it->second);
+    } else {
+      for (uint32_t i = 0; i < wtxPrev.tx->vout.size(); i++)
+        _utxoSet.setHeight(OutPoint(txid, i), wtxPrev.nHeight);
+    }
+    it->second = wtxPrev;
+    _eventBus.notifyTransactionChanged(txid, CT_UPDATED);
+  }
+}
+
+bool Wallet::confirmTransaction(const uint256 &txid, int32_t nHeight) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  WalletBatch batch(*_database);
+  return confirmTransaction(batch, txid, nHeight);
+}
+
+bool Wallet::transactionCanBeAbandoned(const uint256 &txid) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  auto it = _mapWallet.find(txid);
+  return it != _mapWallet.end() && it->second.nHeight < 0 &&
+         !it->second.fAbandoned && !it->second.tx->isCoinBase();
+}
+
+bool Wallet::abandonTransaction(const uint256 &txid) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  if (!transactionCanBeAbandoned(txid))
+    return false;
+
+  std::vector<uint256> todo{txid};
+  std::vector<uint256> abandoned;
+  WalletBatch batch(*_database);
+  if (!batch.TxnBegin())
+    return false;
+  while (!todo.empty()) {
+    uint256 id = todo.back();
+    todo.pop_back();
+    WalletTx &wtx = _mapWallet[id];
+    if (wtx.fAbandoned || wtx.nHeight >= 0)
+      continue;
+    if (std::find(abandoned.begin(), abandoned.end(), id) != abandoned.end())
+      continue;
+
+    WalletTx abandonedTx = wtx;
+    abandonedTx.fAbandoned = true;
+    if (!batch.writeTx(abandonedTx)) {
+      batch.TxnAbort();
+      return false;
+    }
+    abandoned.push_back(id);
+    for (uint32_t i = 0; i < wtx.tx->vout.size(); i++) {
+      auto itSpend = _mapSpends.find(OutPoint(id, i));
+      if (itSpend != _mapSpends.end())
+        todo.push_back(itSpend->second);
+    }
+  }
+  if (!batch.TxnCommit())
+    return false;
+
+  for (auto &id : abandoned)
+    _mapWallet[id].fAbandoned = true;
+  for (auto it = abandoned.rbegin(); it != abandoned.rend(); ++it) {
+    unapplyTransaction(*it, _mapWallet[*it]);
+    _eventBus.notifyTransactionChanged(*it, CT_UPDATED);
+  }
+  return true;
+}
+
+TransactionRef Wallet::getTx(const uint256 &txid) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  auto it = _mapWallet.find(txid);
+  if (it == _mapWallet.end())
+    return TransactionRef();
+  return it->second.tx;
+}
+
+bool Wallet::setChainTip(int32_t nHeight) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  if (nHeight == _utxoSet.getTipHeight())
+    return true;
+  WalletBatch batch(*_database);
+  if (!batch.writeBestHeight(nHeight))
+    return false;
+  _utxoSet.setTipHeight(nHeight);
+  return true;
+}
+
+int32_t Wallet::getChainTip() {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  return _utxoSet.getTipHeight();
+}
+
+bool Wallet::rescanBlockFiles(const QDir &blocksDir, int32_t nStartHeight,
+                              RescanResult &result,
+                              const RescanProgressFn &progress) {
+  bool fExpected = false;
+  if (!_fScanning.compare_exchange_strong(fExpected, true))
+    return false;
+  _fAbortRescan = false;
+  _dScanProgress = 0;
+  _eventBus.notifyShowProgress("Rescanning...", 0);
+  bool fSuccess;
+  try {
+    fSuccess = scanBlockFiles(blocksDir, nStartHeight, result, progress);
+  } catch (...) {
+    _fScanning = false;
+    _eventBus.notifyShowProgress("Rescanning...", 100);
+    throw;
+  }
+  _fScanning = false;
+  _eventBus.notifyShowProgress("Rescanning...", 100);
+  return fSuccess;
+}
+
+bool Wallet::scanBlockFiles(const QDir &blocksDir, int32_t nStartHeight,
+                            RescanResult &result,
+                            const RescanProgressFn &progress) {
+  BlockFileReader reader(blocksDir);
+  const int32_t nTipHeight = static_cast<int32_t>(reader.size()) - 1;
+  std::unordered_set<uint256, ArrayHasher> setWalletTxids;
+  {
+    const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+    if (nStartHeight < 0)
+      nStartHeight = _nRescanHeight + 1;
+    setWalletTxids.reserve(_mapWallet.size());
+    for (auto &it : _mapWallet)
+      setWalletTxids.insert(it.first);
+  }
+  result = RescanResult();
+  result.nStartHeight = nStartHeight;
+  result.nStopHeight = nStartHeight - 1;
+
+  // Matching needs no wallet lock: outputs are checked against the key index
+  // and inputs against the txids known before the batch plus the batch's own
+  // matches. Candidates are then committed in chain order, where
+  // addToWallet() makes the final relevance decision.
+  for (int32_t nBatchStart = nStartHeight; nBatchStart <= nTipHeight;
+       nBatchStart += RESCAN_BATCH_BLOCKS) {
+    const size_t nBlocks = std::min<size_t>(RESCAN_BATCH_BLOCKS,
+                                            nTipHeight - nBatchStart + 1);
+    std::vector<std::vector<TransactionRef>> vBlocks(nBlocks);
+    std::vector<std::vector<uint256>> vTxids(nBlocks);
+    std::vector<std::vector<uint8_t>> vMatches(nBlocks);
+    std::atomic<bool> fReadError(false);
+    _pool.parallelForEach(nBlocks, [&](size_t i) {
+      if (_fAbortRescan)
+        return;
+      if (!reader.readBlock(nBatchStart + i, vBlocks[i])) {
+        fReadError = true;
+        return;
+      }
+      vTxids[i].resize(vBlocks[i].size());
+      vMatches[i].assign(vBlocks[i].size(), 0);
+      for (size_t j = 0; j < vBlocks[i].size(); j++) {
+        vTxids[i][j] = vBlocks[i][j]->getHash();
+        for (auto &txout : vBlocks[i][j]->vout) {
+          if (_keyIndex.isMine(txout.scriptPubKey) != ISMINE_NO) {
+            vMatches[i][j] = 1;
+            break;
+          }
+        }
+      }
+    });
+    if (_fAbortRescan) {
+      result.fAborted = true;
+      break;
+    }
+    if (fReadError)
+      return false;
+
+    std::unordered_set<uint256, ArrayHasher> setBatchTxids;
+    for (size_t i = 0; i < nBlocks; i++) {
+      for (size_t j = 0; j < vTxids[i].size(); j++) {
+        if (vMatches[i][j])
+          setBatchTxids.insert(vTxids[i][j]);
+      }
+    }
+    _pool.parallelForEach(nBlocks, [&](size_t i) {
+      for (size_t j = 0; j < vBlocks[i].size(); j++) {
+        if (vMatches[i][j] || vBlocks[i][j]->isCoinBase())
+          continue;
+        for (auto &txin : vBlocks[i][j]->vin) {
+          if (setWalletTxids.count(txin.prevout.txid) ||
+              setBatchTxids.count(txin.prevout.txid)) {
+            vMatches[i][j] = 1;
+            break;
+          }
+        }
+      }
+    });
+
+    const int32_t nBatchStop = nBatchStart + static_cast<int32_t>(nBlocks) - 1;
+    {
+      const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+      WalletBatch batch(*_database);
+      if (!batch.TxnBegin())
+        return false;
+      // Later matches in the batch may spend earlier ones, so the wallet is
+      // updated as it goes and rolled back if the batch does not commit.
+      std::vector<std::pair<uint256, WalletTx>> vUndo;
+      size_t nAdded = 0;
+      bool fWritten = true;
+      for (size_t i = 0; i < nBlocks && fWritten; i++) {
+        for (size_t j = 0; j < vBlocks[i].size() && fWritten; j++) {
+          if (!vMatches[i][j])
+            continue;
+          auto it = _mapWallet.find(vTxids[i][j]);
+          vUndo.emplace_back(vTxids[i][j], it != _mapWallet.end()
+                                               ? it->second
+                                               : WalletTx());
+          bool fAdded;
+          fWritten = addToWallet(batch, vBlocks[i][j], nBatchStart + i, fAdded);
+          if (fAdded && !setWalletTxids.count(vTxids[i][j]))
+            nAdded++;
+        }
+      }
+      if (!fWritten || !batch.writeRescanHeight(nBatchStop)) {
+        batch.TxnAbort();
+        undoAddToWallet(vUndo);
+        return false;
+      }
+      if (!batch.TxnCommit()) {
+        undoAddToWallet(vUndo);
+        return false;
+      }
+      for (auto &undo : vUndo) {
+        if (_mapWallet.count(undo.first))
+          setWalletTxids.insert(undo.first);
+      }
+      result.nTransactions += nAdded;
+      _nRescanHeight = nBatchStop;
+    }
+
+    result.nStopHeight = nBatchStop;
+    _dScanProgress = static_cast<double>(nBatchStop - nStartHeight + 1) /
+                     (nTipHeight - nStartHeight + 1);
+    _eventBus.notifyShowProgress("Rescanning...",
+                                 static_cast<int>(_dScanProgress * 100));
+    if (progress)
+      progress(nBatchStop, _dScanProgress);
+  }
+
+  if (!result.fAborted && nTipHeight > getChainTip() &&
+      !setChainTip(nTipHeight))
+    return false;
+  return true;
+}
+
+void Wallet::abortRescan() {
+  if (_fScanning)
+    _fAbortRescan = true;
+}
+
+bool Wallet::isScanning() { return _fScanning; }
+
+double Wallet::getScanProgress() { return _dScanProgress; }
+
+int32_t Wallet::getRescanHeight() {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  return _nRescanHeight;
+}
+
+WalletBalances Wallet::getBalances() {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  return _utxoSet.getBalances();
+}
+
+bool Wallet::tryGetBalances(WalletBalances &balances, int &num_blocks) {
+  std::unique_lock<std::recursive_mutex> lock(mutexWallet, std::try_to_lock);
+  if (!lock.owns_lock())
+    return false;
+  balances = _utxoSet.getBalances();
+  num_blocks = _utxoSet.getTipHeight();
+  return true;
+}
+
+Amount Wallet::getBalance() { return getBalances().balance; }
+
+void Wallet::lockCoin(const OutPoint &output) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  _utxoSet.setFlag(output, UTXO_LOCKED, true);
+}
+
+void Wallet::unlockCoin(const OutPoint &output) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  _utxoSet.setFlag(output, UTXO_LOCKED, false);
+}
+
+bool Wallet::isLockedCoin(const OutPoint &output) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  Amount nValue;
+  int32_t nHeight;
+  uint8_t nFlags;
+  return _utxoSet.get(output, nValue, nHeight, nFlags) &&
+         (nFlags & UTXO_LOCKED);
+}
+
+void Wallet::listLockedCoins(std::vector<OutPoint> &outputs) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  const std::vector<uint8_t> &vFlags = _utxoSet.getFlags();
+  outputs.clear();
+  for (size_t i = 0; i < vFlags.size(); i++) {
+    if (vFlags[i] & UTXO_LOCKED)
+      outputs.push_back(_utxoSet.getOutPoints()[i]);
+  }
+}
+
+Amount Wallet::getAvailableBalance(const CoinControl &coin_control) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  if (!coin_control.hasSelected() || coin_control.fAllowOtherInputs)
+    return _utxoSet.sumSpendable(coin_control.nMinDepth);
+
+  std::vector<OutPoint> outputs;
+  coin_control.listSelected(outputs);
+  Amount nTotal = 0;
+  for (auto &output : outputs) {
+    Amount nValue;
+    int32_t nHeight;
+    uint8_t nFlags;
+    if (_utxoSet.get(output, nValue, nHeight, nFlags))
+      nTotal += nValue;
+  }
+  return nTotal;
+}
+
+bool Wallet::getKeys(const std::vector<KeyID> &addresses,
+                     std::unordered_map<KeyID, Key, ArrayHasher> &keys) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  std::vector<decltype(_mapCryptedKeys)::iterator> vMissing;
+  for (auto &address : addresses) {
+    if (keys.count(address))
+      continue;
+    auto itKey = _mapKeys.find(address);
+    if (itKey != _mapKeys.end()) {
+      keys[address] = itKey->second.second;
+      continue;
+    }
+    auto itCrypted = _mapCryptedKeys.find(address);
+    if (itCrypted == _mapCryptedKeys.end())
+      return false;
+    Key key;
+    if (_session.getCachedKey(address, key)) {
+      keys[address] = key;
+      continue;
+    }
+    keys[address] = Key();
+    vMissing.push_back(itCrypted);
+  }
+  if (vMissing.empty())
+    return true;
+
+  // The master key is fetched once and every worker keeps a single Crypter
+  // keyed with it, changing only the per-key IV between decryptions.
+  SecureBytes vMasterKey;
+  if (!_session.getMasterKey(vMasterKey))
+    return false;
+  std::vector<Key> vDecrypted(vMissing.size());
+  std::atomic<bool> fFailed(false);
+  _pool.parallelFor(vMissing.size(), [&](size_t begin, size_t end) {
+    Crypter crypter;
+    if (!crypter.setKey(vMasterKey, SecureBytes(IV_SIZE))) {
+      fFailed = true;
+      return;
+    }
+    for (size_t i = begin; i < end && !fFailed; i++) {
+      const PubKey &pubKey = vMissing[i]->second.first;
+      uint256 ivSeed = hash256(pubKey.data());
+      SecureBytes secret;
+      if (!crypter.setIV(
+              SecureBytes(ivSeed.begin(), ivSeed.begin() + IV_SIZE)) ||
+          !crypter.decrypt(vMissing[i]->second.second, secret) ||
+          !vDecrypted[i].set(secret))
+        fFailed = true;
+    }
+  });
+  if (fFailed)
+    return false;
+
+  for (size_t i = 0; i < vMissing.size(); i++) {
+    keys[vMissing[i]->first] = vDecrypted[i];
+    _session.cacheKey(vMissing[i]->first, vDecrypted[i]);
+  }
+  return true;
+}
+
+bool Wallet::signInputs(std::vector<SigningJob> &jobs, int nHashType) {
+  if (jobs.empty())
+    return true;
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<KeyID> addresses;
+  addresses.reserve(jobs.size());
+  for (auto &job : jobs)
+    addresses.push_back(job.address);
+  std::unordered_map<KeyID, Key, ArrayHasher> keys;
+  if (!getKeys(addresses, keys))
+    return false;
+
+  // Inputs are independent once their prevouts and keys are resolved, so
+  // sighashes and signatures are computed without holding the wallet lock.
+  std::atomic<bool> fFailed(false);
+  auto signJob = [&](size_t i) {
+    SigningJob &job = jobs[i];
+    if (!produceSignature(keys.at(job.address), *job.pTx, job.nIn,
+                          job.utxo.scriptPubKey, job.utxo.nValue, nHashType,
+                          job.pCache, job.sigdata))
+      fFailed = true;
+  };
+  if (jobs.size() == 1) {
+    signJob(0);
+  } else {
+    _pool.parallelForEach(jobs.size(), signJob);
+  }
+  if (fFailed)
+    return false;
+
+  uint64_t nMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  _nSignatures += jobs.size();
+  _nSigningBatches++;
+  _nLastBatchSignatures = jobs.size();
+  _nLastBatchMicros = nMicros;
+  _nSigningMicros += nMicros;
+  return true;
+}
+
+bool Wallet::signTransaction(Transaction &tx) {
+  PrecomputedTransactionData cache(tx);
+  std::vector<SigningJob> jobs(tx.vin.size());
+  {
+    const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+      auto it = _mapWallet.find(tx.vin[i].prevout.txid);
+      if (it == _mapWallet.end() ||
+          tx.vin[i].prevout.n >= it->second.tx->vout.size())
+        return false;
+      PubKey pubKey;
+      jobs[i].pTx = &tx;
+      jobs[i].pCache = &cache;
+      jobs[i].nIn = i;
+      jobs[i].utxo = it->second.tx->vout[tx.vin[i].prevout.n];
+      if (!_keyIndex.getPubKey(jobs[i].utxo.scriptPubKey, pubKey))
+        return false;
+      jobs[i].address = pubKey.getID();
+    }
+  }
+  if (!signInputs(jobs, SIGHASH_ALL))
+    return false;
+
+  for (auto &job : jobs) {
+    tx.vin[job.nIn].scriptSig = job.sigdata.scriptSig;
+    tx.vin[job.nIn].witness = job.sigdata.witness;
+  }
+  return true;
+}
+
+bool Wallet::signBumpTransaction(Transaction &tx) {
+  return signTransaction(tx);
+}
+
+bool Wallet::fillPSBT(PartiallySignedTransaction &psbtx, bool &complete,
+                      int sighash_type, bool sign) {
+  std::vector<PartiallySignedTransaction> psbtxs{std::move(psbtx)};
+  std::vector<bool> vComplete;
+  bool fSuccess = fillPSBTs(psbtxs, vComplete, sighash_type, sign);
+  psbtx = std::move(psbtxs[0]);
+  complete = fSuccess && vComplete[0];
+  return fSuccess;
+}
+
+bool Wallet::fillPSBTs(std::vector<PartiallySignedTransaction> &psbtxs,
+                       std::vector<bool> &complete, int sighash_type,
+                       bool sign) {
+  complete.assign(psbtxs.size(), false);
+  if (sighash_type != SIGHASH_ALL)
+    return false;
+
+  std::vector<PrecomputedTransactionData> caches(psbtxs.size());
+  std::vector<SigningJob> jobs;
+  std::vector<std::pair<size_t, size_t>> vJobInputs;
+  {
+    const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+    for (size_t p = 0; p < psbtxs.size(); p++) {
+      PartiallySignedTransaction &psbtx = psbtxs[p];
+      if (psbtx.inputs.size() != psbtx.tx.vin.size())
+        return false;
+      for (size_t i = 0; i < psbtx.inputs.size(); i++) {
+        PSBTInput &input = psbtx.inputs[i];
+        const OutPoint &prevout = psbtx.tx.vin[i].prevout;
+        if (input.isFinalized())
+          continue;
+
+        auto it = _mapWallet.find(prevout.txid);
+        if (it != _mapWallet.end() && prevout.n < it->second.tx->vout.size()) {
+          const TxOut &txout = it->second.tx->vout[prevout.n];
+          KeyID address;
+          if (extractKeyID(txout.scriptPubKey, address) &&
+              txout.scriptPubKey == getScriptForPubKeyHash(address))
+            input.nonWitnessUtxo = it->second.tx;
+          else
+            input.witnessUtxo = txout;
+        }
+
+        TxOut utxo;
+        PubKey pubKey;
+        if (!sign || !input.getUtxo(prevout, utxo) ||
+            !_keyIndex.getPubKey(utxo.scriptPubKey, pubKey))
+          continue;
+        if (input.nSighashType > 0 && input.nSighashType != sighash_type)
+          return false;
+        if (!caches[p].fReady)
+          caches[p] = PrecomputedTransactionData(psbtx.tx);
+
+        SigningJob job;
+        job.pTx = &psbtx.tx;
+        job.pCache = &caches[p];
+        job.nIn = i;
+        job.utxo = utxo;
+        job.address = pubKey.getID();
+        jobs.push_back(std::move(job));
+        vJobInputs.emplace_back(p, i);
+      }
+    }
+  }
+  if (!signInputs(jobs, sighash_type))
+    return false;
+
+  for (size_t j = 0; j < jobs.size(); j++) {
+    PSBTInput &input =
+        psbtxs[vJobInputs[j].first].inputs[vJobInputs[j].second];
+    input.partialSigs[jobs[j].sigdata.pubKey.data()] =
+        jobs[j].sigdata.signature;
+    input.nSighashType = sighash_type;
+  }
+  for (size_t p = 0; p < psbtxs.size(); p++) {
+    PartiallySignedTransaction &psbtx = psbtxs[p];
+    for (size_t i = 0; i < psbtx.inputs.size(); i++) {
+      TxOut utxo;
+      if (!psbtx.inputs[i].isFinalized() &&
+          psbtx.inputs[i].getUtxo(psbtx.tx.vin[i].prevout, utxo))
+        psbtx.inputs[i].finalize(utxo.scriptPubKey);
+    }
+    complete[p] = psbtx.isComplete();
+  }
+  return true;
+}
+
+SigningMetrics Wallet::getSigningMetrics() {
+  SigningMetrics metrics;
+  metrics.nSignatures = _nSignatures;
+  metrics.nBatches = _nSigningBatches;
+  metrics.nLastBatchSignatures = _nLastBatchSignatures;
+  metrics.nLastBatchMicros = _nLastBatchMicros;
+  metrics.nTotalMicros = _nSigningMicros;
+  return metrics;
+}
+
+TransactionRef Wallet::createTransaction(
+    const std::vector<Recipient> &recipients, const CoinControl &coin_control,
+    bool sign, int &change_pos, Amount &fee, std::string &fail_reason) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  if (recipients.empty()) {
+    fail_reason = "Transaction must have at least one recipient";
+    return TransactionRef();
+  }
+
+  Transaction tx;
+  Amount nValue = 0;
+  size_t nVSize = TX_OVERHEAD_VSIZE;
+  for (auto &recipient : recipients) {
+    if (recipient.nAmount < DUST_THRESHOLD) {
+      fail_reason = "Transaction amount too small";
+      return TransactionRef();
+    }
+    nValue += recipient.nAmount;
+    if (recipient.nAmount > MAX_MONEY || nValue > MAX_MONEY) {
+      fail_reason = "Transaction amounts out of range";
+      return TransactionRef();
+    }
+    TxOut txout;
+    txout.nValue = recipient.nAmount;
+    txout.scriptPubKey = recipient.scriptPubKey;
+    nVSize += getOutputVSize(txout);
+    tx.vout.push_back(txout);
+  }
+  if (change_pos > static_cast<int>(tx.vout.size())) {
+    fail_reason = "Change index out of range";
+    return TransactionRef();
+  }
+
+  CoinSelectionParams params;
+  if (coin_control.nFeeRate > 0)
+    params.nFeeRate = coin_control.nFeeRate;
+  params.nMaxMicros = coin_control.nMaxSelectionMicros;
+  // Coins come from wallet transactions, so each input is sized by the
+  // scriptPubKey it spends.
+  auto getCoinInputVSize = [&](const OutPoint &output) {
+    auto it = _mapWallet.find(output.txid);
+    return it != _mapWallet.end()
+               ? getInputVSize(it->second.tx->vout[output.n].scriptPubKey)
+               : P2PKH_INPUT_VSIZE;
+  };
+  const Amount nTarget = nValue + getFee(params.nFeeRate, nVSize);
+
+  std::vector<OutPoint> vInputs;
+  coin_control.listSelected(vInputs);
+  Amount nInputValue = 0, nEffectiveValue = 0;
+  bool fChangeless = false;
+  for (auto &output : vInputs) {
+    Amount nCoinValue;
+    int32_t nHeight;
+    uint8_t nFlags;
+    if (!_utxoSet.get(output, nCoinValue, nHeight, nFlags) ||
+        !_utxoSet.isSpendable(output, coin_control.nMinDepth)) {
+      fail_reason = "Selected coin is not spendable";
+      return TransactionRef();
+    }
+    nInputValue += nCoinValue;
+    nEffectiveValue +=
+        nCoinValue - params.getInputFee(getCoinInputVSize(output));
+  }
+
+  if (vInputs.empty() || nEffectiveValue < nTarget) {
+    if (!vInputs.empty() && !coin_control.fAllowOtherInputs) {
+      fail_reason = "Insufficient funds";
+      return TransactionRef();
+    }
+
+    std::vector<uint32_t> vPositions;
+    _utxoSet.getSpendable(coin_control.nMinDepth, vPositions);
+    if (coin_control.hasSelected()) {
+      const std::vector<OutPoint> &vOutPoints = _utxoSet.getOutPoints();
+      vPositions.erase(std::remove_if(vPositions.begin(), vPositions.end(),
+                                      [&](uint32_t nPos) {
+                                        return coin_control.isSelected(
+                                            vOutPoints[nPos]);
+                                      }),
+                       vPositions.end());
+    }
+    std::vector<Amount> vValues(vPositions.size());
+    std::vector<size_t> vInputVSizes(vPositions.size());
+    for (size_t i = 0; i < vPositions.size(); i++) {
+      vValues[i] = _utxoSet.getAmounts()[vPositions[i]];
+      vInputVSizes[i] =
+          getCoinInputVSize(_utxoSet.getOutPoints()[vPositions[i]]);
+    }
+
+    CoinSelector selector(params);
+    SelectionResult result;
+    selector.reset(vValues.data(), vInputVSizes.data(), vValues.size());
+    if (!selector.select(nTarget - nEffectiveValue, result)) {
+      fail_reason = "Insufficient funds";
+      return TransactionRef();
+    }
+    for (uint32_t nIndex : result.vSelected)
+      vInputs.push_back(_utxoSet.getOutPoints()[vPositions[nIndex]]);
+    nInputValue += result.nSelectedValue;
+    nEffectiveValue += result.nSelectedEffectiveValue;
+    fChangeless = result.algorithm == SelectionAlgorithm::BNB;
+  }
+
+  Amount nChange = nEffectiveValue - nTarget - params.getChangeOutputFee();
+  if (!fChangeless && nChange >= DUST_THRESHOLD) {
+    KeyID changeDest = coin_control.destChange;
+    if (!coin_control.fHaveDestChange && !getNewDestination("", changeDest)) {
+      fail_reason = "Keypool ran out, please call keypoolrefill first";
+      return TransactionRef();
+    }
+    TxOut change;
+    change.nValue = nChange;
+    change.scriptPubKey = getScriptForWitnessPubKeyHash(changeDest);
+    if (change_pos < 0)
+      change_pos = static_cast<int>(tx.vout.size());
+    tx.vout.insert(tx.vout.begin() + change_pos, change);
+  } else {
+    change_pos = -1;
+  }
+
+  for (auto &output : vInputs) {
+    TxIn txin;
+    txin.prevout = output;
+    tx.vin.push_back(txin);
+  }
+  fee = nInputValue - tx.getValueOut();
+
+  if (sign && !signTransaction(tx)) {
+    fail_reason = "Signing transaction failed";
+    return TransactionRef();
+  }
+  return std::make_shared<const Transaction>(std::move(tx));
+}
+
+WalletEventBus &Wallet::getEventBus() { return _eventBus; }
+
+std::unique_ptr<Handler> Wallet::handleWalletChanged(WalletChangedFn fn,
+                                                     WakeupFn wakeup) {
+  return _eventBus.subscribe(std::move(fn), std::move(wakeup));
+}
+
+std::unique_ptr<Handler>
+Wallet::handleTransactionChanged(TransactionChangedFn fn) {
+  return _eventBus.subscribe([fn](const WalletDelta &delta) {
+    for (auto &change : delta.transactions)
+      fn(change.txid, change.status);
+  });
+}
+
+std::unique_ptr<Handler>
+Wallet::handleAddressBookChanged(AddressBookChangedFn fn) {
+  return _eventBus.subscribe([fn](const WalletDelta &delta) {
+    for (auto &change : delta.addressBook)
+      fn(change.address, change.label, change.fIsMine, change.purpose,
+         change.status);
+  });
+}
+
+std::unique_ptr<Handler> Wallet::handleStatusChanged(StatusChangedFn fn) {
+  return _eventBus.subscribe([fn](const WalletDelta &delta) {
+    if (delta.fStatusChanged)
+      fn();
+  });
+}
+
+std::unique_ptr<Handler> Wallet::handleShowProgress(ShowProgressFn fn) {
+  return _eventBus.subscribe([fn](const WalletDelta &delta) {
+    if (delta.fProgressChanged)
+      fn(delta.progressTitle, delta.nProgress);
+  });
+}
+
+std::unique_ptr<Handler>
+Wallet::handleCanGetAddressesChanged(CanGetAddressesChangedFn fn) {
+  return _eventBus.subscribe([fn](const WalletDelta &delta) {
+    if (delta.fCanGetAddressesChanged)
+      fn();
+  });
+}
+
+void Wallet::loadKey(const PubKey &pubKey, const Key &key) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  _mapKeys[pubKey.getID()] = std::make_pair(pubKey, key);
+}
+
+void Wallet::loadCryptedKey(const PubKey &pubKey,
+                            const std::vector<unsigned char> &cryptedSecret) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  _mapCryptedKeys[pubKey.getID()] = std::make_pair(pubKey, cryptedSecret);
+}
+
+void Wallet::loadMasterKey(unsigned int nId, const MasterKey &masterKey) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  _mapMasterKeys[nId] = masterKey;
+  _nMasterKeyMaxId = std::max(_nMasterKeyMaxId, nId);
+}
+
+void Wallet::loadEncryptionState(const EncryptionState &state) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  _encryptionState = state;
+  _fEncryptionPending = true;
+}
+
+void Wallet::loadKeyPoolEntry(const KeyPoolEntry &entry) {
+  _keyPool.push(entry);
+}
+
+void Wallet::loadName(const KeyID &address, const std::string &name) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  _mapAddressBook[address] = name;
+}
+
+void Wallet::loadTx(const WalletTx &wtx) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  _mapWallet[wtx.tx->getHash()] = wtx;
+}
+
+void Wallet::loadBestHeight(int32_t nHeight) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  _utxoSet.setTipHeight(nHeight);
+}
+
+void Wallet::loadRescanHeight(int32_t nHeight) {
+  const std::lock_guard<std::recursive_mutex> lock(mutexWallet);
+  _nRescanHeight = nHeight;
+}
@@ -1,20 +1,236 @@
 #ifndef WALLET_H
 #define WALLET_H
 
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "addressindex.h"
+#include "backup.h"
+#include "berkeley_db.h"
+#include "coincontrol.h"
+#include "coinselection.h"
+#include "crypter.h"
+#include "eventbus.h"
+#include "key.h"
+#include "keyindex.h"
+#include "keypool.h"
+#include "keysession.h"
+#include "psbt.h"
+#include "script.h"
 #include "sec_block.h"
+#include "sign.h"
+#include "threadpool.h"
+#include "transaction.h"
+#include "utxoset.h"
+#include "verifier.h"
+#include "walletdb.h"
+
+static const unsigned int ENCRYPTION_CHUNK_SIZE = 1000;
+
+static const size_t RESCAN_BATCH_BLOCKS = 256;
+
+struct RescanResult {
+  int32_t nStartHeight = -1;
+  int32_t nStopHeight = -1;
+  size_t nTransactions = 0;
+  bool fAborted = false;
+};
+
+typedef std::function<void(int32_t nHeight, double dProgress)>
+    RescanProgressFn;
+
+struct Recipient {
+  Script scriptPubKey;
+  Amount nAmount;
+};
+
+struct SigningJob {
+  const Transaction *pTx;
+  const PrecomputedTransactionData *pCache;
+  unsigned int nIn;
+  TxOut utxo;
+  KeyID address;
+  SignatureData sigdata;
+};
+
+struct SigningMetrics {
+  uint64_t nSignatures;
+  uint64_t nBatches;
+  uint64_t nLastBatchSignatures;
+  uint64_t nLastBatchMicros;
+  uint64_t nTotalMicros;
+};
 
 class Wallet {
+private:
+  std::unique_ptr<WalletDatabase> _database;
+  RecordVerifier _verifier;
+  ThreadPool _pool;
+
+  std::map<KeyID, std::pair<PubKey, Key>> _mapKeys;
+  std::map<KeyID, std::pair<PubKey, std::vector<unsigned char>>>
+      _mapCryptedKeys;
+  KeyIndex _keyIndex;
+  std::map<unsigned int, MasterKey> _mapMasterKeys;
+  unsigned int _nMasterKeyMaxId;
+  KeySession _session;
+  int64_t _nRelockTimeout;
+  bool _fEncryptionPending;
+  EncryptionState _encryptionState;
+  std::map<KeyID, std::string> _mapAddressBook;
+  AddressIndex _addressIndex;
+  KeyPool _keyPool;
+  std::map<uint256, WalletTx> _mapWallet;
+  std::unordered_map<OutPoint, uint256, OutPointHasher> _mapSpends;
+  UtxoSet _utxoSet;
+  int32_t _nRescanHeight;
+  std::atomic<bool> _fScanning;
+  std::atomic<bool> _fAbortRescan;
+  std::atomic<double> _dScanProgress;
+  std::atomic<uint64_t> _nSignatures;
+  std::atomic<uint64_t> _nSigningBatches;
+  std::atomic<uint64_t> _nLastBatchSignatures;
+  std::atomic<uint64_t> _nLastBatchMicros;
+  std::atomic<uint64_t> _nSigningMicros;
+  WalletEventBus _eventBus;
+
+  bool decryptMasterKey(const SecureString &wallet_passphrase,
+                        const MasterKey &masterKey, SecureBytes &vMasterKey);
+  bool checkMasterKey(const SecureBytes &vMasterKey);
+  bool continueEncryption();
+  bool topUpKeyPool(unsigned int nKeys);
+  bool isFromMe(const Transaction &tx);
+  uint8_t getUtxoFlags(const Transaction &tx);
+  void applyTransaction(const uint256 &txid, const WalletTx &wtx);
+  void unapplyTransaction(const uint256 &txid, const WalletTx &wtx);
+  bool addToWallet(WalletBatch &batch, const TransactionRef &tx,
+                   int32_t nHeight, bool &fAdded);
+  bool confirmTransaction(WalletBatch &batch, const uint256 &txid,
+                          int32_t nHeight);
+  void undoAddToWallet(
+      const std::vector<std::pair<uint256, WalletTx>> &vUndo);
+  bool scanBlockFiles(const QDir &blocksDir, int32_t nStartHeight,
+                      RescanResult &result, const RescanProgressFn &progress);
+  bool getKeys(const std::vector<KeyID> &addresses,
+               std::unordered_map<KeyID, Key, ArrayHasher> &keys);
+  bool signInputs(std::vector<SigningJob> &jobs, int nHashType);
+
 public:
-  explicit Wallet();
+  std::recursive_mutex mutexWallet;
+
+  explicit Wallet(const std::shared_ptr<BerkeleyEnvironment> &env,
+                  const std::string &filename);
+  explicit Wallet(std::unique_ptr<WalletDatabase> database);
+  ~Wallet();
+
+  Wallet(const Wallet &) = delete;
+  Wallet &operator=(const Wallet &) = delete;
+
+  std::string getWalletName();
+  WalletDatabase &getDatabase();
+  RecordVerifier &getVerifier();
 
   bool isCrypted();
   bool encryptWallet(const SecureString &wallet_passphrase);
   bool changeWalletPassphrase(const SecureString &old_wallet_passphrase,
                               const SecureString &new_wallet_passphrase);
+  bool backupWallet(const std::string &filename,
+                    const SecureString &passphrase, BackupStats &stats);
+  bool isEncryptionPending();
+  double getEncryptionProgress();
 
   bool isLocked();
   bool lock();
   bool unlock(const SecureString &wallet_passphrase);
+  bool unlock(const SecureString &wallet_passphrase, int64_t nTimeoutSeconds);
+  void setRelockTimeout(int64_t nTimeoutSeconds);
+  int64_t getRelockTimeout();
+
+  bool addKeyPubKey(const Key &key, const PubKey &pubKey);
+  bool haveKey(const KeyID &address);
+  bool getKey(const KeyID &address, Key &key);
+  bool getPubKey(const Script &script, const KeyID &address,
+                 PubKey &pub_key);
+  bool getPrivKey(const Script &script, const KeyID &address, Key &key);
+  IsMineType isMine(const Script &script);
+
+  bool getNewDestination(const std::string label, KeyID &dest);
+  bool setAddressBook(const KeyID &address, const std::string &label);
+  bool delAddressBook(const KeyID &address);
+  AddressPage searchAddressBook(const std::string &query, bool fSubstring,
+                                size_t nOffset, size_t nLimit);
+  bool canGetAddresses();
+  KeyPoolMetrics getKeyPoolMetrics();
+
+  bool addToWallet(const TransactionRef &tx, int32_t nHeight = -1);
+  bool confirmTransaction(const uint256 &txid, int32_t nHeight);
+  bool transactionCanBeAbandoned(const uint256 &txid);
+  bool abandonTransaction(const uint256 &txid);
+  TransactionRef getTx(const uint256 &txid);
+  bool setChainTip(int32_t nHeight);
+  int32_t getChainTip();
+
+  bool rescanBlockFiles(const QDir &blocksDir, int32_t nStartHeight,
+                        RescanResult &result,
+                        const RescanProgressFn &progress = RescanProgressFn());
+  void abortRescan();
+  bool isScanning();
+  double getScanProgress();
+  int32_t getRescanHeight();
+
+  WalletBalances getBalances();
+  bool tryGetBalances(WalletBalances &balances, int &num_blocks);
+  Amount getBalance();
+  IsMineType txinIsMine(const TxIn &txin);
+  IsMineType txoutIsMine(const TxOut &txout);
+  Amount getDebit(const TxIn &txin);
+  Amount getCredit(const TxOut &txout);
+
+  void lockCoin(const OutPoint &output);
+  void unlockCoin(const OutPoint &output);
+  bool isLockedCoin(const OutPoint &output);
+  void listLockedCoins(std::vector<OutPoint> &outputs);
+  Amount getAvailableBalance(const CoinControl &coin_control);
+  bool signTransaction(Transaction &tx);
+  bool signBumpTransaction(Transaction &tx);
+  bool fillPSBT(PartiallySignedTransaction &psbtx, bool &complete,
+                int sighash_type = SIGHASH_ALL, bool sign = true);
+  bool fillPSBTs(std::vector<PartiallySignedTransaction> &psbtxs,
+                 std::vector<bool> &complete, int sighash_type = SIGHASH_ALL,
+                 bool sign = true);
+  SigningMetrics getSigningMetrics();
+  TransactionRef createTransaction(const std::vector<Recipient> &recipients,
+                                   const CoinControl &coin_control, bool sign,
+                                   int &change_pos, Amount &fee,
+                                   std::string &fail_reason);
+
+  WalletEventBus &getEventBus();
+  std::unique_ptr<Handler> handleWalletChanged(WalletChangedFn fn,
+                                               WakeupFn wakeup = WakeupFn());
+  std::unique_ptr<Handler> handleTransactionChanged(TransactionChangedFn fn);
+  std::unique_ptr<Handler> handleAddressBookChanged(AddressBookChangedFn fn);
+  std::unique_ptr<Handler> handleStatusChanged(StatusChangedFn fn);
+  std::unique_ptr<Handler> handleShowProgress(ShowProgressFn fn);
+  std::unique_ptr<Handler>
+  handleCanGetAddressesChanged(CanGetAddressesChangedFn fn);
+
+  void loadKey(const PubKey &pubKey, const Key &key);
+  void loadCryptedKey(const PubKey &pubKey,
+                      const std::vector<unsigned char> &cryptedSecret);
+  void loadMasterKey(unsigned int nId, const MasterKey &masterKey);
+  void loadEncryptionState(const EncryptionState &state);
+  void loadKeyPoolEntry(const KeyPoolEntry &entry);
+  void loadName(const KeyID &address, const std::string &name);
+  void loadTx(const WalletTx &wtx);
+  void loadBestHeight(int32_t nHeight);
+  void loadRescanHeight(int32_t nHeight);
 
   /*
   // Note: List all APIs of WalletImpl class in Bitcoin
@@ -15,15 +15,13 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(core.pri)
+
 SOURCES += \
     askpassphrasedialog.cpp \
-    berkeley_db.cpp \
     createwalletdialog.cpp \
-    crypter.cpp \
     main.cpp \
     mainwindow.cpp \
-    util.cpp \
-    wallet.cpp \
     walletcontroller.cpp \
     walletframe.cpp \
     walletmodel.cpp \
@@ -31,13 +29,8 @@ SOURCES += \
 
 HEADERS += \
     askpassphrasedialog.h \
-    berkeley_db.h \
     createwalletdialog.h \
-    crypter.h \
     mainwindow.h \
-    sec_block.h \
-    util.h \
-    wallet.h \
     walletcontroller.h \
     walletframe.h \
     walletmodel.h \
@@ -50,7 +43,3 @@ FORMS += \
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
 !isEmpty(target.path): INSTALLS += target
-
-unix|win32: LIBS += \
-    -lcryptopp \
-    -ldb_cxx
@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <chrono>
+
+#include <QJsonDocument>
+
+#include "rpcserver.h"
+#include "util.h"
+
+RPCError::RPCError(int errorCode, const std::string &message)
+    : std::runtime_error(message) {
+  code = errorCode;
+}
+
+QJsonObject makeRPCError(int code, const std::string &message) {
+  QJsonObject error;
+  error.insert("code", code);
+  error.insert("message", StdString2QString(message));
+  return error;
+}
+
+static QJsonObject makeResponse(const QJsonValue &result,
+                                const QJsonValue &error, const QJsonValue &id) {
+  QJsonObject response;
+  response.insert("jsonrpc", "2.0");
+  if (error.isNull())
+    response.insert("result", result);
+  else
+    response.insert("error", error);
+  response.insert("id", id);
+  return response;
+}
+
+void RPCTable::registerMethod(const std::string &name,
+                              const RPCMethod &method) {
+  std::string errorMsg = "Cannot register RPC method: ";
+  if (_mapMethods.count(name))
+    throw std::runtime_error(errorMsg + name);
+  _mapMethods.emplace(name, method);
+}
+
+std::vector<std::string> RPCTable::listMethods() const {
+  std::vector<std::string> names;
+  for (auto &it : _mapMethods)
+    names.push_back(it.first);
+  return names;
+}
+
+QJsonValue RPCTable::execute(const std::string &name,
+                             const QJsonArray &params) const {
+  auto it = _mapMethods.find(name);
+  if (it == _mapMethods.end())
+    throw RPCError(RPC_METHOD_NOT_FOUND, "Method not found: " + name);
+  return it->second(params);
+}
+
+void RPCMetrics::record(const std::string &method, uint64_t nMicros,
+                        bool fError) {
+  int bucket = 0;
+  while (bucket < RPC_LATENCY_BUCKETS - 1 && (nMicros >> bucket) > 1)
+    bucket++;
+
+  const std::lock_guard<std::mutex> lock(_mutexStats);
+  MethodStats &stats = _mapStats[method];
+  stats.nCalls++;
+  if (fError)
+    stats.nErrors++;
+  stats.nTotalMicros += nMicros;
+  stats.nMaxMicros = std::max(stats.nMaxMicros, nMicros);
+  stats.latencyBuckets[bucket]++;
+}
+
+QJsonObject RPCMetrics::toJson() {
+  const std::lock_guard<std::mutex> lock(_mutexStats);
+  QJsonObject metrics;
+  for (auto &it : _mapStats) {
+    const MethodStats &stats = it.second;
+    auto percentile = [&stats](double fraction) {
+      uint64_t nRank = static_cast<uint64_t>(stats.nCalls * fraction);
+      uint64_t nSeen = 0;
+      for (int i = 0; i < RPC_LATENCY_BUCKETS; i++) {
+        nSeen += stats.latencyBuckets[i];
+        if (nSeen > nRank)
+          return static_cast<double>(std::min(uint64_t(1) << (i + 1),
+                                              stats.nMaxMicros));
+      }
+      return static_cast<double>(stats.nMaxMicros);
+    };
+
+    QJsonObject entry;
+    entry.insert("calls", static_cast<double>(stats.nCalls));
+    entry.insert("errors", static_cast<double>(stats.nErrors));
+    entry.insert("mean_us", static_cast<double>(stats.nTotalMicros) /
+                                std::max<uint64_t>(stats.nCalls, 1));
+    entry.insert("p50_us", percentile(0.5));
+    entry.insert("p90_us", percentile(0.9));
+    entry.insert("p99_us", percentile(0.99));
+    entry.insert("max_us", static_cast<double>(stats.nMaxMicros));
+    metrics.insert(StdString2QString(it.first), entry);
+  }
+  return metrics;
+}
+
+RPCServer::RPCServer(RPCTable &table, unsigned int nThreads, QObject *parent)
+    : QObject(parent), _table(table) {
+  _nNextConnectionId = 0;
+  _pool.reset(new ThreadPool(nThreads));
+  connect(&_server, &QLocalServer::newConnection, this,
+          &RPCServer::onNewConnection);
+}
+
+RPCServer::~RPCServer() {
+  _server.close();
+  _pool.reset();
+}
+
+void RPCServer::listen(const QString &socketPath) {
+  std::string errorMsg = "Cannot listen on RPC socket: ";
+  QLocalServer::removeServer(socketPath);
+  _server.setSocketOptions(QLocalServer::UserAccessOption);
+  if (!_server.listen(socketPath))
+    throw std::runtime_error(errorMsg + QString2StdString(socketPath) + ": " +
+                             QString2StdString(_server.errorString()));
+}
+
+RPCMetrics &RPCServer::getMetrics() { return _metrics; }
+
+void RPCServer::onNewConnection() {
+  while (QLocalSocket *socket = _server.nextPendingConnection()) {
+    uint64_t connectionId = _nNextConnectionId++;
+    _mapConnections[connectionId].socket = socket;
+
+    connect(socket, &QLocalSocket::readyRead, this, [this, connectionId]() {
+      auto it = _mapConnections.find(connectionId);
+      if (it == _mapConnections.end())
+        return;
+      QLocalSocket *socket = it->second.socket;
+      while (socket->canReadLine()) {
+        QByteArray line = socket->readLine().trimmed();
+        if (!line.isEmpty())
+          handleLine(connectionId, line);
+      }
+      if (socket->bytesAvailable() > MAX_RPC_REQUEST_SIZE)
+        socket->abort();
+    });
+    connect(socket, &QLocalSocket::disconnected, this, [this, connectionId]() {
+      auto it = _mapConnections.find(connectionId);
+      if (it == _mapConnections.end())
+        return;
+      it->second.socket->deleteLater();
+      _mapConnections.erase(it);
+    });
+  }
+}
+
+void RPCServer::handleLine(uint64_t connectionId, const QByteArray &line) {
+  auto reply = std::make_shared<PendingReply>();
+  _mapConnections[connectionId].replies.push_back(reply);
+
+  QJsonParseError parseError;
+  QJsonDocument document = QJsonDocument::fromJson(line, &parseError);
+  if (parseError.error != QJsonParseError::NoError) {
+    reply->nRemaining = 1;
+    reply->responses.resize(1);
+    complete(connectionId, reply, 0,
+             makeResponse(QJsonValue(),
+                          makeRPCError(RPC_PARSE_ERROR,
+                                       QString2StdString(
+                                           parseError.errorString())),
+                          QJsonValue()));
+    return;
+  }
+
+  if (document.isArray()) {
+    QJsonArray batch = document.array();
+    reply->fBatch = true;
+    if (batch.isEmpty()) {
+      reply->fBatch = false;
+      reply->nRemaining = 1;
+      reply->responses.resize(1);
+      complete(connectionId, reply, 0,
+               makeResponse(QJsonValue(),
+                            makeRPCError(RPC_INVALID_REQUEST, "Empty batch"),
+                            QJsonValue()));
+      return;
+    }
+    reply->nRemaining = batch.size();
+    reply->responses.resize(batch.size());
+    for (int i = 0; i < batch.size(); i++)
+      dispatch(connectionId, reply, i, batch.at(i));
+  } else {
+    reply->nRemaining = 1;
+    reply->responses.resize(1);
+    dispatch(connectionId, reply, 0, document.object());
+  }
+}
+
+void RPCServer::dispatch(uint64_t connectionId,
+                         const std::shared_ptr<PendingReply> &reply, int index,
+                         const QJsonValue &request) {
+  if (!request.isObject() || !request.toObject().value("method").isString()) {
+    complete(connectionId, reply, index,
+             makeResponse(QJsonValue(),
+                          makeRPCError(RPC_INVALID_REQUEST, "Invalid request"),
+                          QJsonValue()));
+    return;
+  }
+
+  QJsonObject requestObject = request.toObject();
+  _pool->post([this, connectionId, reply, index, requestObject]() {
+    QJsonValue response;
+    if (requestObject.contains("id"))
+      response = execute(requestObject);
+    else
+      execute(requestObject);
+    QMetaObject::invokeMethod(
+        this,
+        [this, connectionId, reply, index, response]() {
+          complete(connectionId, reply, index, response);
+        },
+        Qt::QueuedConnection);
+  });
+}
+
+QJsonObject RPCServer::execute(const QJsonObject &request) {
+  std::string method = QString2StdString(request.value("method").toString());
+  QJsonValue id = request.value("id");
+  QJsonValue params = request.value("params");
+
+  QJsonValue result;
+  QJsonValue error;
+  auto start = std::chrono::steady_clock::now();
+  try {
+    if (!params.isUndefined() && !params.isNull() && !params.isArray())
+      throw RPCError(RPC_INVALID_PARAMS, "Params must be an array");
+    result = _table.execute(method, params.toArray());
+  } catch (const RPCError &e) {
+    error = makeRPCError(e.code, e.what());
+  } catch (const std::exception &e) {
+    error = makeRPCError(RPC_INTERNAL_ERROR, e.what());
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  _metrics.record(
+      method,
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(),
+      !error.isNull());
+  return makeResponse(result, error, id);
+}
+
+void RPCServer::complete(uint64_t connectionId,
+                         const std::shared_ptr<PendingReply> &reply, int index,
+                         const QJsonValue &response) {
+  reply->responses[index] = response;
+  reply->nRemaining--;
+  flushReplies(connectionId);
+}
+
+void RPCServer::flushReplies(uint64_t connectionId) {
+  auto it = _mapConnections.find(connectionId);
+  if (it == _mapConnections.end())
+    return;
+  Connection &connection = it->second;
+
+  while (!connection.replies.empty() &&
+         connection.replies.front()->nRemaining == 0) {
+    std::shared_ptr<PendingReply> reply = connection.replies.front();
+    connection.replies.pop_front();
+
+    QJsonDocument document;
+    if (reply->fBatch) {
+      QJsonArray responses;
+      for (auto &response : reply->responses) {
+        if (!response.isNull())
+          responses.append(response);
+      }
+      if (responses.isEmpty())
+        continue;
+      document.setArray(responses);
+    } else {
+      if (reply->responses[0].isNull())
+        continue;
+      document.setObject(reply->responses[0].toObject());
+    }
+    connection.socket->write(document.toJson(QJsonDocument::Compact));
+    connection.socket->write("\n");
+  }
+}
@@ -0,0 +1,127 @@
+#ifndef RPCSERVER_H
+#define RPCSERVER_H
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+
+#include "threadpool.h"
+
+static const int MAX_RPC_REQUEST_SIZE = 0x1000000;
+static const int RPC_LATENCY_BUCKETS = 32;
+
+enum RPCErrorCode {
+  RPC_PARSE_ERROR = -32700,
+  RPC_INVALID_REQUEST = -32600,
+  RPC_METHOD_NOT_FOUND = -32601,
+  RPC_INVALID_PARAMS = -32602,
+  RPC_INTERNAL_ERROR = -32603,
+
+  RPC_DESERIALIZATION_ERROR = -22,
+
+  RPC_WALLET_ERROR = -4,
+  RPC_INVALID_ADDRESS_OR_KEY = -5,
+  RPC_WALLET_KEYPOOL_RAN_OUT = -12,
+  RPC_WALLET_UNLOCK_NEEDED = -13,
+  RPC_WALLET_PASSPHRASE_INCORRECT = -14,
+  RPC_WALLET_WRONG_ENC_STATE = -15,
+};
+
+class RPCError : public std::runtime_error {
+public:
+  int code;
+
+  RPCError(int errorCode, const std::string &message);
+};
+
+typedef std::function<QJsonValue(const QJsonArray &params)> RPCMethod;
+
+class RPCTable {
+private:
+  std::map<std::string, RPCMethod> _mapMethods;
+
+public:
+  void registerMethod(const std::string &name, const RPCMethod &method);
+  std::vector<std::string> listMethods() const;
+
+  QJsonValue execute(const std::string &name, const QJsonArray &params) const;
+};
+
+class RPCMetrics {
+private:
+  struct MethodStats {
+    uint64_t nCalls = 0;
+    uint64_t nErrors = 0;
+    uint64_t nTotalMicros = 0;
+    uint64_t nMaxMicros = 0;
+    std::array<uint64_t, RPC_LATENCY_BUCKETS> latencyBuckets{};
+  };
+
+  std::map<std::string, MethodStats> _mapStats;
+  std::mutex _mutexStats;
+
+public:
+  void record(const std::string &method, uint64_t nMicros, bool fError);
+  QJsonObject toJson();
+};
+
+class RPCServer : public QObject {
+  Q_OBJECT
+private:
+  struct PendingReply {
+    bool fBatch = false;
+    int nRemaining = 0;
+    std::vector<QJsonValue> responses;
+  };
+
+  struct Connection {
+    QLocalSocket *socket;
+    std::deque<std::shared_ptr<PendingReply>> replies;
+  };
+
+  RPCTable &_table;
+  RPCMetrics _metrics;
+  QLocalServer _server;
+  std::map<uint64_t, Connection> _mapConnections;
+  uint64_t _nNextConnectionId;
+  std::unique_ptr<ThreadPool> _pool;
+
+  void handleLine(uint64_t connectionId, const QByteArray &line);
+  void dispatch(uint64_t connectionId,
+                const std::shared_ptr<PendingReply> &reply, int index,
+                const QJsonValue &request);
+  QJsonObject execute(const QJsonObject &request);
+  void complete(uint64_t connectionId,
+                const std::shared_ptr<PendingReply> &reply, int index,
+                const QJsonValue &response);
+  void flushReplies(uint64_t connectionId);
+
+public:
+  RPCServer(RPCTable &table, unsigned int nThreads = 0,
+            QObject *parent = nullptr);
+  ~RPCServer();
+
+  void listen(const QString &socketPath);
+  RPCMetrics &getMetrics();
+
+private slots:
+  void onNewConnection();
+};
+
+QJsonObject makeRPCError(int code, const std::string &message);
+
+#endif // RPCSERVER_H
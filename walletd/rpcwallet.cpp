@@ -0,0 +1,377 @@
+#include <algorithm>
+
+#include <QCoreApplication>
+
+#include "rpcwallet.h"
+#include "util.h"
+
+void registerServerRPCCommands(RPCTable &table, RPCServer &server) {
+  table.registerMethod("help", [&table](const QJsonArray &) {
+    QJsonArray methods;
+    for (auto &name : table.listMethods())
+      methods.append(StdString2QString(name));
+    return QJsonValue(methods);
+  });
+
+  table.registerMethod("getrpcmetrics", [&server](const QJsonArray &) {
+    return QJsonValue(server.getMetrics().toJson());
+  });
+
+  table.registerMethod("stop", [](const QJsonArray &) {
+    QMetaObject::invokeMethod(QCoreApplication::instance(), "quit",
+                              Qt::QueuedConnection);
+    return QJsonValue("walletd stopping");
+  });
+}
+
+static SecureString getPassphraseParam(const QJsonArray &params, int index) {
+  if (index >= params.size() || !params.at(index).isString())
+    throw RPCError(RPC_INVALID_PARAMS,
+                   "Missing passphrase parameter " + std::to_string(index));
+  QByteArray passphrase = params.at(index).toString().toUtf8();
+  SecureString result(passphrase.begin(), passphrase.end());
+  passphrase.fill(0);
+  if (result.empty())
+    throw RPCError(RPC_INVALID_PARAMS, "Passphrase cannot be empty");
+  return result;
+}
+
+static PartiallySignedTransaction decodePSBT(const QJsonValue &value) {
+  if (!value.isString())
+    throw RPCError(RPC_INVALID_PARAMS, "PSBT must be a base64 string");
+  QByteArray data = QByteArray::fromBase64(value.toString().toLatin1());
+  const unsigned char *pData =
+      reinterpret_cast<const unsigned char *>(data.constData());
+  PartiallySignedTransaction psbtx;
+  if (!psbtx.deserialize(pData, pData + data.size()))
+    throw RPCError(RPC_DESERIALIZATION_ERROR, "TX decode failed");
+  return psbtx;
+}
+
+static QJsonObject encodePSBT(const PartiallySignedTransaction &psbtx,
+                              bool complete) {
+  std::vector<unsigned char> data;
+  psbtx.serialize(data);
+  QJsonObject result;
+  result.insert("psbt", QString::fromLatin1(Bytes2QByteArray(data).toBase64()));
+  result.insert("complete", complete);
+  return result;
+}
+
+static std::string getPathParam(const QJsonArray &params, int index) {
+  if (index >= params.size() || !params.at(index).isString() ||
+      params.at(index).toString().isEmpty())
+    throw RPCError(RPC_INVALID_PARAMS,
+                   "Missing path parameter " + std::to_string(index));
+  return QString2StdString(params.at(index).toString());
+}
+
+static QJsonObject encodeBackupStats(const BackupStats &stats) {
+  QJsonObject info;
+  info.insert("chunks", static_cast<double>(stats.nChunks));
+  info.insert("records", static_cast<double>(stats.nRecords));
+  info.insert("raw_bytes", static_cast<double>(stats.nRawBytes));
+  info.insert("file_bytes", static_cast<double>(stats.nFileBytes));
+  info.insert("time_us", static_cast<double>(stats.nMicros));
+  return info;
+}
+
+static QJsonValue encodeKey(const QByteArray &key) {
+  return QJsonValue(StdString2QString(
+      HexStr(reinterpret_cast<const unsigned char *>(key.data()), key.size())));
+}
+
+static KeyID getAddressParam(const QJsonArray &params, int index) {
+  std::vector<unsigned char> data;
+  KeyID address;
+  if (index >= params.size() || !params.at(index).isString() ||
+      !ParseHex(QString2StdString(params.at(index).toString()), data) ||
+      data.size() != address.size())
+    throw RPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+  std::copy(data.begin(), data.end(), address.begin());
+  return address;
+}
+
+static size_t getCountParam(const QJsonArray &params, int index,
+                            size_t nDefault) {
+  if (index >= params.size())
+    return nDefault;
+  if (!params.at(index).isDouble() || params.at(index).toDouble() < 0 ||
+      params.at(index).toDouble() > UINT32_MAX)
+    throw RPCError(RPC_INVALID_PARAMS, "Invalid offset or limit");
+  return static_cast<size_t>(params.at(index).toDouble());
+}
+
+static bool getSignParam(const QJsonArray &params, int index) {
+  if (index >= params.size())
+    return true;
+  if (!params.at(index).isBool())
+    throw RPCError(RPC_INVALID_PARAMS, "Sign must be a boolean");
+  return params.at(index).toBool();
+}
+
+void registerWalletRPCCommands(RPCTable &table, Wallet &wallet,
+                               const QDir &blocksDir) {
+  table.registerMethod("getwalletinfo", [&wallet](const QJsonArray &) {
+    QJsonObject info;
+    info.insert("walletname", StdString2QString(wallet.getWalletName()));
+    info.insert("encrypted", wallet.isCrypted());
+    info.insert("locked", wallet.isLocked());
+    if (wallet.isEncryptionPending())
+      info.insert("encryption_progress", wallet.getEncryptionProgress());
+    if (wallet.isScanning()) {
+      QJsonObject scanning;
+      scanning.insert("progress", wallet.getScanProgress());
+      info.insert("scanning", scanning);
+    } else {
+      info.insert("scanning", false);
+    }
+    return QJsonValue(info);
+  });
+
+  table.registerMethod("encryptwallet", [&wallet](const QJsonArray &params) {
+    SecureString passphrase = getPassphraseParam(params, 0);
+    if (wallet.isCrypted() && !wallet.isEncryptionPending())
+      throw RPCError(RPC_WALLET_WRONG_ENC_STATE, "Wallet is already encrypted");
+    if (!wallet.encryptWallet(passphrase))
+      throw RPCError(RPC_WALLET_ERROR, "Cannot encrypt wallet");
+    return QJsonValue(true);
+  });
+
+  table.registerMethod(
+      "walletpassphrasechange", [&wallet](const QJsonArray &params) {
+        SecureString oldPassphrase = getPassphraseParam(params, 0);
+        SecureString newPassphrase = getPassphraseParam(params, 1);
+        if (!wallet.isCrypted())
+          throw RPCError(RPC_WALLET_WRONG_ENC_STATE, "Wallet is not encrypted");
+        if (!wallet.changeWalletPassphrase(oldPassphrase, newPassphrase))
+          throw RPCError(RPC_WALLET_PASSPHRASE_INCORRECT,
+                         "The wallet passphrase entered was incorrect");
+        return QJsonValue(true);
+      });
+
+  table.registerMethod("walletpassphrase", [&wallet](const QJsonArray &params) {
+    SecureString passphrase = getPassphraseParam(params, 0);
+    int64_t nTimeout = wallet.getRelockTimeout();
+    if (params.size() > 1) {
+      if (!params.at(1).isDouble() || params.at(1).toDouble() < 0)
+        throw RPCError(RPC_INVALID_PARAMS, "Timeout must be a non-negative number");
+      nTimeout = static_cast<int64_t>(std::min(
+          params.at(1).toDouble(), static_cast<double>(MAX_RELOCK_TIMEOUT)));
+    }
+    if (!wallet.isCrypted())
+      throw RPCError(RPC_WALLET_WRONG_ENC_STATE, "Wallet is not encrypted");
+    if (!wallet.unlock(passphrase, nTimeout))
+      throw RPCError(RPC_WALLET_PASSPHRASE_INCORRECT,
+                     "The wallet passphrase entered was incorrect");
+    return QJsonValue(true);
+  });
+
+  table.registerMethod("getnewaddress", [&wallet](const QJsonArray &params) {
+    std::string label;
+    if (params.size() > 0) {
+      if (!params.at(0).isString())
+        throw RPCError(RPC_INVALID_PARAMS, "Label must be a string");
+      label = QString2StdString(params.at(0).toString());
+    }
+    KeyID dest;
+    if (!wallet.getNewDestination(label, dest))
+      throw RPCError(RPC_WALLET_KEYPOOL_RAN_OUT,
+                     "Keypool ran out, please unlock the wallet first");
+    return QJsonValue(StdString2QString(HexStr(dest)));
+  });
+
+  table.registerMethod("setlabel", [&wallet](const QJsonArray &params) {
+    KeyID address = getAddressParam(params, 0);
+    if (params.size() < 2 || !params.at(1).isString())
+      throw RPCError(RPC_INVALID_PARAMS, "Label must be a string");
+    std::string label = QString2StdString(params.at(1).toString());
+    if (label.empty() ? !wallet.delAddressBook(address)
+                      : !wallet.setAddressBook(address, label))
+      throw RPCError(RPC_WALLET_ERROR, "Cannot update address book");
+    return QJsonValue(true);
+  });
+
+  table.registerMethod(
+      "searchaddressbook", [&wallet](const QJsonArray &params) {
+        if (params.size() < 1 || !params.at(0).isString())
+          throw RPCError(RPC_INVALID_PARAMS, "Query must be a string");
+        bool fSubstring = false;
+        if (params.size() > 1) {
+          if (!params.at(1).isBool())
+            throw RPCError(RPC_INVALID_PARAMS, "Substring must be a boolean");
+          fSubstring = params.at(1).toBool();
+        }
+        AddressPage page = wallet.searchAddressBook(
+            QString2StdString(params.at(0).toString()), fSubstring,
+            getCountParam(params, 2, 0), getCountParam(params, 3, 100));
+        QJsonArray matches;
+        for (const AddressMatch &match : page.matches) {
+          QJsonObject entry;
+          entry.insert("address", StdString2QString(HexStr(match.address)));
+          entry.insert("label", StdString2QString(match.label));
+          matches.append(entry);
+        }
+        QJsonObject result;
+        result.insert("total", static_cast<double>(page.nTotal));
+        result.insert("exact", page.fExact);
+        result.insert("matches", matches);
+        return QJsonValue(result);
+      });
+
+  table.registerMethod("getkeypoolinfo", [&wallet](const QJsonArray &) {
+    KeyPoolMetrics metrics = wallet.getKeyPoolMetrics();
+    QJsonObject info;
+    info.insert("depth", static_cast<double>(metrics.nDepth));
+    info.insert("popped", static_cast<double>(metrics.nPopped));
+    info.insert("generated", static_cast<double>(metrics.nGenerated));
+    info.insert("batches", static_cast<double>(metrics.nBatches));
+    info.insert("empty_hits", static_cast<double>(metrics.nEmptyHits));
+    info.insert("last_batch_us", static_cast<double>(metrics.nLastBatchMicros));
+    info.insert("mean_batch_us",
+                static_cast<double>(metrics.nTotalBatchMicros) /
+                    std::max<uint64_t>(metrics.nBatches, 1));
+    info.insert("can_get_addresses", wallet.canGetAddresses());
+    return QJsonValue(info);
+  });
+
+  table.registerMethod("getbalances", [&wallet](const QJsonArray &) {
+    WalletBalances balances = wallet.getBalances();
+    QJsonObject mine;
+    mine.insert("trusted", static_cast<double>(balances.balance) / COIN);
+    mine.insert("untrusted_pending",
+                static_cast<double>(balances.unconfirmed_balance) / COIN);
+    mine.insert("immature",
+                static_cast<double>(balances.immature_balance) / COIN);
+    QJsonObject info;
+    info.insert("mine", mine);
+    info.insert("height", wallet.getChainTip());
+    return QJsonValue(info);
+  });
+
+  table.registerMethod(
+      "rescanblockchain", [&wallet, blocksDir](const QJsonArray &params) {
+        int32_t nStartHeight = -1;
+        if (!params.isEmpty()) {
+          if (!params.at(0).isDouble() || params.at(0).toInt(-1) < 0)
+            throw RPCError(RPC_INVALID_PARAMS, "Invalid start_height");
+          nStartHeight = params.at(0).toInt();
+        }
+        if (wallet.isScanning())
+          throw RPCError(RPC_WALLET_ERROR, "Wallet is currently rescanning. "
+                                           "Abort existing rescan or wait.");
+        RescanResult result;
+        if (!wallet.rescanBlockFiles(blocksDir, nStartHeight, result))
+          throw RPCError(RPC_WALLET_ERROR, "Rescan failed");
+        QJsonObject info;
+        info.insert("start_height", result.nStartHeight);
+        info.insert("stop_height", result.nStopHeight);
+        info.insert("transactions", static_cast<double>(result.nTransactions));
+        info.insert("aborted", result.fAborted);
+        return QJsonValue(info);
+      });
+
+  table.registerMethod("abortrescan", [&wallet](const QJsonArray &) {
+    if (!wallet.isScanning())
+      return QJsonValue(false);
+    wallet.abortRescan();
+    return QJsonValue(true);
+  });
+
+  table.registerMethod(
+      "walletprocesspsbt", [&wallet](const QJsonArray &params) {
+        if (params.isEmpty())
+          throw RPCError(RPC_INVALID_PARAMS, "Missing psbt parameter");
+        PartiallySignedTransaction psbtx = decodePSBT(params.at(0));
+        bool sign = getSignParam(params, 1);
+        if (sign && wallet.isLocked())
+          throw RPCError(RPC_WALLET_UNLOCK_NEEDED,
+                         "Please enter the wallet passphrase with "
+                         "walletpassphrase first");
+        bool complete;
+        if (!wallet.fillPSBT(psbtx, complete, SIGHASH_ALL, sign))
+          throw RPCError(RPC_WALLET_ERROR, "Signing PSBT failed");
+        return QJsonValue(encodePSBT(psbtx, complete));
+      });
+
+  table.registerMethod(
+      "walletprocesspsbts", [&wallet](const QJsonArray &params) {
+        if (params.isEmpty() || !params.at(0).isArray())
+          throw RPCError(RPC_INVALID_PARAMS, "Missing psbts array");
+        QJsonArray values = params.at(0).toArray();
+        std::vector<PartiallySignedTransaction> psbtxs;
+        for (int i = 0; i < values.size(); i++)
+          psbtxs.push_back(decodePSBT(values.at(i)));
+        bool sign = getSignParam(params, 1);
+        if (sign && wallet.isLocked())
+          throw RPCError(RPC_WALLET_UNLOCK_NEEDED,
+                         "Please enter the wallet passphrase with "
+                         "walletpassphrase first");
+        std::vector<bool> complete;
+        if (!wallet.fillPSBTs(psbtxs, complete, SIGHASH_ALL, sign))
+          throw RPCError(RPC_WALLET_ERROR, "Signing PSBTs failed");
+        QJsonArray result;
+        for (size_t i = 0; i < psbtxs.size(); i++)
+          result.append(encodePSBT(psbtxs[i], complete[i]));
+        return QJsonValue(result);
+      });
+
+  table.registerMethod("getsigningmetrics", [&wallet](const QJsonArray &) {
+    SigningMetrics metrics = wallet.getSigningMetrics();
+    QJsonObject info;
+    info.insert("signatures", static_cast<double>(metrics.nSignatures));
+    info.insert("batches", static_cast<double>(metrics.nBatches));
+    info.insert("last_batch_signatures",
+                static_cast<double>(metrics.nLastBatchSignatures));
+    info.insert("last_batch_us", static_cast<double>(metrics.nLastBatchMicros));
+    info.insert("signatures_per_sec",
+                metrics.nTotalMicros
+                    ? metrics.nSignatures * 1e6 / metrics.nTotalMicros
+                    : 0.0);
+    return QJsonValue(info);
+  });
+
+  table.registerMethod("getverifierstatus", [&wallet](const QJsonArray &) {
+    VerifierMetrics metrics = wallet.getVerifier().getMetrics();
+    QJsonArray corrupt;
+    for (const QByteArray &key : wallet.getDatabase().getCorruptKeys())
+      corrupt.append(encodeKey(key));
+    QJsonObject info;
+    info.insert("checksums", wallet.getDatabase().isChecksummed());
+    info.insert("passes", static_cast<double>(metrics.nPasses));
+    info.insert("checked", static_cast<double>(metrics.nChecked));
+    info.insert("unchecked", static_cast<double>(metrics.nUnchecked));
+    info.insert("bytes", static_cast<double>(metrics.nBytes));
+    info.insert("resume_key", encodeKey(metrics.resumeKey));
+    info.insert("corrupt_keys", corrupt);
+    return QJsonValue(info);
+  });
+
+  table.registerMethod("backupwallet", [&wallet](const QJsonArray &params) {
+    std::string destination = getPathParam(params, 0);
+    SecureString passphrase = getPassphraseParam(params, 1);
+    BackupStats stats;
+    if (!wallet.backupWallet(destination, passphrase, stats))
+      throw RPCError(RPC_WALLET_PASSPHRASE_INCORRECT,
+                     "The wallet passphrase entered was incorrect");
+    return QJsonValue(encodeBackupStats(stats));
+  });
+
+  table.registerMethod("verifybackup", [](const QJsonArray &params) {
+    std::string source = getPathParam(params, 0);
+    SecureString passphrase = getPassphraseParam(params, 1);
+    BackupStats stats;
+    try {
+      verifyBackup(source, passphrase, stats);
+    } catch (const std::runtime_error &e) {
+      throw RPCError(RPC_WALLET_ERROR, e.what());
+    }
+    return QJsonValue(encodeBackupStats(stats));
+  });
+
+  table.registerMethod("walletlock", [&wallet](const QJsonArray &) {
+    if (!wallet.lock())
+      throw RPCError(RPC_WALLET_WRONG_ENC_STATE, "Wallet is not encrypted");
+    return QJsonValue(true);
+  });
+}
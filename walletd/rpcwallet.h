@@ -0,0 +1,13 @@
+#ifndef RPCWALLET_H
+#define RPCWALLET_H
+
+#include <QDir>
+
+#include "rpcserver.h"
+#include "wallet.h"
+
+void registerServerRPCCommands(RPCTable &table, RPCServer &server);
+void registerWalletRPCCommands(RPCTable &table, Wallet &wallet,
+                               const QDir &blocksDir);
+
+#endif // RPCWALLET_H
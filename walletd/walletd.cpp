@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <iostream>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QSocketNotifier>
+
+#include "backup.h"
+#include "berkeley_db.h"
+#include "log_db.h"
+#include "rpcserver.h"
+#include "rpcwallet.h"
+#include "util.h"
+#include "wallet.h"
+
+static int terminateFds[2] = {-1, -1};
+
+// Only async-signal-safe calls are allowed here, so the handler just wakes
+// the event loop through a socket pair and quit() runs from there.
+static void handleTerminate(int) {
+  int nSavedErrno = errno;
+  char c = 1;
+  ssize_t nWritten = ::write(terminateFds[0], &c, sizeof(c));
+  (void)nWritten;
+  errno = nSavedErrno;
+}
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("walletd");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Headless wallet daemon");
+  parser.addHelpOption();
+  QCommandLineOption datadirOption("datadir", "Wallet data directory.", "dir",
+                                   QDir::home().filePath(".wallet"));
+  QCommandLineOption walletOption("wallet", "Wallet database file name.",
+                                  "file", "wallet.dat");
+  QCommandLineOption blocksdirOption(
+      "blocksdir", "Block file directory (default: <datadir>/blocks).", "dir");
+  QCommandLineOption socketOption(
+      "socket", "Unix domain socket path (default: <datadir>/walletd.sock).",
+      "path");
+  QCommandLineOption threadsOption(
+      "threads", "Number of RPC worker threads (default: number of cores).",
+      "n", "0");
+  QCommandLineOption relockOption(
+      "relocktimeout",
+      "Seconds an unlocked wallet stays unlocked (default: 0, until locked).",
+      "seconds", "0");
+  QCommandLineOption dbengineOption(
+      "dbengine",
+      "Storage engine for a new wallet: bdb or log (default: bdb). An "
+      "existing wallet keeps the engine it was created with.",
+      "engine", "bdb");
+  QCommandLineOption restoreOption(
+      "restorefrom",
+      "Create the wallet from a backup; the passphrase is read from stdin.",
+      "backup");
+  QCommandLineOption checksumsOption(
+      "checksums", "Write records with a checksum that is checked on read.");
+  QCommandLineOption verifyrateOption(
+      "verifyrate",
+      "Background record verification budget in KiB/s (default: 1024, 0 "
+      "disables).",
+      "kibps", "1024");
+  parser.addOption(datadirOption);
+  parser.addOption(walletOption);
+  parser.addOption(blocksdirOption);
+  parser.addOption(socketOption);
+  parser.addOption(threadsOption);
+  parser.addOption(relockOption);
+  parser.addOption(dbengineOption);
+  parser.addOption(restoreOption);
+  parser.addOption(checksumsOption);
+  parser.addOption(verifyrateOption);
+  parser.process(app);
+
+  QDir datadir(parser.value(datadirOption));
+  QString socketPath = parser.isSet(socketOption)
+                           ? parser.value(socketOption)
+                           : datadir.filePath("walletd.sock");
+  QDir blocksDir(parser.isSet(blocksdirOption)
+                     ? parser.value(blocksdirOption)
+                     : datadir.filePath("blocks"));
+
+  int ret = 0;
+  try {
+    createDirectories(datadir);
+    std::string filename = QString2StdString(parser.value(walletOption));
+    QString walletPath = datadir.filePath(parser.value(walletOption));
+    std::string engine = QString2StdString(parser.value(dbengineOption));
+    if (QFile::exists(walletPath))
+      engine = LogDatabase::isLogDatabase(walletPath) ? "log" : "bdb";
+    if (engine != "bdb" && engine != "log")
+      throw std::runtime_error("Unknown storage engine: " + engine);
+
+    std::shared_ptr<BerkeleyEnvironment> env(new BerkeleyEnvironment(datadir));
+    std::unique_ptr<WalletDatabase> database;
+    if (engine == "log")
+      database.reset(new LogDatabase(datadir, filename));
+    else
+      database.reset(new BerkeleyDatabase(env, filename));
+    database->setChecksums(parser.isSet(checksumsOption));
+
+    if (parser.isSet(restoreOption)) {
+      if (QFile::exists(walletPath))
+        throw std::runtime_error("Cannot restore over an existing wallet: " +
+                                 QString2StdString(walletPath));
+      std::string line;
+      std::getline(std::cin, line);
+      SecureString passphrase(line.begin(), line.end());
+      std::fill(line.begin(), line.end(), 0);
+      std::string backupPath = QString2StdString(parser.value(restoreOption));
+      BackupStats stats;
+      verifyBackup(backupPath, passphrase, stats);
+      restoreBackup(backupPath, passphrase, *database, stats);
+      std::cerr << "walletd: restored " << stats.nRecords << " records from "
+                << backupPath << std::endl;
+    }
+    {
+      Wallet wallet(std::move(database));
+      wallet.setRelockTimeout(parser.value(relockOption).toLongLong());
+      uint64_t nVerifyRate = parser.value(verifyrateOption).toULongLong();
+      if (nVerifyRate > 0) {
+        wallet.getVerifier().setRate(nVerifyRate * 1024);
+        wallet.getVerifier().start();
+      }
+
+      RPCTable table;
+      RPCServer server(table, parser.value(threadsOption).toUInt());
+      registerServerRPCCommands(table, server);
+      registerWalletRPCCommands(table, wallet, blocksDir);
+      server.listen(socketPath);
+
+      if (::socketpair(AF_UNIX, SOCK_STREAM, 0, terminateFds) != 0)
+        throw std::runtime_error("Cannot create signal socket pair");
+      QSocketNotifier terminateNotifier(terminateFds[1],
+                                        QSocketNotifier::Read);
+      QObject::connect(&terminateNotifier, &QSocketNotifier::activated, &app,
+                       &QCoreApplication::quit);
+      std::signal(SIGINT, handleTerminate);
+      std::signal(SIGTERM, handleTerminate);
+      ret = app.exec();
+      std::signal(SIGINT, SIG_DFL);
+      std::signal(SIGTERM, SIG_DFL);
+      ::close(terminateFds[0]);
+      ::close(terminateFds[1]);
+    }
+    env->flush(true);
+  } catch (const std::exception &e) {
+    std::cerr << "walletd: " << e.what() << std::endl;
+    ret = 1;
+  }
+  return ret;
+}
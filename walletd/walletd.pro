@@ -0,0 +1,24 @@
+QT       += core network
+QT       -= gui
+
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+TARGET = walletd
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../core.pri)
+
+SOURCES += \
+    rpcserver.cpp \
+    rpcwallet.cpp \
+    walletd.cpp
+
+HEADERS += \
+    rpcserver.h \
+    rpcwallet.h
+
+# Default rules for deployment.
+unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
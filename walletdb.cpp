@@ -0,0 +1,273 @@
+#include <algorithm>
+
+#include <QPair>
+
+#include "util.h"
+#include "wallet.h"
+#include "walletdb.h"
+
+namespace DBKeys {
+const QString KEY("key");
+const QString CRYPTED_KEY("ckey");
+const QString MASTER_KEY("mkey");
+const QString ENCRYPTION_STATE("encstate");
+const QString POOL("pool");
+const QString NAME("name");
+const QString TX("tx");
+const QString BEST_HEIGHT("bestheight");
+const QString RESCAN_HEIGHT("rescanheight");
+} // namespace DBKeys
+
+QDataStream &operator<<(QDataStream &stream, const MasterKey &masterKey) {
+  stream << Bytes2QByteArray(masterKey.cryptedKey)
+         << Bytes2QByteArray(masterKey.salt)
+         << static_cast<qint32>(masterKey.nDeriveIterations);
+  return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, MasterKey &masterKey) {
+  QByteArray cryptedKey, salt;
+  qint32 nDeriveIterations;
+  stream >> cryptedKey >> salt >> nDeriveIterations;
+  masterKey.cryptedKey = QByteArray2Bytes(cryptedKey);
+  masterKey.salt = QByteArray2Bytes(salt);
+  masterKey.nDeriveIterations = nDeriveIterations;
+  return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const EncryptionState &state) {
+  stream << static_cast<quint32>(state.nMasterKeyId)
+         << static_cast<quint64>(state.nEncrypted)
+         << static_cast<quint64>(state.nTotal);
+  return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, EncryptionState &state) {
+  quint32 nMasterKeyId;
+  quint64 nEncrypted, nTotal;
+  stream >> nMasterKeyId >> nEncrypted >> nTotal;
+  state.nMasterKeyId = nMasterKeyId;
+  state.nEncrypted = nEncrypted;
+  state.nTotal = nTotal;
+  return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const KeyPoolEntry &entry) {
+  stream << static_cast<qint64>(entry.nTime)
+         << Bytes2QByteArray(entry.pubKey.data());
+  return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, KeyPoolEntry &entry) {
+  qint64 nTime;
+  QByteArray pubKeyData;
+  stream >> nTime >> pubKeyData;
+  entry.nTime = nTime;
+  entry.pubKey = PubKey(QByteArray2Bytes(pubKeyData));
+  return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const WalletTx &wtx) {
+  std::vector<unsigned char> txData;
+  wtx.tx->serialize(txData);
+  stream << Bytes2QByteArray(txData) << static_cast<qint32>(wtx.nHeight)
+         << wtx.fAbandoned << static_cast<qint64>(wtx.nTimeReceived);
+  return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, WalletTx &wtx) {
+  QByteArray txData;
+  qint32 nHeight;
+  qint64 nTimeReceived;
+  stream >> txData >> nHeight >> wtx.fAbandoned >> nTimeReceived;
+
+  std::shared_ptr<Transaction> tx(new Transaction());
+  const unsigned char *pData =
+      reinterpret_cast<const unsigned char *>(txData.constData());
+  if (!tx->deserialize(pData, pData + txData.size()))
+    stream.setStatus(QDataStream::ReadCorruptData);
+  wtx.tx = tx;
+  wtx.nHeight = nHeight;
+  wtx.nTimeReceived = nTimeReceived;
+  return stream;
+}
+
+WalletBatch::WalletBatch(WalletDatabase &database, bool isReadOnly,
+                         bool isCreate)
+    : _database(database), _batch(database.makeBatch(isReadOnly, isCreate)) {}
+
+bool WalletBatch::writeKey(const PubKey &pubKey, const Key &key) {
+  return _batch->write(
+      qMakePair(DBKeys::KEY, Bytes2QByteArray(pubKey.data())),
+      Bytes2QByteArray(key.getSecret()));
+}
+
+bool WalletBatch::writeCryptedKey(
+    const PubKey &pubKey, const std::vector<unsigned char> &cryptedSecret) {
+  QByteArray pubKeyData = Bytes2QByteArray(pubKey.data());
+  if (!_batch->write(qMakePair(DBKeys::CRYPTED_KEY, pubKeyData),
+                     Bytes2QByteArray(cryptedSecret)))
+    return false;
+  return _batch->erase(qMakePair(DBKeys::KEY, pubKeyData));
+}
+
+bool WalletBatch::writeMasterKey(unsigned int nId,
+                                 const MasterKey &masterKey) {
+  return _batch->write(
+      qMakePair(DBKeys::MASTER_KEY, static_cast<quint32>(nId)), masterKey);
+}
+
+bool WalletBatch::writeEncryptionState(const EncryptionState &state) {
+  return _batch->write(DBKeys::ENCRYPTION_STATE, state);
+}
+
+bool WalletBatch::eraseEncryptionState() {
+  return _batch->erase(DBKeys::ENCRYPTION_STATE);
+}
+
+bool WalletBatch::writePool(const KeyPoolEntry &entry) {
+  return _batch->write(
+      qMakePair(DBKeys::POOL, static_cast<qint64>(entry.nIndex)), entry);
+}
+
+bool WalletBatch::erasePool(int64_t nIndex) {
+  return _batch->erase(qMakePair(DBKeys::POOL, static_cast<qint64>(nIndex)));
+}
+
+bool WalletBatch::writeName(const KeyID &address, const std::string &name) {
+  return _batch->write(qMakePair(DBKeys::NAME, Bytes2QByteArray(address)),
+                       StdString2QString(name));
+}
+
+bool WalletBatch::eraseName(const KeyID &address) {
+  return _batch->erase(qMakePair(DBKeys::NAME, Bytes2QByteArray(address)));
+}
+
+bool WalletBatch::writeTx(const WalletTx &wtx) {
+  return _batch->write(
+      qMakePair(DBKeys::TX, Bytes2QByteArray(wtx.tx->getHash())), wtx);
+}
+
+bool WalletBatch::writeBestHeight(int32_t nHeight) {
+  return _batch->write(DBKeys::BEST_HEIGHT, static_cast<qint32>(nHeight));
+}
+
+bool WalletBatch::writeRescanHeight(int32_t nHeight) {
+  return _batch->write(DBKeys::RESCAN_HEIGHT, static_cast<qint32>(nHeight));
+}
+
+bool WalletBatch::TxnBegin() { return _batch->TxnBegin(); }
+
+bool WalletBatch::TxnCommit() { return _batch->TxnCommit(); }
+
+bool WalletBatch::TxnAbort() { return _batch->TxnAbort(); }
+
+bool WalletBatch::readRecord(Wallet &wallet, const QByteArray &keyData,
+                             const QByteArray &valueData) {
+  QDataStream keyStream(keyData);
+  QDataStream valueStream(valueData);
+  QString type;
+  keyStream >> type;
+
+  if (type == DBKeys::KEY) {
+    QByteArray pubKeyData, secret;
+    keyStream >> pubKeyData;
+    valueStream >> secret;
+    PubKey pubKey(QByteArray2Bytes(pubKeyData));
+    Key key;
+    if (!pubKey.isValid() ||
+        !key.set(SecureBytes(secret.begin(), secret.end())))
+      return false;
+    wallet.loadKey(pubKey, key);
+  } else if (type == DBKeys::CRYPTED_KEY) {
+    QByteArray pubKeyData, cryptedSecret;
+    keyStream >> pubKeyData;
+    valueStream >> cryptedSecret;
+    PubKey pubKey(QByteArray2Bytes(pubKeyData));
+    if (!pubKey.isValid())
+      return false;
+    wallet.loadCryptedKey(pubKey, QByteArray2Bytes(cryptedSecret));
+  } else if (type == DBKeys::MASTER_KEY) {
+    quint32 nId;
+    MasterKey masterKey;
+    keyStream >> nId;
+    valueStream >> masterKey;
+    wallet.loadMasterKey(nId, masterKey);
+  } else if (type == DBKeys::ENCRYPTION_STATE) {
+    EncryptionState state;
+    valueStream >> state;
+    wallet.loadEncryptionState(state);
+  } else if (type == DBKeys::POOL) {
+    qint64 nIndex;
+    KeyPoolEntry entry;
+    keyStream >> nIndex;
+    valueStream >> entry;
+    entry.nIndex = nIndex;
+    if (!entry.pubKey.isValid())
+      return false;
+    wallet.loadKeyPoolEntry(entry);
+  } else if (type == DBKeys::NAME) {
+    QByteArray addressData;
+    QString name;
+    keyStream >> addressData;
+    valueStream >> name;
+    KeyID address;
+    if (addressData.size() != static_cast<int>(address.size()))
+      return false;
+    std::copy(addressData.begin(), addressData.end(), address.begin());
+    wallet.loadName(address, QString2StdString(name));
+  } else if (type == DBKeys::TX) {
+    WalletTx wtx;
+    valueStream >> wtx;
+    if (valueStream.status() != QDataStream::Ok)
+      return false;
+    wallet.loadTx(wtx);
+  } else if (type == DBKeys::BEST_HEIGHT) {
+    qint32 nHeight;
+    valueStream >> nHeight;
+    wallet.loadBestHeight(nHeight);
+  } else if (type == DBKeys::RESCAN_HEIGHT) {
+    qint32 nHeight;
+    valueStream >> nHeight;
+    wallet.loadRescanHeight(nHeight);
+  }
+
+  return keyStream.status() == QDataStream::Ok &&
+         valueStream.status() == QDataStream::Ok;
+}
+
+// Records without which the wallet would mistake its encryption state or lose
+// track of its keys. Any other corrupt record can be skipped.
+static bool isCriticalRecord(const QByteArray &keyData, QString &type) {
+  QDataStream keyStream(keyData);
+  keyStream >> type;
+  return type == DBKeys::KEY || type == DBKeys::CRYPTED_KEY ||
+         type == DBKeys::MASTER_KEY || type == DBKeys::ENCRYPTION_STATE ||
+         type == DBKeys::POOL;
+}
+
+bool WalletBatch::loadWallet(Wallet &wallet) {
+  std::unique_ptr<DatabaseCursor> cursor = _batch->getNewCursor();
+  if (!cursor)
+    return false;
+
+  bool fSuccess = true;
+  QByteArray keyData, valueData;
+  while (cursor->next(keyData, valueData)) {
+    // A record failing its checksum has been reported to the database and
+    // shows up in getverifierstatus. Names and transactions are skipped so
+    // the rest of the wallet still loads; key material is not.
+    if (!_batch->checkRecord(keyData, valueData)) {
+      std::string errorMsg = "Cannot load wallet: Corrupt record of type ";
+      QString type;
+      if (isCriticalRecord(keyData, type))
+        throw std::runtime_error(errorMsg + QString2StdString(type) + " in " +
+                                 _database.getFileName());
+      continue;
+    }
+    if (!readRecord(wallet, keyData, valueData))
+      fSuccess = false;
+  }
+
+  return fSuccess;
+}
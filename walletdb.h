@@ -0,0 +1,73 @@
+#ifndef WALLETDB_H
+#define WALLETDB_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <QDataStream>
+
+#include "crypter.h"
+#include "db.h"
+#include "key.h"
+#include "keypool.h"
+#include "transaction.h"
+
+class Wallet;
+
+struct EncryptionState {
+  unsigned int nMasterKeyId;
+  uint64_t nEncrypted;
+  uint64_t nTotal;
+};
+
+struct WalletTx {
+  TransactionRef tx;
+  int32_t nHeight = -1;
+  bool fAbandoned = false;
+  int64_t nTimeReceived = 0;
+};
+
+QDataStream &operator<<(QDataStream &stream, const MasterKey &masterKey);
+QDataStream &operator>>(QDataStream &stream, MasterKey &masterKey);
+QDataStream &operator<<(QDataStream &stream, const EncryptionState &state);
+QDataStream &operator>>(QDataStream &stream, EncryptionState &state);
+QDataStream &operator<<(QDataStream &stream, const KeyPoolEntry &entry);
+QDataStream &operator>>(QDataStream &stream, KeyPoolEntry &entry);
+QDataStream &operator<<(QDataStream &stream, const WalletTx &wtx);
+QDataStream &operator>>(QDataStream &stream, WalletTx &wtx);
+
+class WalletBatch {
+private:
+  WalletDatabase &_database;
+  std::unique_ptr<DatabaseBatch> _batch;
+
+  bool readRecord(Wallet &wallet, const QByteArray &keyData,
+                  const QByteArray &valueData);
+
+public:
+  explicit WalletBatch(WalletDatabase &database, bool isReadOnly = false,
+                       bool isCreate = false);
+
+  bool writeKey(const PubKey &pubKey, const Key &key);
+  bool writeCryptedKey(const PubKey &pubKey,
+                       const std::vector<unsigned char> &cryptedSecret);
+  bool writeMasterKey(unsigned int nId, const MasterKey &masterKey);
+  bool writeEncryptionState(const EncryptionState &state);
+  bool eraseEncryptionState();
+  bool writePool(const KeyPoolEntry &entry);
+  bool erasePool(int64_t nIndex);
+  bool writeName(const KeyID &address, const std::string &name);
+  bool eraseName(const KeyID &address);
+  bool writeTx(const WalletTx &wtx);
+  bool writeBestHeight(int32_t nHeight);
+  bool writeRescanHeight(int32_t nHeight);
+
+  bool TxnBegin();
+  bool TxnCommit();
+  bool TxnAbort();
+
+  bool loadWallet(Wallet &wallet);
+};
+
+#endif // WALLETDB_H
@@ -1,3 +1,46 @@
+#include <QHBoxLayout>
+#include <QStackedWidget>
+
 #include "walletframe.h"
+#include "walletview.h"
+
+WalletFrame::WalletFrame() {
+  QHBoxLayout *layout = new QHBoxLayout(this);
+  layout->setContentsMargins(0, 0, 0, 0);
+  _pWalletStack = new QStackedWidget(this);
+  layout->addWidget(_pWalletStack);
+}
+
+bool WalletFrame::addWallet(WalletModel *walletModel) {
+  if (!walletModel || _mapWalletViews.contains(walletModel))
+    return false;
+
+  WalletView *walletView = new WalletView();
+  walletView->setWalletModel(walletModel);
+  _pWalletStack->addWidget(walletView);
+  _mapWalletViews[walletModel] = walletView;
+  return true;
+}
+
+bool WalletFrame::setCurrentWallet(WalletModel *walletModel) {
+  auto it = _mapWalletViews.find(walletModel);
+  if (it == _mapWalletViews.end())
+    return false;
+  _pWalletStack->setCurrentWidget(it.value());
+  return true;
+}
+
+bool WalletFrame::removeWallet(WalletModel *walletModel) {
+  auto it = _mapWalletViews.find(walletModel);
+  if (it == _mapWalletViews.end())
+    return false;
+  WalletView *walletView = it.value();
+  _mapWalletViews.erase(it);
+  _pWalletStack->removeWidget(walletView);
+  delete walletView;
+  return true;
+}
 
-WalletFrame::WalletFrame() {}
+WalletView *WalletFrame::currentWalletView() const {
+  return static_cast<WalletView *>(_pWalletStack->currentWidget());
+}
@@ -2,10 +2,24 @@
 #define WALLETFRAME_H
 
 #include <QFrame>
+#include <QMap>
+
+class QStackedWidget;
+class WalletModel;
+class WalletView;
 
 class WalletFrame : public QFrame {
 public:
   WalletFrame();
+
+  bool addWallet(WalletModel *walletModel);
+  bool setCurrentWallet(WalletModel *walletModel);
+  bool removeWallet(WalletModel *walletModel);
+  WalletView *currentWalletView() const;
+
+private:
+  QStackedWidget *_pWalletStack;
+  QMap<WalletModel *, WalletView *> _mapWalletViews;
 };
 
 #endif // WALLETFRAME_H
@@ -1,3 +1,79 @@
+#include <QMetaObject>
+#include <QTimer>
+
+#include "util.h"
 #include "walletmodel.h"
 
-WalletModel::WalletModel(QObject *parent) : QObject(parent) {}
+WalletModel::WalletModel(Wallet &wallet, QObject *parent)
+    : QObject(parent), _wallet(wallet) {
+  _fBalanceStale = true;
+  _pDeliveryTimer = new QTimer(this);
+  _pDeliveryTimer->setSingleShot(true);
+  connect(_pDeliveryTimer, &QTimer::timeout, this,
+          &WalletModel::deliverEvents);
+
+  // Wallet threads only post to the event bus. The first event after a
+  // delivery queues a wakeup onto the GUI thread, which arms a single-shot
+  // frame timer, so everything posted until it fires arrives as one delta.
+  _handler = _wallet.handleWalletChanged(
+      [this](const WalletDelta &delta) { applyDelta(delta); },
+      [this]() {
+        QMetaObject::invokeMethod(this, "scheduleDelivery",
+                                  Qt::QueuedConnection);
+      });
+  scheduleDelivery();
+}
+
+WalletModel::~WalletModel() { _handler->disconnect(); }
+
+Wallet &WalletModel::wallet() const { return _wallet; }
+
+WalletBalances WalletModel::getCachedBalance() const {
+  return _cachedBalances;
+}
+
+void WalletModel::scheduleDelivery() {
+  if (!_pDeliveryTimer->isActive())
+    _pDeliveryTimer->start(WALLET_EVENT_FRAME_MS);
+}
+
+void WalletModel::deliverEvents() {
+  _wallet.getEventBus().deliver();
+  if (_fBalanceStale)
+    pollBalanceChanged();
+  if (_fBalanceStale || _wallet.getEventBus().hasPending())
+    scheduleDelivery();
+}
+
+void WalletModel::applyDelta(const WalletDelta &delta) {
+  if (!delta.transactions.empty()) {
+    _fBalanceStale = true;
+    emit transactionsChanged(static_cast<int>(delta.transactions.size()));
+  }
+  if (!delta.addressBook.empty())
+    emit addressBookChanged();
+  if (delta.fStatusChanged)
+    emit encryptionStatusChanged();
+  if (delta.fCanGetAddressesChanged)
+    emit canGetAddressesChanged();
+  if (delta.fProgressChanged)
+    emit showProgress(StdString2QString(delta.progressTitle),
+                      delta.nProgress);
+  emit walletChanged();
+}
+
+void WalletModel::pollBalanceChanged() {
+  // A rescan or signing batch may hold the wallet lock for a while; rather
+  // than block the GUI thread, retry on the next frame.
+  WalletBalances balances;
+  int nBlocks;
+  if (!_wallet.tryGetBalances(balances, nBlocks))
+    return;
+  _fBalanceStale = false;
+  if (balances.balance == _cachedBalances.balance &&
+      balances.unconfirmed_balance == _cachedBalances.unconfirmed_balance &&
+      balances.immature_balance == _cachedBalances.immature_balance)
+    return;
+  _cachedBalances = balances;
+  emit balanceChanged(balances);
+}
@@ -1,16 +1,52 @@
 #ifndef WALLETMODEL_H
 #define WALLETMODEL_H
 
+#include <memory>
+
 #include <QObject>
+#include <QString>
+
+#include "wallet.h"
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+static const int WALLET_EVENT_FRAME_MS = 16;
 
 class WalletModel : public QObject {
   Q_OBJECT
 public:
-  explicit WalletModel(QObject *parent = nullptr);
+  explicit WalletModel(Wallet &wallet, QObject *parent = nullptr);
+  ~WalletModel();
+
+  Wallet &wallet() const;
+  WalletBalances getCachedBalance() const;
 
 signals:
+  void walletChanged();
+  void transactionsChanged(int nChanged);
+  void balanceChanged(const WalletBalances &balances);
+  void addressBookChanged();
+  void encryptionStatusChanged();
+  void canGetAddressesChanged();
+  void showProgress(const QString &title, int nProgress);
 
 public slots:
+  void scheduleDelivery();
+
+private slots:
+  void deliverEvents();
+
+private:
+  Wallet &_wallet;
+  QTimer *_pDeliveryTimer;
+  std::unique_ptr<Handler> _handler;
+  WalletBalances _cachedBalances;
+  bool _fBalanceStale;
+
+  void applyDelta(const WalletDelta &delta);
+  void pollBalanceChanged();
 };
 
 #endif // WALLETMODEL_H
@@ -1,3 +1,16 @@
 #include "walletview.h"
+#include "walletmodel.h"
 
-WalletView::WalletView() {}
+WalletView::WalletView() { _pWalletModel = nullptr; }
+
+void WalletView::setWalletModel(WalletModel *walletModel) {
+  if (_pWalletModel)
+    disconnect(_pWalletModel, nullptr, this, nullptr);
+  _pWalletModel = walletModel;
+  if (!walletModel)
+    return;
+  connect(walletModel, &WalletModel::walletChanged, this,
+          [this]() { update(); });
+}
+
+WalletModel *WalletView::getWalletModel() const { return _pWalletModel; }
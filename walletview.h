@@ -3,9 +3,17 @@
 
 #include <QStackedWidget>
 
+class WalletModel;
+
 class WalletView : public QStackedWidget {
 public:
   WalletView();
+
+  void setWalletModel(WalletModel *walletModel);
+  WalletModel *getWalletModel() const;
+
+private:
+  WalletModel *_pWalletModel;
 };
 
 #endif // WALLETVIEW_H